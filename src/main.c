@@ -34,17 +34,47 @@
 #include "pi_chart_settings.h"
 #include "pi_utils.h"
 #include "pi_chart_server.h"
+#include "pi_am2315.h"
 #include "pi_chart_gpio.h"
+#include "pi_file_cache.h"
+#include "pi_gpio_edges.h"
+#include "pi_mem_info.h"
+#include "pi_cpu_stat.h"
+#include "pi_disk_stats.h"
+#include "pi_net_dev.h"
+#include "pi_process.h"
+#include "pi_process_stats.h"
+#include "pi_process_top.h"
+#include "pi_thermal.h"
 
 void usage(const char *program) {
     fprintf(stdout, "Version: %s\n", get_pi_chart_version());
     fprintf(stdout, "Usage:     %s --port=PORT_NUMBER --daemon=true/false \n", program);
     fprintf(stdout, "Example:   %s --port=8080 --daemon=true \n\n", program);
     fprintf(stdout, "Simple Raspberry PI monitoring tool.\n\n");
-    fprintf(stdout, "     daemon     run as daemon, default: %s\n", get_run_as_daemon() ? "true" : "false");
-    fprintf(stdout, "     port       port to listen to, default: %d\n", (int) get_server_port());
-    fprintf(stdout, "     directory  directory to read files from: %s\n", get_file_directory());
-    fprintf(stdout, "     help       get this help message\n");
+    fprintf(stdout, "     daemon              run as daemon, default: %s\n", get_run_as_daemon() ? "true" : "false");
+    fprintf(stdout, "     port                port to listen to, default: %d\n", (int) get_server_port());
+    fprintf(stdout, "     directory           directory to read files from: %s\n", get_file_directory());
+    fprintf(stdout, "     workers             request worker threads, 0 serves from the event loop, default: %u\n",
+            get_worker_count());
+    fprintf(stdout, "     keep-alive-timeout  seconds an idle connection is kept open, default: %u\n",
+            get_keep_alive_timeout());
+    fprintf(stdout, "     max-requests        requests served per connection, 1 disables keep-alive, default: %u\n",
+            get_max_keep_alive_requests());
+    fprintf(stdout, "     sample-interval     milliseconds between system samples, default: %u\n",
+            get_sample_interval());
+    fprintf(stdout, "     process-events      track processes with netlink events instead of scanning, default: %s\n",
+            get_process_events() ? "true" : "false");
+    fprintf(stdout, "     watch               comma separated processes to sample CPU, memory and I/O of: %s\n",
+            get_watch_list());
+    fprintf(stdout, "     sysfs-root          where sysfs is mounted, default: %s\n", get_sysfs_root());
+    fprintf(stdout, "     count-pins          comma separated pins to count rising edges on: %s\n", get_count_pins());
+    fprintf(stdout, "     edge-rate           edges per second the emulator feeds counted pins, default: %u\n",
+            get_emulated_edge_rate());
+    fprintf(stdout, "     i2c-bus             I2C bus of the sensors, or emulated, default: %s\n", get_i2c_bus());
+    fprintf(stdout, "     emulate-sensors     AM2315 sensors to add on the emulated bus, default: %u\n",
+            get_emulated_sensors());
+    fprintf(stdout, "     help                get this help message\n");
 }
 
 bool parse_arguments(int argc, char *argv[]) {
@@ -54,6 +84,17 @@ bool parse_arguments(int argc, char *argv[]) {
                     {"daemon",    optional_argument, 0, 'd'},
                     {"port",      optional_argument, 0, 'p'},
                     {"directory", optional_argument, 0, 'f'},
+                    {"workers",   optional_argument, 0, 'w'},
+                    {"keep-alive-timeout", optional_argument, 0, 'k'},
+                    {"max-requests",       optional_argument, 0, 'm'},
+                    {"sample-interval",    optional_argument, 0, 'i'},
+                    {"process-events",     optional_argument, 0, 'e'},
+                    {"watch",              optional_argument, 0, 'n'},
+                    {"sysfs-root",         optional_argument, 0, 's'},
+                    {"count-pins",         optional_argument, 0, 'c'},
+                    {"edge-rate",          optional_argument, 0, 'r'},
+                    {"i2c-bus",            optional_argument, 0, 'b'},
+                    {"emulate-sensors",    optional_argument, 0, 'x'},
                     {"help",      optional_argument, 0, '?'},
                     {0, 0,                           0, 0}
             };
@@ -62,7 +103,7 @@ bool parse_arguments(int argc, char *argv[]) {
     int c = 0;
 
     do {
-        c = getopt_long(argc, argv, "?p:d:f:", long_options, &option_index);
+        c = getopt_long(argc, argv, "?p:d:f:w:k:m:i:e:n:s:c:r:b:x:", long_options, &option_index);
 
         switch (c) {
             case -1:
@@ -84,6 +125,61 @@ bool parse_arguments(int argc, char *argv[]) {
                 fprintf(stdout, "\nDirectory to read files from %s\n", get_file_directory());
                 break;
 
+            case 'w':
+                set_worker_count((unsigned int) atol(optarg));
+                fprintf(stdout, "\nWorker threads %u\n", get_worker_count());
+                break;
+
+            case 'k':
+                set_keep_alive_timeout((unsigned int) atol(optarg));
+                fprintf(stdout, "\nKeep-alive timeout %u seconds\n", get_keep_alive_timeout());
+                break;
+
+            case 'm':
+                set_max_keep_alive_requests((unsigned int) atol(optarg));
+                fprintf(stdout, "\nMax requests per connection %u\n", get_max_keep_alive_requests());
+                break;
+
+            case 'i':
+                set_sample_interval((unsigned int) atol(optarg));
+                fprintf(stdout, "\nSample interval %u ms\n", get_sample_interval());
+                break;
+
+            case 'e':
+                set_process_events(strcmp(optarg, "true") == 0);
+                fprintf(stdout, "\nProcess events %s\n", get_process_events() ? "true" : "false");
+                break;
+
+            case 'n':
+                set_watch_list(optarg);
+                fprintf(stdout, "\nWatching processes %s\n", get_watch_list());
+                break;
+
+            case 's':
+                set_sysfs_root(optarg);
+                fprintf(stdout, "\nSysfs root %s\n", get_sysfs_root());
+                break;
+
+            case 'c':
+                set_count_pins(optarg);
+                fprintf(stdout, "\nCounting edges on pins %s\n", get_count_pins());
+                break;
+
+            case 'r':
+                set_emulated_edge_rate((unsigned int) atol(optarg));
+                fprintf(stdout, "\nEmulated edge rate %u per second\n", get_emulated_edge_rate());
+                break;
+
+            case 'b':
+                set_i2c_bus(optarg);
+                fprintf(stdout, "\nI2C bus %s\n", get_i2c_bus());
+                break;
+
+            case 'x':
+                set_emulated_sensors((unsigned int) atol(optarg));
+                fprintf(stdout, "\nEmulated sensors %u\n", get_emulated_sensors());
+                break;
+
             case '?':
             default:
                 usage("pi-chart");
@@ -194,6 +290,28 @@ int main(int argc, const char *argv[]) {
 
         set_service_running(true);
 
+        pi_mem_info_start();
+
+        pi_cpu_stat_start();
+
+        pi_thermal_start();
+
+        pi_net_dev_start();
+
+        pi_disk_stats_start();
+
+        pi_process_start();
+
+        pi_process_stats_start();
+
+        pi_process_top_start();
+
+        pi_gpio_edges_start();
+
+        pi_am2315_emulate_sensors(get_emulated_sensors());
+
+        pi_file_cache_start();
+
         pi_chart_service_start();
 
         printf("\n\nPress q [enter] to quit...\n\n");
@@ -24,27 +24,35 @@
 //
 **********************************************************************/
 
-#include <stdio.h>
+#include <pthread.h>
 #include <stdint.h>
-#include <unistd.h>
+#include <string.h>
 #include "pi_am2315.h"
+#include "pi_chart_settings.h"
 #include "pi_utils.h"
 
-// Checking to see if we are on a Raspberry PI
+#define AM2315_READREG       0x03
+
+// The sensor goes back to sleep about 3 ms after it is woken and needs 1.5 ms to convert after
+// a read request.
 //
-#ifndef BCMHOST
-#define ENABLE_PI_EMULATOR 1
-#endif
+#define am2315_wake_ms 1
+#define am2315_conversion_ms 2
 
-#ifndef ENABLE_PI_EMULATOR
+// The AM2315 manual advises that continuous samples must be at least 2 seconds apart.
+//
+#define am2315_min_interval_ms 2000
 
-#include <wiringPi.h>
-#include <wiringPiI2C.h>
+#define am2315_response_length 8
 
-#endif
+// Where --emulate-sensors puts its sensors on the emulated bus, one address each.
+//
+#define am2315_emulated_address 0x10
 
-#define AM2315_I2CADDR       0x5C
-#define AM2315_READREG       0x03
+static pthread_mutex_t am2315_lock = PTHREAD_MUTEX_INITIALIZER;
+static pi_sensor_ptr am2315_sensor = NULL;
+
+static const char *const am2315_value_names[] = {"temperature", "humidity", NULL};
 
 float pi_am2315_compute_humidity(unsigned char msb, unsigned char lsb) {
     int humidity_h, humidity_l;
@@ -88,82 +96,121 @@ uint16_t pi_am2315_crc16(unsigned char *ptr, unsigned char len) {
     return crc;
 }
 
+// Step 0 wakes the sensor, step 1 asks for humidity and temperature.
+//
+static bool pi_am2315_schedule(pi_i2c_bus_ptr bus, unsigned char address, unsigned int step, unsigned int *delay_ms,
+                               bool *done) {
+    if (0 == step) {
+        // The sensor does not acknowledge the byte that wakes it, so the write is expected to
+        // fail.
+        //
+        unsigned char dummy[1] = {0};
+
+        pi_i2c_bus_write(bus, address, dummy, sizeof(dummy));
+
+        *delay_ms = am2315_wake_ms;
+        return true;
+    }
+
+    // Read register command, first register, number of registers.
+    //
+    unsigned char read_request[3] = {AM2315_READREG, 0, 4};
+
+    if (pi_i2c_bus_write(bus, address, read_request, sizeof(read_request)) != sizeof(read_request)) {
+        return false;
+    }
 
-int pi_am2315_open(){
-#ifdef ENABLE_PI_EMULATOR
-    return 1;
-#else
-    return wiringPiI2CSetup (AM2315_I2CADDR);
-#endif
+    *delay_ms = am2315_conversion_ms;
+    *done = true;
+    return true;
 }
 
-// The AM2315 manual advisess that continuous samples must be at least 2 seconds apart).
-// Calling this method avoids the double I2C request.
+// Command byte, length byte, 4 bytes data, 2 bytes of checksum.
 //
+static ssize_t pi_am2315_read(pi_i2c_bus_ptr bus, unsigned char address, unsigned char *buffer, size_t size) {
+    return pi_i2c_bus_read(bus, address, buffer, min(size, (size_t) am2315_response_length));
+}
 
-bool pi_am2315_readTemperatureAndHumidity(int fd, float *temperature, float *humidity){
-#ifdef ENABLE_PI_EMULATOR
+// Checks the response to a read of 4 registers and decodes it.
+//
+static bool pi_am2315_decode(const unsigned char *response, ssize_t length, double *values) {
+    if (length != am2315_response_length || response[0] != AM2315_READREG || response[1] != 4) {
+        return false;
+    }
 
-    sleep(3);
-    printf("write returned %d bytes\n",4);
-    sleep(1);
-    *temperature = 20.0;
-    *humidity = 10.0;
-    uint16_t crc = 0, crc_res = 0;
+    uint16_t crc = (uint16_t) ((response[7] << 8) + response[6]);
 
-#else
+    if (pi_am2315_crc16((unsigned char *) response, 6) != crc) {
+        return false;
+    }
 
-    sleep(2);
+    values[am2315_humidity] = pi_am2315_compute_humidity(response[2], response[3]);
+    values[am2315_temperature] = pi_am2315_compute_temperature(response[4], response[5]);
 
-    // read request - 3 is the read register command
-    // 0 is the address to start at
-    // 4 is the number of bytes to read
-    //
-    unsigned char read_request[3] = {3, 0, 4};
+    return true;
+}
 
-    // buffer for the response: command byte, length byte, 4 bytes data, 2 bytes of checksum
-    //
-    unsigned char response[8];
-    memory_clear(response, sizeof(response));
+// Answers a read request like a sensor reading 20.0C and 10.0%, checksum and all.
+//
+static ssize_t pi_am2315_emulate(const unsigned char *request, size_t request_length,
+                                 unsigned char *response, size_t size) {
+    if (request_length != 3 || request[0] != AM2315_READREG) {
+        return -1;
+    }
 
-    // dummy data sent to wake up device
-    //
-    unsigned char dummy[1] = {0};
+    unsigned char frame[am2315_response_length] = {AM2315_READREG, 4, 0x00, 0x64, 0x00, 0xC8, 0, 0};
+    uint16_t crc = pi_am2315_crc16(frame, 6);
+    frame[6] = (unsigned char) (crc & 0xFF);
+    frame[7] = (unsigned char) (crc >> 8);
 
-    // send some data to wake it up
-    //
-    int n = write(fd, dummy, 1);
-    n = write(fd, dummy, 1);
+    size = min(size, sizeof(frame));
+    memcpy(response, frame, size);
 
-    // just sleep a bit
-    //
-    sleep(1);
+    return (ssize_t) size;
+}
 
-    // send the read request
-    //
-    n = write(fd, read_request, AM2315_READREG);
+static const pi_sensor_driver_t am2315_driver = {
+        "am2315",
+        AM2315_I2CADDR,
+        am2315_min_interval_ms,
+        am2315_value_names,
+        NULL,
+        pi_am2315_schedule,
+        pi_am2315_read,
+        pi_am2315_decode,
+        pi_am2315_emulate
+};
+
+const pi_sensor_driver_t *pi_am2315_get_driver() {
+    return &am2315_driver;
+}
 
-    printf("write returned %d bytes\n",n);
+pi_sensor_ptr pi_am2315_start() {
+    pthread_mutex_lock(&am2315_lock);
 
-    // very short delay to allow device to do data conversion
-    //
-    sleep(1);
+    if (NULL == am2315_sensor) {
+        am2315_sensor = pi_sensor_add(get_i2c_bus(), &am2315_driver, AM2315_I2CADDR);
+    }
+
+    pi_sensor_ptr sensor = am2315_sensor;
+
+    pthread_mutex_unlock(&am2315_lock);
 
-    // read the response
-    n = read(fd, response, 8);
-    printf("read returned %d bytes\n",n);
+    return sensor;
+}
 
-    // compute humidity value
-	*humidity = pi_am2315_compute_humidity(response[2], response[3]);
+pi_sensor_ptr pi_am2315_sensor() {
+    pthread_mutex_lock(&am2315_lock);
 
-	// compute temperature value
-	*temperature = pi_am2315_compute_temperature(response[4], response[5]);
+    pi_sensor_ptr sensor = am2315_sensor;
 
- 	// compute crc
-	uint16_t crc_res = pi_am2315_crc16(response, 6);
-	uint16_t crc = (response[7] << 8) + response[6];
+    pthread_mutex_unlock(&am2315_lock);
 
-#endif
+    return sensor;
+}
 
-    return crc_res == crc;
-}
\ No newline at end of file
+void pi_am2315_emulate_sensors(unsigned int count) {
+    for (unsigned int i = 0; i < count && am2315_emulated_address + i < i2c_max_addresses; i++) {
+        pi_sensor_add(i2c_emulated_bus, &am2315_driver, (unsigned char) (am2315_emulated_address + i));
+    }
+}
@@ -25,12 +25,33 @@
 **********************************************************************/
 
 #include <stdbool.h>
+#include "pi_sensor.h"
 #include "version_config.h"
 
 #ifndef PI_AM2315_PI_AM2315_H
 #define PI_AM2315_PI_AM2315_H
 
-int pi_am2315_open();
-bool pi_am2315_readTemperatureAndHumidity(int fd, float *temperature, float *humidity);
+#define AM2315_I2CADDR       0x5C
+
+// Values of a reading.
+//
+#define am2315_temperature 0
+#define am2315_humidity 1
+
+const pi_sensor_driver_t *pi_am2315_get_driver();
+
+// Starts reading the sensor at AM2315_I2CADDR on get_i2c_bus() every get_sample_interval()
+// milliseconds, but no more often than every 2 seconds.  Safe to call more than once, returns
+// NULL if the bus cannot be opened.
+//
+pi_sensor_ptr pi_am2315_start();
+
+// The sensor pi_am2315_start() added, NULL before.
+//
+pi_sensor_ptr pi_am2315_sensor();
+
+// Adds count sensors on the emulated bus, for measuring the bus scheduler.
+//
+void pi_am2315_emulate_sensors(unsigned int count);
 
 #endif //PI_AM2315_PI_AM2315_H
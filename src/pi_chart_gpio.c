@@ -27,7 +27,10 @@
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "OCUnusedGlobalDeclarationInspection"
 #pragma ide diagnostic ignored "UnusedImportStatement"
+#include <pthread.h>
+#include <time.h>
 #include "pi_chart_gpio.h"
+#include "pi_chart_settings.h"
 #include "pi_utils.h"
 #include "version_config.h"
 
@@ -41,8 +44,31 @@
 
 #ifndef ENABLE_PI_EMULATOR
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <wiringPi.h>
 
+// wiringPi pin numbers on the 40 pin header.
+//
+#define gpio_pin_count 32
+
+// GPLEV0 and GPLEV1 hold the levels of BCM GPIO 0-31 and 32-53, offsets are in 32 bit words
+// from the start of /dev/gpiomem.
+//
+#define gpio_register_level0 (0x34 / 4)
+#define gpio_register_level1 (0x38 / 4)
+#define gpio_map_size 4096
+
+// NULL when /dev/gpiomem could not be mapped or does not hold BCM283x style registers (a Pi 5),
+// snapshots then fall back to a digitalRead per pin.
+//
+static volatile uint32_t *gpio_registers = NULL;
+
+// BCM GPIO number of each wiringPi pin, -1 for a pin without one.
+//
+static int gpio_bcm_pins[gpio_pin_count];
+
 #else
 
 #define gpio_pin_count 26
@@ -54,11 +80,85 @@ gpio_mode gpio_mode_list[gpio_pin_count];
 
 static char *gpio_modes [] = {"IN", "OUT", "ALT5", "ALT4", "ALT0", "ALT1", "ALT2", "ALT3"} ;
 
+// Edge handler of each watched pin, NULL for the others.
+//
+static gpio_edge_handler gpio_edge_handlers[gpio_pin_count];
+
+static uint64_t gpio_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+#ifndef ENABLE_PI_EMULATOR
+
+static gpio_bitset gpio_read_registers() {
+    uint64_t bcm_levels = (uint64_t) gpio_registers[gpio_register_level0]
+                          | ((uint64_t) gpio_registers[gpio_register_level1] << 32);
+    gpio_bitset levels = 0;
+
+    for (int pin = 0; pin < gpio_pin_count; pin++) {
+        if (gpio_bcm_pins[pin] >= 0 && (bcm_levels >> gpio_bcm_pins[pin]) & 1) {
+            levels |= (gpio_bitset) 1 << pin;
+        }
+    }
+
+    return levels;
+}
+
+static gpio_bitset gpio_read_pins() {
+    gpio_bitset levels = 0;
+
+    for (int pin = 0; pin < gpio_pin_count; pin++) {
+        if (digitalRead(pin) != LOW) {
+            levels |= (gpio_bitset) 1 << pin;
+        }
+    }
+
+    return levels;
+}
+
+// Maps the GPIO registers and keeps them only if they agree with digitalRead, so boards with a
+// different register layout keep working through wiringPi.
+//
+static void gpio_map_registers() {
+    int fd = open("/dev/gpiomem", O_RDONLY | O_SYNC | O_CLOEXEC);
+
+    if (fd < 0) {
+        INFO_LOG("Unable to open /dev/gpiomem, reading pins one at a time");
+        return;
+    }
+
+    void *map = mmap(NULL, gpio_map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (MAP_FAILED == map) {
+        INFO_LOG("Unable to map /dev/gpiomem, reading pins one at a time");
+        return;
+    }
+
+    for (int pin = 0; pin < gpio_pin_count; pin++) {
+        gpio_bcm_pins[pin] = wpiPinToGpio(pin);
+    }
+
+    gpio_registers = map;
+
+    if (gpio_read_registers() != gpio_read_pins()) {
+        INFO_LOG("GPIO registers do not match digitalRead, reading pins one at a time");
+        gpio_registers = NULL;
+        munmap(map, gpio_map_size);
+    }
+}
+
+#endif
+
 void setup_wiring_pi() {
 
 #ifndef ENABLE_PI_EMULATOR
     INFO_LOG("Setting up WiringPi");
     wiringPiSetup();
+    gpio_map_registers();
 #else
     INFO_LOG("WARNING: Running in emulation mode");
 
@@ -69,6 +169,10 @@ void setup_wiring_pi() {
 #endif
 }
 
+int gpio_get_pin_count() {
+    return gpio_pin_count;
+}
+
 gpio_signal gpio_get_digital(unsigned char pin) {
     gpio_signal result = LOW_SIGNAL;
 
@@ -83,12 +187,32 @@ gpio_signal gpio_get_digital(unsigned char pin) {
     return result;
 }
 
+gpio_bitset gpio_snapshot() {
+    gpio_bitset levels = 0;
+
+#ifndef ENABLE_PI_EMULATOR
+    levels = gpio_registers ? gpio_read_registers() : gpio_read_pins();
+#else
+    for (int pin = 0; pin < gpio_pin_count; pin++) {
+        if (gpio_list[pin] != LOW_SIGNAL) {
+            levels |= (gpio_bitset) 1 << pin;
+        }
+    }
+#endif
+
+    return levels;
+}
+
 const char *gpio_get_digital_str(unsigned char pin) {
     return gpio_get_digital(pin) == LOW_SIGNAL ? "LOW" : "HIGH";
 }
 
 const char *gpio_get_mode_str(unsigned char pin) {
-    return gpio_modes[gpio_get_mode(pin)];
+    return gpio_get_mode_name(gpio_get_mode(pin));
+}
+
+const char *gpio_get_mode_name(gpio_mode mode) {
+    return (unsigned int) mode < sizeof(gpio_modes) / sizeof(gpio_modes[0]) ? gpio_modes[mode] : "UNKNOWN";
 }
 
 gpio_signal gpio_set_digital(unsigned char pin, gpio_signal value) {
@@ -121,4 +245,117 @@ gpio_mode gpio_get_mode(unsigned char pin) {
     return result;
 }
 
+#ifndef ENABLE_PI_EMULATOR
+
+// wiringPiISR takes a function without arguments, so every pin gets its own.
+//
+#define gpio_edge_function(pin) \
+    static void gpio_edge_##pin() { \
+        gpio_edge_handler handler = __atomic_load_n(&gpio_edge_handlers[pin], __ATOMIC_ACQUIRE); \
+        if (handler) { \
+            handler((unsigned char) (pin), gpio_now()); \
+        } \
+    }
+
+gpio_edge_function(0)  gpio_edge_function(1)  gpio_edge_function(2)  gpio_edge_function(3)
+gpio_edge_function(4)  gpio_edge_function(5)  gpio_edge_function(6)  gpio_edge_function(7)
+gpio_edge_function(8)  gpio_edge_function(9)  gpio_edge_function(10) gpio_edge_function(11)
+gpio_edge_function(12) gpio_edge_function(13) gpio_edge_function(14) gpio_edge_function(15)
+gpio_edge_function(16) gpio_edge_function(17) gpio_edge_function(18) gpio_edge_function(19)
+gpio_edge_function(20) gpio_edge_function(21) gpio_edge_function(22) gpio_edge_function(23)
+gpio_edge_function(24) gpio_edge_function(25) gpio_edge_function(26) gpio_edge_function(27)
+gpio_edge_function(28) gpio_edge_function(29) gpio_edge_function(30) gpio_edge_function(31)
+
+static void (*const gpio_edge_functions[gpio_pin_count])(void) = {
+        gpio_edge_0, gpio_edge_1, gpio_edge_2, gpio_edge_3, gpio_edge_4, gpio_edge_5, gpio_edge_6, gpio_edge_7,
+        gpio_edge_8, gpio_edge_9, gpio_edge_10, gpio_edge_11, gpio_edge_12, gpio_edge_13, gpio_edge_14,
+        gpio_edge_15, gpio_edge_16, gpio_edge_17, gpio_edge_18, gpio_edge_19, gpio_edge_20, gpio_edge_21,
+        gpio_edge_22, gpio_edge_23, gpio_edge_24, gpio_edge_25, gpio_edge_26, gpio_edge_27, gpio_edge_28,
+        gpio_edge_29, gpio_edge_30, gpio_edge_31
+};
+
+bool gpio_watch_edges(unsigned char pin, gpio_edge_handler handler) {
+    if (pin >= gpio_pin_count) {
+        return false;
+    }
+
+    __atomic_store_n(&gpio_edge_handlers[pin], handler, __ATOMIC_RELEASE);
+
+    if (wiringPiISR(pin, INT_EDGE_RISING, gpio_edge_functions[pin]) < 0) {
+        ERROR_LOG("Unable to watch edges on pin %u", (unsigned int) pin);
+        __atomic_store_n(&gpio_edge_handlers[pin], NULL, __ATOMIC_RELEASE);
+        return false;
+    }
+
+    return true;
+}
+
+#else
+
+static pthread_mutex_t gpio_edge_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool gpio_edge_thread_running = false;
+
+// Emits the edges that are due every millisecond, time stamped where a steady signal of the
+// configured rate would have put them.  When the handlers cannot keep up the thread falls behind
+// instead of dropping edges, which is what a benchmark wants to see.
+//
+static void *gpio_emulate_edges(void *arg) {
+    (void) arg;
+
+    uint64_t rate = get_emulated_edge_rate();
+    uint64_t start = gpio_now();
+    uint64_t emitted = 0;
+
+    while (get_service_running()) {
+        uint64_t elapsed = gpio_now() - start;
+        uint64_t due = (elapsed / 1000000000ULL) * rate + (elapsed % 1000000000ULL) * rate / 1000000000ULL;
+
+        gpio_edge_handler handlers[gpio_pin_count];
+        for (int pin = 0; pin < gpio_pin_count; pin++) {
+            handlers[pin] = __atomic_load_n(&gpio_edge_handlers[pin], __ATOMIC_ACQUIRE);
+        }
+
+        for (; emitted < due; emitted++) {
+            uint64_t stamp = start + (emitted / rate) * 1000000000ULL + (emitted % rate) * 1000000000ULL / rate;
+
+            for (int pin = 0; pin < gpio_pin_count; pin++) {
+                if (handlers[pin]) {
+                    handlers[pin]((unsigned char) pin, stamp);
+                }
+            }
+        }
+
+        struct timespec pause = {0, 1000000};
+        nanosleep(&pause, NULL);
+    }
+
+    return NULL;
+}
+
+bool gpio_watch_edges(unsigned char pin, gpio_edge_handler handler) {
+    if (pin >= gpio_pin_count) {
+        return false;
+    }
+
+    __atomic_store_n(&gpio_edge_handlers[pin], handler, __ATOMIC_RELEASE);
+
+    pthread_mutex_lock(&gpio_edge_lock);
+
+    if (!gpio_edge_thread_running && get_emulated_edge_rate() > 0) {
+        pthread_t thread_id;
+
+        if (pthread_create(&thread_id, NULL, &gpio_emulate_edges, NULL) == 0) {
+            pthread_detach(thread_id);
+            gpio_edge_thread_running = true;
+            INFO_LOG("Emulating %u edges per second on counted pins", get_emulated_edge_rate());
+        }
+    }
+
+    pthread_mutex_unlock(&gpio_edge_lock);
+
+    return true;
+}
+
+#endif
+
 #pragma clang diagnostic pop
\ No newline at end of file
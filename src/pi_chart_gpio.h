@@ -29,6 +29,9 @@
 #ifndef PI_CHART_PI_CHART_GPIO_H
 #define PI_CHART_PI_CHART_GPIO_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 typedef enum {
     LOW_SIGNAL = 0,
     HIGH_SIGNAL = 1
@@ -45,16 +48,45 @@ typedef enum {
     MODE_ALT3,
 }gpio_mode;
 
+// Pin levels, bit N is set when pin N is HIGH.
+//
+typedef uint64_t gpio_bitset;
+
 void setup_wiring_pi();
 
+// Pins are numbered 0 to gpio_get_pin_count() - 1.
+//
+int gpio_get_pin_count();
+
 const char *gpio_get_digital_str(unsigned char pin);
 
 gpio_signal gpio_get_digital(unsigned char pin);
 
+// Reads the level of every pin in one go, on a Pi with a single read of the GPIO level registers
+// through /dev/gpiomem.
+//
+gpio_bitset gpio_snapshot();
+
+static inline gpio_signal gpio_snapshot_level(gpio_bitset snapshot, unsigned char pin) {
+    return pin < 64 && (snapshot >> pin) & 1 ? HIGH_SIGNAL : LOW_SIGNAL;
+}
+
+// Called for each rising edge of a watched pin with its CLOCK_MONOTONIC time in nanoseconds.
+// Runs on the thread that saw the edge, so it must not block.
+//
+typedef void (*gpio_edge_handler)(unsigned char pin, uint64_t nanoseconds);
+
+// Calls handler on every rising edge of pin, through wiringPiISR on a Pi.  The emulator feeds
+// get_emulated_edge_rate() edges per second to every watched pin from a thread of its own.
+//
+bool gpio_watch_edges(unsigned char pin, gpio_edge_handler handler);
+
 gpio_signal gpio_set_digital(unsigned char pin, gpio_signal value);
 
 const char *gpio_get_mode_str(unsigned char pin);
 
+const char *gpio_get_mode_name(gpio_mode mode);
+
 gpio_mode gpio_get_mode(unsigned char pin);
 
 #endif //PI_CHART_PI_CHART_GPIO_H
@@ -24,10 +24,9 @@
 //
 **********************************************************************/
 
-#ifndef __MACH__
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
+
 #include <strings.h>
-#endif
 
 #ifndef __unused
 #define __unused
@@ -36,115 +35,179 @@
 #include <pthread.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <signal.h>
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include "pi_utils.h"
 #include "pi_chart_settings.h"
 #include "pi_string.h"
-#include "pi_strmap.h"
+#include "pi_http_headers.h"
+#include "pi_file_cache.h"
 #include "pi_template_generator.h"
-#include "pi_chart_gpio.h"
-#include "pi_mem_info.h"
-#include "pi_process.h"
+#include "pi_chart_symbols.h"
+#include "pi_work_pool.h"
+#include "pi_cpu_stat.h"
+#include "pi_gpio_capture.h"
+#include "pi_sensor.h"
+#include "pi_gpio_edges.h"
+#include "pi_disk_stats.h"
+#include "pi_net_dev.h"
+#include "pi_process_stats.h"
+#include "pi_process_top.h"
+#include "pi_thermal.h"
+
+// Largest request header block we are willing to buffer for a single connection.
+//
+#define http_read_buffer_size 8192
 
-size_t http_read_line(int socket, pi_string_ptr output_string) {
-    if (NULL == output_string) {
-        return 0;
-    }
+// Number of events we pull off of epoll per wakeup.
+//
+#define http_max_events 64
+
+// How long epoll_wait blocks before we re-check if the service is still running.
+//
+#define http_poll_timeout_ms 1000
+
+// List of methods
+//
+typedef enum {
+    http_invalid,
+    http_get,
+    http_post,
+    http_delete,
+    http_put,
+    http_options,
+    http_head,
+    http_trace,
+    http_connect
+} http_method_t;
+
+// What we know about the request currently being answered.
+//
+typedef struct pi_http_request_struct {
+    http_method_t method;
+    pi_string_ptr path;
 
-    // Free the output_string because the expectation is that we are reading in a
-    // whole new line.
+    // What follows the '?' of the request line, a slice of the read buffer.
     //
-    pi_string_reset(output_string);
+    const char *query;
+    size_t query_length;
 
-    // Now we read in the data:
+    pi_http_headers_t headers;
+    bool keep_alive;
+
+    // Set when the response body is a static file sent straight from the cache.
     //
-    char c = '\0';
+    pi_file_entry_ptr body;
+} pi_http_request_t;
 
-    while (c != '\n') {
-        ssize_t n = recv(socket, &c, 1, 0);
+typedef pi_http_request_t *pi_http_request_ptr;
 
-        if (n > 0) {
-            if (c == '\r') {
-                n = recv(socket, &c, 1, MSG_PEEK);
+// Every client connection is driven by a small state machine:
+//
+//      reading -> (request complete) -> writing -> (response sent) -> closing
+//         ^                                                 |
+//         +------------------ (keep-alive) -----------------+
+//
+typedef enum {
+    connection_state_reading,
+    connection_state_writing,
+    connection_state_closing
+} connection_state_t;
 
-                if ((n > 0) && (c == '\n')) {
-                    recv(socket, &c, 1, 0);
-                }
-                else {
-                    c = '\n';
-                }
-            }
-            pi_string_append_char(output_string, c);
-        }
-        else {
-            c = '\n';
-        }
-    }
+typedef struct pi_connection_struct {
+    int socket;
+    connection_state_t state;
 
-    return pi_string_c_string_length(output_string);
-}
+    // Raw bytes received from the client, always null terminated.
+    //
+    char *read_buffer;
+    size_t read_length;
+    size_t read_position;
 
-// The following symbols should be supported:
-//      gpoi.#           - where the # is the pin number (1(true), 0(false))
-//      meminfo.MemTotal - total memory for the computer
-//      meminfo.MemFree  - total free memory on the computer
-//      process.name     - if the process with the "name" exits
-//                          string:  return pid
-//                          boolean: return true if running and false it not running
+    // The response headers (and the body for generated responses), optionally followed by a
+    // static file.  write_position counts across both.
+    //
+    pi_string_ptr response;
+    pi_file_entry_ptr response_file;
+    size_t write_position;
 
-const char *gpio_digital_tag = "gpio.digital";
-const char *gpio_mode_tag = "gpio.mode";
-const char *mem_info_tag = "meminfo.";
-const char *process_tag = "process.";
+    // Keep-alive bookkeeping.
+    //
+    bool keep_alive;
+    bool peer_closed;
+    unsigned int request_count;
+    time_t last_active;
 
-bool pi_chart_compare_tag(const char *symbol, const char *tag){
-    return strncmp(symbol, tag, strlen(tag)) == 0;
-}
+    // Set by the event loop while a worker owns the connection, only ever touched by the
+    // event loop thread so it can safely ignore events until the worker hands it back.
+    //
+    bool dispatched;
+    struct pi_connection_struct *next_completed;
 
-bool function_string(void __unused *context_ptr,
-                     const char *symbol,
-                     pi_string_ptr output_string) {
+    struct pi_connection_struct *next;
+    struct pi_connection_struct *prev;
+} pi_connection_t;
 
-    if (pi_chart_compare_tag(symbol, gpio_digital_tag)) {
-        int pin = atoi(&symbol[strlen(gpio_digital_tag)]);
-        pi_string_append_str(output_string, gpio_get_digital_str((unsigned char) pin));
-        return true;
-    }
+typedef pi_connection_t *pi_connection_ptr;
 
-    if (pi_chart_compare_tag(symbol, gpio_mode_tag)) {
-        int pin = atoi(&symbol[strlen(gpio_mode_tag)]);
-        pi_string_append_str(output_string, gpio_get_mode_str((unsigned char) pin));
-        return true;
-    }
+// Request counters, updated from the event loop and the workers.
+//
+typedef struct pi_server_stats_struct {
+    unsigned long long connections;
+    unsigned long long requests;
+    unsigned long long recv_calls;
+    unsigned long long send_calls;
+    unsigned long long request_bytes;
+    unsigned long long request_lines;
+    unsigned long long renders;
+    unsigned long long render_nanoseconds;
+} pi_server_stats_t;
+
+pi_server_stats_t g_server_stats;
+
+#define http_stats_add(field, value) __atomic_add_fetch(&g_server_stats.field, (value), __ATOMIC_RELAXED)
+#define http_stats_get(field) __atomic_load_n(&g_server_stats.field, __ATOMIC_RELAXED)
+
+// Returns the next line of the buffered request and terminates it in place, so the caller
+// can use it as a C string without copying.  "\r\n", "\n" and a lone "\r" all end a line.
+//
+char *http_read_line(pi_connection_ptr connection, size_t *length) {
+    char *line = connection->read_buffer + connection->read_position;
+    char *end = connection->read_buffer + connection->read_length;
+    char *ptr = line;
 
-    if (pi_chart_compare_tag(symbol, mem_info_tag)) {
-        return pi_mem_info_get_attribute(output_string, symbol + strlen(mem_info_tag));
+    while (ptr < end && *ptr != '\n' && *ptr != '\r') {
+        ptr++;
     }
 
-    return false;
-}
-
-bool function_boolean(void __unused *context_ptr,
-                      const char *symbol,
-                      bool *value) {
+    if (length) {
+        *length = (size_t) (ptr - line);
+    }
 
-    if (strncmp(symbol, "gpio.", 5) == 0) {
-        if (value) {
-            int pin = atoi(&symbol[5]);
-            *value = gpio_get_digital((unsigned char) pin) != 0;
+    if (ptr < end) {
+        if (*ptr == '\r' && ptr + 1 < end && *(ptr + 1) == '\n') {
+            *ptr++ = '\0';
         }
-        return true;
+        *ptr++ = '\0';
     }
 
-    if (pi_chart_compare_tag(symbol, process_tag)) {
-        return pi_process_exist(value, symbol + strlen(process_tag));
-    }
+    http_stats_add(request_bytes, ptr - line);
+    http_stats_add(request_lines, 1);
 
-    return false;
+    connection->read_position = (size_t) (ptr - connection->read_buffer);
+
+    return line;
 }
 
 void http_html_clean_string(pi_string_ptr request_path) {
@@ -190,21 +253,58 @@ size_t http_html_file_size(FILE *file_p) {
     return (size_t) file_size;
 }
 
-bool http_html_monitor_page(pi_string_ptr response,
-                            pi_strmap_ptr __unused headers,
-                            pi_string_ptr request_path) {
+void http_output_headers(pi_http_request_ptr request,
+                         pi_string_ptr response,
+                         const char *status,
+                         const char *content_type,
+                         size_t content_length) {
 
-    bool success = false;
+    pi_string_sprintf(response, "HTTP/1.1 %s\r\n", status);
+    pi_string_sprintf(response, "Server: %s\r\n", get_pi_chart_version());
+    pi_string_sprintf(response, "Content-Type: %s\r\n", content_type);
+    pi_string_sprintf(response, "Connection: %s\r\n", request->keep_alive ? "keep-alive" : "close");
+    pi_string_sprintf(response, "Content-Length: %zu\r\n", content_length);
+    pi_string_sprintf(response, "\r\n");
+}
 
-    // Strip out any bad characters.
-    //
-    http_html_clean_string(request_path);
+void http_output_body(pi_http_request_ptr request,
+                      pi_string_ptr response,
+                      const char *status,
+                      const char *content_type,
+                      pi_string_ptr response_body) {
 
-    // Check to see if we should load the default html page = index.html
+    http_output_headers(request, response, status, content_type, pi_string_c_string_length(response_body));
+    pi_string_append_str_length(response,
+                                pi_string_c_string(response_body),
+                                pi_string_c_string_length(response_body));
+}
+
+void http_html_render(pi_http_request_ptr request, pi_string_ptr response, pi_template_program_ptr program) {
+    pi_string_ptr response_body = pi_string_new(4096);
+
+    struct timespec start_time;
+    struct timespec end_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    pi_template_execute(program, response_body);
+
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    http_stats_add(renders, 1);
+    http_stats_add(render_nanoseconds,
+                   (end_time.tv_sec - start_time.tv_sec) * 1000000000LL + (end_time.tv_nsec - start_time.tv_nsec));
+
+    // Output the header and page
     //
-    if (strcmp(pi_string_c_string(request_path), "/") == 0) {
-        pi_string_append_str(request_path, "index.html");
-    }
+    http_output_body(request, response, "200 OK", "text/html", response_body);
+
+    pi_string_delete(response_body, true);
+}
+
+// Files too big for the cache are still read from disk on every request.
+//
+bool http_html_monitor_file(pi_http_request_ptr request, pi_string_ptr response, pi_string_ptr request_path) {
+
+    bool success = false;
 
     // Build file name
     //
@@ -224,24 +324,11 @@ bool http_html_monitor_page(pi_string_ptr response,
         if (fread(file_contents, file_size, sizeof(char), file_p) != 0) {
             // Setup buffers.
             //
-            pi_string_ptr input_buffer = pi_string_new(file_size + 1);
-            pi_string_append_str_length(input_buffer, file_contents, file_size);
-
-            pi_string_ptr response_body = pi_string_new(file_size + 1);
+            pi_template_program_ptr program = pi_template_compile(file_contents, file_size, pi_chart_symbol_providers());
 
-            pi_template_generate_output(input_buffer, response_body, NULL, function_string, function_boolean);
+            http_html_render(request, response, program);
 
-            // Output the header
-            //
-            pi_string_sprintf(response, "HTTP/1.0 200 OK\r\n");
-            pi_string_sprintf(response, "Server: %s\r\n", get_pi_chart_version());
-            pi_string_sprintf(response, "Content-Type: text/html\r\n");
-            pi_string_sprintf(response, "Connection: close\r\n");
-            pi_string_sprintf(response, "Content-Length: %d\r\n", pi_string_c_string_length(response_body));
-            pi_string_sprintf(response, "\r\n%s", pi_string_c_string(response_body));
-
-            pi_string_delete(response_body, true);
-            pi_string_delete(input_buffer, true);
+            pi_template_program_delete(program);
             success = true;
         }
         else {
@@ -265,336 +352,1406 @@ bool http_html_monitor_page(pi_string_ptr response,
     return success;
 }
 
+bool http_html_monitor_page(pi_http_request_ptr request, pi_string_ptr response) {
 
-void http_output_health_check(pi_string_ptr response) {
+    pi_string_ptr request_path = request->path;
 
-    pi_string_ptr response_body = pi_string_new(256);
+    bool success = false;
+
+    // Strip out any bad characters.
+    //
+    http_html_clean_string(request_path);
 
-    pi_string_sprintf(response_body, "{\"status\":\"UP\"");
+    // Check to see if we should load the default html page = index.html
+    //
+    if (strcmp(pi_string_c_string(request_path), "/") == 0) {
+        pi_string_append_str(request_path, "index.html");
+    }
 
-    pi_string_sprintf(response, "HTTP/1.0 200 OK\r\n");
-    pi_string_sprintf(response, "Server: %s\r\n", get_pi_chart_version());
-    pi_string_sprintf(response, "Transfer-Encoding: Identity\r\n");
-    pi_string_sprintf(response, "Content-Type: application/json;charset=UTF-8\r\n");
-    pi_string_sprintf(response, "Connection: close\r\n");
-    pi_string_sprintf(response, "Content-Length: %d\r\n", pi_string_c_string_length(response_body));
-    pi_string_sprintf(response, "\r\n%s", pi_string_c_string(response_body));
+    pi_file_entry_ptr entry = pi_file_cache_acquire(pi_string_c_string(request_path));
 
-    pi_string_delete(response_body, true);
+    if (NULL == entry) {
+        ERROR_LOG("File not found %s", pi_string_c_string(request_path));
+    }
+    else if (!entry->template) {
+        // Only the headers are built here, the connection sends the body from the cache.
+        //
+        pi_string_append_str(response, entry->response_header);
+        pi_string_sprintf(response, "Connection: %s\r\n\r\n", request->keep_alive ? "keep-alive" : "close");
+
+        request->body = entry;
+        entry = NULL;
+        success = true;
+    }
+    else if (entry->program) {
+        http_html_render(request, response, entry->program);
+        success = true;
+    }
+    else {
+        success = http_html_monitor_file(request, response, request_path);
+    }
+
+    pi_file_cache_release(entry);
+
+    return success;
 }
 
-void http_output_build_info(pi_string_ptr response) {
+
+void http_output_health_check(pi_http_request_ptr request, pi_string_ptr response) {
 
     pi_string_ptr response_body = pi_string_new(256);
 
-    pi_string_sprintf(response_body, "{\"version\":\"%s\", \"name\":\"pi-chart\"}", get_pi_chart_version());
+    pi_string_sprintf(response_body, "{\"status\":\"UP\"}");
 
-    pi_string_sprintf(response, "HTTP/1.0 200 OK\r\n");
-    pi_string_sprintf(response, "Server: %s\r\n", get_pi_chart_version());
-    pi_string_sprintf(response, "Content-Type: application/json;charset=UTF-8\r\n");
-    pi_string_sprintf(response, "Connection: close\r\n");
-    pi_string_sprintf(response, "Content-Length: %d\r\n", pi_string_c_string_length(response_body));
-    pi_string_sprintf(response, "\r\n%s", pi_string_c_string(response_body));
+    http_output_body(request, response, "200 OK", "application/json;charset=UTF-8", response_body);
 
     pi_string_delete(response_body, true);
 }
 
-void http_not_found(pi_string_ptr response) {
+void http_output_build_info(pi_http_request_ptr request, pi_string_ptr response) {
 
     pi_string_ptr response_body = pi_string_new(256);
 
-    pi_string_sprintf(response_body, "<HTML><TITLE>Not Found</TITLE>\r\n");
-    pi_string_sprintf(response_body, "<BODY><P>The server could not fulfill\r\n");
-    pi_string_sprintf(response_body, "your request because the resource specified\r\n");
-    pi_string_sprintf(response_body, "is unavailable or nonexistent.</P>\r\n");
-    pi_string_sprintf(response_body, "</BODY></HTML>\r\n");
-    pi_string_sprintf(response_body, "\r\n");
+    pi_string_sprintf(response_body, "{\"version\":\"%s\", \"name\":\"pi-chart\"}", get_pi_chart_version());
 
-    pi_string_sprintf(response, "HTTP/1.0 404 NOT FOUND\r\n");
-    pi_string_sprintf(response, "Server: %s\r\n", get_pi_chart_version());
-    pi_string_sprintf(response, "Content-Type: text/html\r\n");
-    pi_string_sprintf(response, "Connection: close\r\n");
-    pi_string_sprintf(response, "Content-Length: %d\r\n", pi_string_c_string_length(response_body));
-    pi_string_sprintf(response, "\r\n%s", pi_string_c_string(response_body));
+    http_output_body(request, response, "200 OK", "application/json;charset=UTF-8", response_body);
 
     pi_string_delete(response_body, true);
 }
 
-void http_output_response(pi_string_ptr request_path, pi_strmap_ptr headers, pi_string_ptr response) {
+// Reports how many syscalls requests cost.  recv_calls and send_calls are counted, while
+// estimated_legacy_recv_calls is only worked out from the bytes and lines parsed: the old one byte
+// at a time reader made one recv per byte plus a MSG_PEEK per line.  It is not a measurement.
+// render_microseconds is the average time spent executing a compiled template.
+//
+void http_output_server_stats(pi_http_request_ptr request, pi_string_ptr response) {
+
+    pi_string_ptr response_body = pi_string_new(512);
+
+    unsigned long long requests = http_stats_get(requests);
+    unsigned long long recv_calls = http_stats_get(recv_calls);
+    unsigned long long send_calls = http_stats_get(send_calls);
+    unsigned long long estimated_legacy_recv_calls = http_stats_get(request_bytes) + http_stats_get(request_lines);
+    double per_request = requests ? (double) requests : 1.0;
+    unsigned long long renders = http_stats_get(renders);
+    double render_microseconds = renders ? http_stats_get(render_nanoseconds) / 1000.0 / renders : 0.0;
+
+    pi_string_sprintf(response_body, "{\"connections\":%llu, \"requests\":%llu, ",
+                      http_stats_get(connections), requests);
+    pi_string_sprintf(response_body, "\"recv_calls\":%llu, \"send_calls\":%llu, ", recv_calls, send_calls);
+    pi_string_sprintf(response_body, "\"syscalls_per_request\":%.2f, ", (recv_calls + send_calls) / per_request);
+    pi_string_sprintf(response_body, "\"estimated_legacy_recv_calls\":%llu, ", estimated_legacy_recv_calls);
+    pi_string_sprintf(response_body, "\"estimated_legacy_syscalls_per_request\":%.2f, ",
+                      (estimated_legacy_recv_calls + send_calls) / per_request);
+    pi_string_sprintf(response_body, "\"renders\":%llu, \"render_microseconds\":%.2f, \"renders_per_second\":%.0f}",
+                      renders, render_microseconds, render_microseconds > 0 ? 1000000.0 / render_microseconds : 0.0);
+
+    http_output_body(request, response, "200 OK", "application/json;charset=UTF-8", response_body);
 
-    if (request_path && 0 == strncmp(pi_string_c_string(request_path), "/health", strlen("/health"))) {
-        // Do Health Checks
-        //
-        http_output_health_check(response);
-    }
-    else if (request_path && 0 == strncmp(pi_string_c_string(request_path), "/buildInfo", strlen("/buildInfo"))) {
-        // Output Build information
-        //
-        http_output_build_info(response);
-    }
-    else {
-        if (!http_html_monitor_page(response, headers, request_path)) {
-            http_not_found(response);
-        }
-    }
+    pi_string_delete(response_body, true);
 }
 
-void http_send_response(int socket, pi_string_ptr response) {
-    if (NULL != response) {
-        if (pi_string_c_string_length(response) > 0) {
-            send(socket,
-                 pi_string_c_string(response),
-                 pi_string_c_string_length(response), 0);
+// Appends value as a JSON string, process names may hold any character.
+//
+void http_json_append_string(pi_string_ptr json, const char *value) {
+    pi_string_append_char(json, '"');
+
+    for (const char *ptr = value; *ptr; ptr++) {
+        if (*ptr == '"' || *ptr == '\\') {
+            pi_string_append_char(json, '\\');
+            pi_string_append_char(json, *ptr);
+        }
+        else if ((unsigned char) *ptr < 0x20) {
+            pi_string_sprintf(json, "\\u%04x", (unsigned char) *ptr);
+        }
+        else {
+            pi_string_append_char(json, *ptr);
         }
     }
+
+    pi_string_append_char(json, '"');
 }
 
-int pi_chart_service_connection() {
+// Latest sample of every watched process, a process that is not running reports zeros.
+//
+void http_output_processes(pi_http_request_ptr request, pi_string_ptr response) {
+
+    pi_string_ptr response_body = pi_string_new(1024);
+    pi_process_watch_t watch;
+
+    pi_process_watch_get(&watch);
+
+    pi_string_append_str(response_body, "{\"processes\":[");
+
+    for (unsigned int i = 0; i < watch.count; i++) {
+        const double *values = watch.processes[i].values;
+
+        pi_string_append_str(response_body, i ? ", {\"name\":" : "{\"name\":");
+        http_json_append_string(response_body, watch.processes[i].name);
+        pi_string_sprintf(response_body, ", \"running\":%s, \"pid\":%.0f, \"cpu\":%.1f, ",
+                          values[process_metric_running] != 0 ? "true" : "false",
+                          values[process_metric_pid],
+                          values[process_metric_cpu]);
+        pi_string_sprintf(response_body, "\"rss\":%.0f, \"vsize\":%.0f, \"threads\":%.0f, ",
+                          values[process_metric_rss],
+                          values[process_metric_vsize],
+                          values[process_metric_threads]);
+        pi_string_sprintf(response_body, "\"read_bytes_per_sec\":%.0f, \"write_bytes_per_sec\":%.0f}",
+                          values[process_metric_read_rate],
+                          values[process_metric_write_rate]);
+    }
 
-    struct addrinfo hints;
-    memory_clear(&hints, sizeof hints);
+    pi_string_append_str(response_body, "]}");
 
-    hints.ai_family = AF_INET6;
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_flags = AI_PASSIVE;
+    http_output_body(request, response, "200 OK", "application/json;charset=UTF-8", response_body);
 
-    char port_string[16];   // needs to fit a short
-    memory_clear(port_string, sizeof port_string);
-    snprintf(port_string, sizeof port_string, "%d", get_server_port());
+    pi_string_delete(response_body, true);
+}
 
-    struct addrinfo *response = NULL;
-    getaddrinfo(NULL, port_string, &hints, &response);
+void http_json_append_cpu_usage(pi_string_ptr json, const pi_cpu_usage_t *usage) {
+    for (int i = 0; i < cpu_stat_field_count; i++) {
+        pi_string_sprintf(json, i ? ", \"%s\":%.1f" : "{\"%s\":%.1f",
+                          pi_cpu_stat_field_name((cpu_stat_field_t) i), usage->values[i]);
+    }
 
-    int socket_fd = socket(response->ai_family, response->ai_socktype, response->ai_protocol);
+    pi_string_append_char(json, '}');
+}
 
-    if (socket_fd == -1) {
-        ERROR_LOG("Unable to create socket, this is either a network issue where the port %"
-                          " is already in use or a bug in the service.", get_server_port());
-    }
-    else {
-        // The setsockopt() function is used to allow the local address to
-        // be reused when the server is restarted before the required wait
-        // time expires.
-        //
-        int option_one = 1;
-        if (setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR,
-                       (char *) &option_one, sizeof(option_one)) < 0) {
-            ERROR_LOG("Setsockopt(SO_REUSEADDR) failed, this is either"
-                              " a network issue or a bug in the service.");
-        }
+// CPU percentages since the last sample, for all cores together and for each core.
+//
+void http_output_cpu(pi_http_request_ptr request, pi_string_ptr response) {
 
-        if (bind(socket_fd, response->ai_addr, response->ai_addrlen) < 0) {
-            ERROR_LOG("Bind failed on socket %d, this is either a network "
-                              "issue or a bug in the service", socket_fd);
-            close(socket_fd);
-            socket_fd = -1;
-        }
+    pi_string_ptr response_body = pi_string_new(1024);
+    unsigned int core_count = pi_cpu_stat_core_count();
+    pi_cpu_usage_ptr usage = memory_alloc((core_count + 1) * sizeof(pi_cpu_usage_t));
 
-        // The backlog argument (5) defines the maximum length to which the queue of pending connections for
-        // sockfd may grow. If a connection request arrives when the queue is full, the client may receive an
-        // error with an indication of ECONNREFUSED or, if the underlying protocol supports
-        // retransmission, the request may be ignored so that a later reattempt at connection succeeds.
-        //
+    pi_cpu_stat_get(usage);
 
-        if (listen(socket_fd, 5) < 0) {
-            ERROR_LOG("listen debug failed");
-            close(socket_fd);
-            socket_fd = -1;
+    pi_string_append_str(response_body, "{\"cpu\":");
+    http_json_append_cpu_usage(response_body, &usage[0]);
+    pi_string_append_str(response_body, ", \"cores\":[");
+
+    for (unsigned int core = 0; core < core_count; core++) {
+        if (core) {
+            pi_string_append_str(response_body, ", ");
         }
+        http_json_append_cpu_usage(response_body, &usage[core + 1]);
     }
 
-    return socket_fd;
+    pi_string_append_str(response_body, "]}");
+
+    http_output_body(request, response, "200 OK", "application/json;charset=UTF-8", response_body);
+
+    memory_free(usage);
+    pi_string_delete(response_body, true);
 }
 
-// List of methods
+// Count and frequency of every pin whose edges are counted.
 //
-typedef enum {
-    http_invalid,
-    http_get,
-    http_post,
-    http_delete,
-    http_put,
-    http_options,
-    http_head,
-    http_trace,
-    http_connect
-} http_method_t;
+void http_output_edges(pi_http_request_ptr request, pi_string_ptr response) {
 
-http_method_t http_map_string_to_method(pi_string_ptr request_buffer) {
-    http_method_t result = http_invalid;
-    const char *method = pi_string_c_string(request_buffer);
-
-    if (0 == strncasecmp(method, "GET", 3)) {
-        result = http_get;
-    }
-    else if (0 == strncasecmp(method, "POST", 4)) {
-        result = http_post;
-    }
-    else if (0 == strncasecmp(method, "PUT", 3)) {
-        result = http_put;
-    }
-    else if (0 == strncasecmp(method, "DELETE", 6)) {
-        result = http_delete;
-    }
-    else if (0 == strncasecmp(method, "OPTIONS", 7)) {
-        result = http_options;
-    }
-    else if (0 == strncasecmp(method, "HEAD", 4)) {
-        result = http_head;
-    }
-    else if (0 == strncasecmp(method, "TRACE", 5)) {
-        result = http_trace;
-    }
-    else if (0 == strncasecmp(method, "CONNECT", 7)) {
-        result = http_connect;
-    }
+    pi_string_ptr response_body = pi_string_new(256);
+    pi_gpio_edges_t edges;
+    bool first = true;
 
-    return result;
-}
+    pi_gpio_edges_get(&edges);
 
-pi_string_ptr http_parse_path(pi_string_ptr request_buffer) {
-    const char *query = pi_string_c_string(request_buffer);
+    pi_string_append_str(response_body, "{\"pins\":[");
 
-    // Skip Method
-    //
-    while (*query != '\0' && *query != ' ' && *query != '\t') {
-        ++query;
-    }
+    for (int pin = 0; pin < gpio_edges_max_pins; pin++) {
+        if (!edges.pins[pin].counting) {
+            continue;
+        }
 
-    // Skip Spaces
-    //
-    while (*query != '\0' && (*query == ' ' || *query == '\t')) {
-        ++query;
+        pi_string_sprintf(response_body, "%s{\"pin\":%d, \"count\":%llu, \"hz\":%.2f}", first ? "" : ", ",
+                          pin, edges.pins[pin].count, edges.pins[pin].hz);
+        first = false;
     }
 
-    pi_string_ptr request_path = pi_string_new(256);
+    pi_string_append_str(response_body, "]}");
 
-    // Extract the path
-    //
-    while (*query != '\0' && *query != '?' && *query != ' ' && *query != '\t') {
-        pi_string_append_char(request_path, *query);
-        query++;
-    }
+    http_output_body(request, response, "200 OK", "application/json;charset=UTF-8", response_body);
 
-    return request_path;
+    pi_string_delete(response_body, true);
 }
 
-char *clean_string(char *value) {
-    char *zap = strrchr(value, '\n');
-    if (zap) *zap = 0;
-    zap = strrchr(value, '\r');
-    if (zap) *zap = 0;
-
-    if (*value == ' ') {
-        value++;
+// Scheduler statistics of every I2C bus and the last reading of every sensor on them.
+//
+void http_output_sensors(pi_http_request_ptr request, pi_string_ptr response) {
+
+    pi_string_ptr response_body = pi_string_new(1024);
+    pi_sensor_bus_stats_t buses[sensor_max_buses];
+    pi_sensor_ptr sensors[sensor_max_sensors];
+    unsigned int bus_count = min(pi_sensor_bus_stats(buses, sensor_max_buses), sensor_max_buses);
+    unsigned int sensor_count = min(pi_sensor_list(sensors, sensor_max_sensors), sensor_max_sensors);
+
+    pi_string_append_str(response_body, "{\"buses\":[");
+
+    for (unsigned int i = 0; i < bus_count; i++) {
+        pi_string_append_str(response_body, i ? ", {\"name\":" : "{\"name\":");
+        http_json_append_string(response_body, buses[i].name);
+        pi_string_sprintf(response_body,
+                          ", \"sensors\":%u, \"cycles\":%llu, \"readings\":%llu, \"errors\":%llu"
+                                  ", \"readings_per_sec\":%.2f, \"mean_latency_ms\":%.2f, \"max_latency_ms\":%.2f}",
+                          buses[i].sensors, buses[i].cycles, buses[i].readings, buses[i].errors,
+                          buses[i].readings_per_sec, buses[i].mean_latency_ms, buses[i].max_latency_ms);
     }
 
-    return value;
-}
+    pi_string_append_str(response_body, "], \"sensors\":[");
 
-size_t parse_headers(int client_socket, pi_strmap_ptr headers) {
-    size_t content_size = 0;
+    for (unsigned int i = 0; i < sensor_count; i++) {
+        const pi_sensor_driver_t *driver = pi_sensor_get_driver(sensors[i]);
+        pi_sensor_reading_t reading;
 
-    // Read the headers...
-    //
-    pi_string_ptr string_buffer_ptr = pi_string_new(256);
+        pi_sensor_get(sensors[i], &reading);
 
-    while (http_read_line(client_socket, string_buffer_ptr)) {
-        // Find the key and the value
-        //
-        char *key = pi_string_c_string(string_buffer_ptr);
-        char *value = pi_string_c_string(string_buffer_ptr);
+        pi_string_append_str(response_body, i ? ", {\"driver\":" : "{\"driver\":");
+        http_json_append_string(response_body, driver->name);
+        pi_string_append_str(response_body, ", \"bus\":");
+        http_json_append_string(response_body, pi_sensor_get_bus_name(sensors[i]));
+        pi_string_sprintf(response_body, ", \"address\":%u, \"valid\":%s",
+                          pi_sensor_get_address(sensors[i]), reading.valid ? "true" : "false");
 
-        // Look for the ':'
-        //
-        for (; *value && *value != ':'; value++);
+        if (reading.valid) {
+            for (int value = 0; value < sensor_max_values && driver->value_names[value]; value++) {
+                pi_string_append_str(response_body, ", ");
+                http_json_append_string(response_body, driver->value_names[value]);
+                pi_string_sprintf(response_body, ":%.2f", reading.values[value]);
+            }
 
-        // Get the "Value
-        //
-        if (*value == ':') {
-            *value = 0;
-            value++;
+            pi_string_sprintf(response_body, ", \"age\":%.1f", pi_sensor_age(&reading));
         }
 
-        key = clean_string(key);
-        value = clean_string(value);
+        pi_string_sprintf(response_body, ", \"reads\":%llu, \"errors\":%llu, \"latency_ms\":%.2f}",
+                          reading.reads, reading.errors, reading.latency_ms);
+    }
+
+    pi_string_append_str(response_body, "]}");
+
+    http_output_body(request, response, "200 OK", "application/json;charset=UTF-8", response_body);
+
+    pi_string_delete(response_body, true);
+}
+
+// Temperature of every thermal zone and frequency of every core.
+//
+void http_output_thermal(pi_http_request_ptr request, pi_string_ptr response) {
+
+    pi_string_ptr response_body = pi_string_new(1024);
+    pi_thermal_t thermal;
+
+    pi_thermal_get(&thermal);
+
+    pi_string_append_str(response_body, "{\"zones\":[");
+
+    for (unsigned int i = 0; i < thermal.zone_count; i++) {
+        pi_string_append_str(response_body, i ? ", {\"type\":" : "{\"type\":");
+        http_json_append_string(response_body, thermal.zones[i].type);
+
+        if (thermal.zones[i].present) {
+            pi_string_sprintf(response_body, ", \"celsius\":%.1f}", thermal.zones[i].celsius);
+        }
+        else {
+            pi_string_append_str(response_body, ", \"celsius\":null}");
+        }
+    }
+
+    pi_string_append_str(response_body, "], \"cpus\":[");
+
+    for (unsigned int i = 0; i < thermal.cpu_count; i++) {
+        if (thermal.cpus[i].present) {
+            pi_string_sprintf(response_body, "%s{\"mhz\":%.0f, \"max_mhz\":%.0f}", i ? ", " : "",
+                              thermal.cpus[i].mhz, thermal.cpus[i].max_mhz);
+        }
+        else {
+            pi_string_append_str(response_body, i ? ", null" : "null");
+        }
+    }
+
+    pi_string_append_str(response_body, "]}");
+
+    http_output_body(request, response, "200 OK", "application/json;charset=UTF-8", response_body);
+
+    pi_string_delete(response_body, true);
+}
+
+// Rates of every interface that currently exists.
+//
+void http_output_net(pi_http_request_ptr request, pi_string_ptr response) {
+
+    pi_string_ptr response_body = pi_string_new(1024);
+    pi_net_dev_t net_dev;
+    bool first = true;
+
+    pi_net_dev_get(&net_dev);
+
+    pi_string_append_str(response_body, "{\"interfaces\":[");
+
+    for (int i = 0; i < net_dev_max_interfaces; i++) {
+        const pi_net_interface_t *interface = &net_dev.interfaces[i];
+
+        if (!interface->present) {
+            continue;
+        }
+
+        pi_string_append_str(response_body, first ? "{\"name\":" : ", {\"name\":");
+        http_json_append_string(response_body, interface->name);
+
+        for (int metric = 0; metric < net_dev_metric_count; metric++) {
+            pi_string_sprintf(response_body, ", \"%s\":%.0f",
+                              pi_net_dev_metric_name((net_dev_metric_t) metric), interface->values[metric]);
+        }
+
+        pi_string_append_char(response_body, '}');
+        first = false;
+    }
+
+    pi_string_append_str(response_body, "]}");
+
+    http_output_body(request, response, "200 OK", "application/json;charset=UTF-8", response_body);
+
+    pi_string_delete(response_body, true);
+}
+
+// Rates, latency and utilization of every tracked block device that currently exists.
+//
+void http_output_disk(pi_http_request_ptr request, pi_string_ptr response) {
+
+    pi_string_ptr response_body = pi_string_new(1024);
+    pi_disk_stats_t disk_stats;
+    bool first = true;
+
+    pi_disk_stats_get(&disk_stats);
+
+    pi_string_append_str(response_body, "{\"devices\":[");
+
+    for (int i = 0; i < disk_stats_max_devices; i++) {
+        const pi_disk_device_t *device = &disk_stats.devices[i];
+
+        if (!device->present) {
+            continue;
+        }
+
+        pi_string_append_str(response_body, first ? "{\"name\":" : ", {\"name\":");
+        http_json_append_string(response_body, device->name);
+
+        for (int metric = 0; metric < disk_stats_metric_count; metric++) {
+            pi_string_sprintf(response_body, ", \"%s\":%.1f",
+                              pi_disk_stats_metric_name((disk_stats_metric_t) metric), device->values[metric]);
+        }
+
+        pi_string_append_char(response_body, '}');
+        first = false;
+    }
+
+    pi_string_append_str(response_body, "]}");
+
+    http_output_body(request, response, "200 OK", "application/json;charset=UTF-8", response_body);
+
+    pi_string_delete(response_body, true);
+}
+
+// Copies the value of the query parameter name into value, false if there is no such parameter.
+// Values are used as they are, without percent decoding.
+//
+bool http_query_value(pi_http_request_ptr request, const char *name, char *value, size_t size) {
+    const char *ptr = request->query;
+    const char *end = request->query + request->query_length;
+    size_t name_length = strlen(name);
+
+    while (ptr && ptr < end) {
+        const char *next = memchr(ptr, '&', (size_t) (end - ptr));
+        if (NULL == next) {
+            next = end;
+        }
+
+        if ((size_t) (next - ptr) > name_length && ptr[name_length] == '=' && 0 == strncmp(ptr, name, name_length)) {
+            size_t length = min((size_t) (next - ptr) - name_length - 1, size - 1);
+            memcpy(value, ptr + name_length + 1, length);
+            value[length] = '\0';
+            return true;
+        }
+
+        ptr = next + 1;
+    }
+
+    return false;
+}
+
+// /api/top?n=10&by=cpu|rss, served from the lists the top sampler keeps, nothing is sorted here.
+//
+void http_output_top(pi_http_request_ptr request, pi_string_ptr response) {
+
+    char value[16];
+    long count = 10;
+    int key = process_top_cpu;
+
+    if (http_query_value(request, "n", value, sizeof(value))) {
+        count = atol(value);
+    }
+
+    if (http_query_value(request, "by", value, sizeof(value))) {
+        key = pi_process_top_key(value);
+    }
+
+    if (key < 0 || count < 1 || count > process_top_max) {
+        pi_string_ptr response_body = pi_string_new(256);
+
+        pi_string_sprintf(response_body, "{\"error\":\"by must be cpu or rss and n between 1 and %d\"}",
+                          process_top_max);
+
+        http_output_body(request, response, "400 Bad Request", "application/json;charset=UTF-8", response_body);
+
+        pi_string_delete(response_body, true);
+        return;
+    }
+
+    pi_string_ptr response_body = pi_string_new(1024);
+    pi_process_top_t top;
+
+    pi_process_top_get((process_top_key_t) key, &top);
+
+    pi_string_sprintf(response_body, "{\"by\":\"%s\", \"processes\":[", key == process_top_cpu ? "cpu" : "rss");
+
+    for (unsigned int i = 0; i < top.count && i < (unsigned int) count; i++) {
+        pi_string_sprintf(response_body, i ? ", {\"pid\":%d, \"name\":" : "{\"pid\":%d, \"name\":",
+                          (int) top.entries[i].pid);
+        http_json_append_string(response_body, top.entries[i].name);
+        pi_string_sprintf(response_body, ", \"cpu\":%.1f, \"rss\":%.0f}", top.entries[i].cpu, top.entries[i].rss);
+    }
+
+    pi_string_append_str(response_body, "]}");
+
+    http_output_body(request, response, "200 OK", "application/json;charset=UTF-8", response_body);
+
+    pi_string_delete(response_body, true);
+}
+
+// Parses "2,3,17" (commas may come percent encoded) into a pin mask, 0 if it is not a list of
+// pins.
+//
+gpio_bitset http_parse_pins(const char *list) {
+    gpio_bitset pins = 0;
+
+    while (*list) {
+        char *end = NULL;
+        long pin = strtol(list, &end, 10);
+
+        if (end == list || pin < 0 || pin >= gpio_get_pin_count()) {
+            return 0;
+        }
+
+        pins |= (gpio_bitset) 1 << pin;
+
+        if (0 == strncasecmp(end, "%2C", 3)) {
+            end += 3;
+        }
+        else if (*end == ',') {
+            end++;
+        }
+        else if (*end != '\0') {
+            return 0;
+        }
+
+        list = end;
+    }
+
+    return pins;
+}
+
+void http_append_capture_status(pi_string_ptr response_body) {
+    pi_gpio_capture_status_t status;
+
+    pi_gpio_capture_status(&status);
+
+    pi_string_sprintf(response_body, "\"running\":%s, \"pins\":%llu, \"rate\":%u, \"samples\":%llu, "
+                                     "\"dropped\":%llu, \"samples_per_sec\":%.0f",
+                      status.running ? "true" : "false", (unsigned long long) status.pins, status.rate,
+                      status.samples, status.dropped, status.samples_per_sec);
+}
+
+// /api/capture/start?pins=2,3&rate=1000000, /api/capture/stop and /api/capture/status control
+// the logic analyzer, /api/capture downloads what it holds as runs of unchanged levels.
+//
+void http_output_capture(pi_http_request_ptr request, pi_string_ptr response, const char *action) {
+
+    pi_string_ptr response_body = pi_string_new(1024);
+    const char *status_line = "200 OK";
+
+    if (0 == strcmp(action, "/start")) {
+        char value[256];
+        gpio_bitset pins = http_query_value(request, "pins", value, sizeof(value)) ? http_parse_pins(value) : 0;
+        long rate = http_query_value(request, "rate", value, sizeof(value)) ? atol(value) : 0;
+
+        if (0 == pins || rate < 1 || rate > (long) gpio_capture_max_rate) {
+            pi_string_sprintf(response_body, "{\"error\":\"pins must list pins below %d and rate be between 1 and "
+                                             "%u\"}", gpio_get_pin_count(), gpio_capture_max_rate);
+
+            http_output_body(request, response, "400 Bad Request", "application/json;charset=UTF-8", response_body);
+
+            pi_string_delete(response_body, true);
+            return;
+        }
+
+        if (!pi_gpio_capture_start(pins, (unsigned int) rate)) {
+            status_line = "409 Conflict";
+        }
+    }
+    else if (0 == strcmp(action, "/stop")) {
+        pi_gpio_capture_stop();
+    }
+
+    pi_string_append_char(response_body, '{');
+    http_append_capture_status(response_body);
+
+    if (0 == strcmp(action, "")) {
+        pi_string_ptr runs = pi_string_new(4096);
+        unsigned long long first = pi_gpio_capture_encode(runs);
+
+        pi_string_sprintf(response_body, ", \"first\":%llu, \"runs\":", first);
+        pi_string_append_str(response_body, pi_string_c_string(runs));
+
+        pi_string_delete(runs, true);
+    }
+
+    pi_string_append_char(response_body, '}');
+
+    http_output_body(request, response, status_line, "application/json;charset=UTF-8", response_body);
+
+    pi_string_delete(response_body, true);
+}
+
+void http_not_found(pi_http_request_ptr request, pi_string_ptr response) {
+
+    pi_string_ptr response_body = pi_string_new(256);
+
+    pi_string_sprintf(response_body, "<HTML><TITLE>Not Found</TITLE>\r\n");
+    pi_string_sprintf(response_body, "<BODY><P>The server could not fulfill\r\n");
+    pi_string_sprintf(response_body, "your request because the resource specified\r\n");
+    pi_string_sprintf(response_body, "is unavailable or nonexistent.</P>\r\n");
+    pi_string_sprintf(response_body, "</BODY></HTML>\r\n");
+    pi_string_sprintf(response_body, "\r\n");
+
+    http_output_body(request, response, "404 NOT FOUND", "text/html", response_body);
+
+    pi_string_delete(response_body, true);
+}
+
+void http_output_response(pi_http_request_ptr request, pi_string_ptr response) {
+    pi_string_ptr request_path = request->path;
+
+    if (request_path && 0 == strncmp(pi_string_c_string(request_path), "/health", strlen("/health"))) {
+        // Do Health Checks
+        //
+        http_output_health_check(request, response);
+    }
+    else if (request_path && 0 == strncmp(pi_string_c_string(request_path), "/buildInfo", strlen("/buildInfo"))) {
+        // Output Build information
+        //
+        http_output_build_info(request, response);
+    }
+    else if (request_path && 0 == strncmp(pi_string_c_string(request_path), "/serverStats", strlen("/serverStats"))) {
+        // Output request and syscall counters
+        //
+        http_output_server_stats(request, response);
+    }
+    else if (request_path && 0 == strcmp(pi_string_c_string(request_path), "/api/processes")) {
+        // Output the watched processes
+        //
+        http_output_processes(request, response);
+    }
+    else if (request_path && 0 == strcmp(pi_string_c_string(request_path), "/api/cpu")) {
+        // Output CPU utilization
+        //
+        http_output_cpu(request, response);
+    }
+    else if (request_path && 0 == strcmp(pi_string_c_string(request_path), "/api/thermal")) {
+        // Output temperatures and CPU frequencies
+        //
+        http_output_thermal(request, response);
+    }
+    else if (request_path && 0 == strcmp(pi_string_c_string(request_path), "/api/edges")) {
+        // Output GPIO edge counts
+        //
+        http_output_edges(request, response);
+    }
+    else if (request_path && (0 == strcmp(pi_string_c_string(request_path), "/api/capture")
+                              || 0 == strcmp(pi_string_c_string(request_path), "/api/capture/start")
+                              || 0 == strcmp(pi_string_c_string(request_path), "/api/capture/stop")
+                              || 0 == strcmp(pi_string_c_string(request_path), "/api/capture/status"))) {
+        // Control the GPIO capture or download it
+        //
+        http_output_capture(request, response, pi_string_c_string(request_path) + strlen("/api/capture"));
+    }
+    else if (request_path && 0 == strcmp(pi_string_c_string(request_path), "/api/sensors")) {
+        // Output the I2C sensors and their bus schedulers
+        //
+        http_output_sensors(request, response);
+    }
+    else if (request_path && 0 == strcmp(pi_string_c_string(request_path), "/api/net")) {
+        // Output network interface rates
+        //
+        http_output_net(request, response);
+    }
+    else if (request_path && 0 == strcmp(pi_string_c_string(request_path), "/api/disk")) {
+        // Output block device I/O
+        //
+        http_output_disk(request, response);
+    }
+    else if (request_path && 0 == strcmp(pi_string_c_string(request_path), "/api/top")) {
+        // Output the processes using the most CPU or memory
+        //
+        http_output_top(request, response);
+    }
+    else {
+        if (!http_html_monitor_page(request, response)) {
+            http_not_found(request, response);
+        }
+    }
+}
+
+int pi_chart_service_connection() {
+
+    struct addrinfo hints;
+    memory_clear(&hints, sizeof hints);
+
+    hints.ai_family = AF_INET6;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    char port_string[16];   // needs to fit a short
+    memory_clear(port_string, sizeof port_string);
+    snprintf(port_string, sizeof port_string, "%d", get_server_port());
+
+    struct addrinfo *response = NULL;
+    getaddrinfo(NULL, port_string, &hints, &response);
+
+    int socket_fd = socket(response->ai_family, response->ai_socktype, response->ai_protocol);
+
+    if (socket_fd == -1) {
+        ERROR_LOG("Unable to create socket, this is either a network issue where the port %"
+                          " is already in use or a bug in the service.", get_server_port());
+    }
+    else {
+        // The setsockopt() function is used to allow the local address to
+        // be reused when the server is restarted before the required wait
+        // time expires.
+        //
+        int option_one = 1;
+        if (setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR,
+                       (char *) &option_one, sizeof(option_one)) < 0) {
+            ERROR_LOG("Setsockopt(SO_REUSEADDR) failed, this is either"
+                              " a network issue or a bug in the service.");
+        }
+
+        if (bind(socket_fd, response->ai_addr, response->ai_addrlen) < 0) {
+            ERROR_LOG("Bind failed on socket %d, this is either a network "
+                              "issue or a bug in the service", socket_fd);
+            close(socket_fd);
+            socket_fd = -1;
+        }
+
+        // The backlog argument (SOMAXCONN) defines the maximum length to which the queue of pending connections for
+        // sockfd may grow. If a connection request arrives when the queue is full, the client may receive an
+        // error with an indication of ECONNREFUSED or, if the underlying protocol supports
+        // retransmission, the request may be ignored so that a later reattempt at connection succeeds.
+        // Now that connections are multiplexed we want the kernel to queue as many as it allows.
+        //
+
+        if (-1 != socket_fd && listen(socket_fd, SOMAXCONN) < 0) {
+            ERROR_LOG("listen debug failed");
+            close(socket_fd);
+            socket_fd = -1;
+        }
+    }
+
+    return socket_fd;
+}
+
+http_method_t http_map_string_to_method(const char *method) {
+    http_method_t result = http_invalid;
+
+    if (0 == strncasecmp(method, "GET", 3)) {
+        result = http_get;
+    }
+    else if (0 == strncasecmp(method, "POST", 4)) {
+        result = http_post;
+    }
+    else if (0 == strncasecmp(method, "PUT", 3)) {
+        result = http_put;
+    }
+    else if (0 == strncasecmp(method, "DELETE", 6)) {
+        result = http_delete;
+    }
+    else if (0 == strncasecmp(method, "OPTIONS", 7)) {
+        result = http_options;
+    }
+    else if (0 == strncasecmp(method, "HEAD", 4)) {
+        result = http_head;
+    }
+    else if (0 == strncasecmp(method, "TRACE", 5)) {
+        result = http_trace;
+    }
+    else if (0 == strncasecmp(method, "CONNECT", 7)) {
+        result = http_connect;
+    }
+
+    return result;
+}
+
+pi_string_ptr http_parse_path(const char *request_line) {
+    const char *query = request_line;
+
+    // Skip Method
+    //
+    while (*query != '\0' && *query != ' ' && *query != '\t') {
+        ++query;
+    }
 
-        if (*key && *value) {
-            pi_strmap_put(headers, key, value);
-        }
+    // Skip Spaces
+    //
+    while (*query != '\0' && (*query == ' ' || *query == '\t')) {
+        ++query;
+    }
+
+    pi_string_ptr request_path = pi_string_new(256);
+
+    // Extract the path
+    //
+    while (*query != '\0' && *query != '?' && *query != ' ' && *query != '\t') {
+        pi_string_append_char(request_path, *query);
+        query++;
+    }
+
+    return request_path;
+}
+
+// Finds the query string of the request line, if it has one.
+//
+const char *http_parse_query(const char *request_line, size_t *length) {
+    const char *query = strchr(request_line, ' ');
+    *length = 0;
+
+    while (query && (*query == ' ' || *query == '\t')) {
+        query++;
+    }
+
+    while (query && *query != '\0' && *query != '?' && *query != ' ' && *query != '\t') {
+        query++;
+    }
+
+    if (NULL == query || *query != '?') {
+        return NULL;
+    }
+
+    query++;
+
+    const char *end = query;
+    while (*end != '\0' && *end != ' ' && *end != '\t') {
+        end++;
+    }
+
+    *length = (size_t) (end - query);
+
+    return query;
+}
+
+// Records the header lines as slices of the read buffer, no copies and no allocations.
+//
+void parse_headers(pi_connection_ptr connection, pi_http_headers_ptr headers) {
+    size_t length = 0;
+
+    pi_http_headers_reset(headers, connection->read_buffer);
+
+    while (connection->read_position < connection->read_length) {
+        char *line = http_read_line(connection, &length);
 
         // Check to see if we have hit the end...
         //
-        if (*key == '\0') {
+        if (0 == length) {
             // We hit the end!
             //
             break;
         }
 
-        // OK look of content length
+        if (!pi_http_headers_parse_line(headers,
+                                        (unsigned int) (line - connection->read_buffer),
+                                        (unsigned int) length)) {
+            DEBUG_LOG("Ignoring header line: %s", line);
+        }
+    }
+}
+
+time_t http_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec;
+}
+
+bool http_set_non_blocking(int socket) {
+    int flags = fcntl(socket, F_GETFL, 0);
+
+    if (flags < 0 || fcntl(socket, F_SETFL, flags | O_NONBLOCK) < 0) {
+        ERROR_LOG("Unable to make socket %d non-blocking, errno: %d", socket, errno);
+        return false;
+    }
+
+    return true;
+}
+
+pi_connection_ptr g_connections = NULL;
+
+pi_connection_ptr http_connection_new(int client_socket) {
+    pi_connection_ptr connection = memory_alloc(sizeof(pi_connection_t));
+
+    connection->socket = client_socket;
+    connection->state = connection_state_reading;
+    connection->last_active = http_now();
+    connection->read_buffer = memory_alloc(http_read_buffer_size);
+
+    // Track the connection so we can clean up when the service stops.
+    //
+    connection->next = g_connections;
+    if (g_connections) {
+        g_connections->prev = connection;
+    }
+    g_connections = connection;
+
+    return connection;
+}
+
+void http_connection_delete(pi_connection_ptr connection) {
+    if (connection->prev) {
+        connection->prev->next = connection->next;
+    }
+    else {
+        g_connections = connection->next;
+    }
+
+    if (connection->next) {
+        connection->next->prev = connection->prev;
+    }
+
+    // Closing the socket also removes it from the epoll set.
+    //
+    close(connection->socket);
+
+    pi_string_delete(connection->response, true);
+    pi_file_cache_release(connection->response_file);
+    memory_free(connection->read_buffer);
+    memory_free(connection);
+}
+
+// Returns true once the blank line that terminates the request headers has been buffered.
+//
+bool http_request_complete(pi_connection_ptr connection) {
+    const char *request = connection->read_buffer + connection->read_position;
+
+    return NULL != strstr(request, "\r\n\r\n") || NULL != strstr(request, "\n\n");
+}
+
+// HTTP/1.1 connections stay open unless the client asks us to close them, HTTP/1.0 clients
+// have to ask for keep-alive.
+//
+bool http_request_keep_alive(pi_connection_ptr connection, const char *request_line, pi_http_headers_ptr headers) {
+    if (connection->peer_closed
+        || connection->request_count >= get_max_keep_alive_requests()
+        || !get_service_running()) {
+        return false;
+    }
+
+    const char *version = strrchr(request_line, ' ');
+    bool http_1_1 = version && 0 == strcasecmp(version + 1, "HTTP/1.1");
+
+    if (pi_http_headers_has_token(headers, http_header_connection, "close")) {
+        return false;
+    }
+
+    if (pi_http_headers_has_token(headers, http_header_connection, "keep-alive")) {
+        return true;
+    }
+
+    return http_1_1;
+}
+
+// True if a body may follow the headers.  A Content-Length that is not a plain zero counts as one,
+// so does any Transfer-Encoding, whatever its coding.
+//
+bool http_request_has_body(pi_http_headers_ptr headers) {
+    const char *value = NULL;
+    size_t length = 0;
+
+    if (pi_http_headers_get(headers, http_header_transfer_encoding, &value, &length)) {
+        return true;
+    }
+
+    if (!pi_http_headers_get(headers, http_header_content_length, &value, &length)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < length; i++) {
+        if (value[i] != '0') {
+            return true;
+        }
+    }
+
+    return 0 == length;
+}
+
+void http_connection_process(pi_connection_ptr connection) {
+    http_stats_add(requests, 1);
+    connection->request_count++;
+
+    const char *request_line = http_read_line(connection, NULL);
+
+    pi_http_request_t request;
+    memory_clear(&request, sizeof(request));
+
+    request.method = http_map_string_to_method(request_line);
+    request.path = http_parse_path(request_line);
+    request.query = http_parse_query(request_line, &request.query_length);
+
+    parse_headers(connection, &request.headers);
+
+    // We never read request bodies, so only keep the connection if there is nothing to skip.  A
+    // body left in the buffer would otherwise be parsed as the next request.  Neither can be ruled
+    // out once a header line was dropped.
+    //
+    request.keep_alive = !request.headers.dropped
+                         && !http_request_has_body(&request.headers)
+                         && http_request_keep_alive(connection, request_line, &request.headers);
+    connection->keep_alive = request.keep_alive;
+
+    connection->response = pi_string_new(1024);
+    connection->write_position = 0;
+
+    switch (request.method) {
+        case http_get:
+            http_output_response(&request, connection->response);
+            break;
+        default:
+            http_not_found(&request, connection->response);
+            break;
+    }
+
+    connection->response_file = request.body;
+    connection->state = connection_state_writing;
+
+    pi_string_delete(request.path, true);
+}
+
+// Drops the request we just answered from the read buffer, anything left over is the start of
+// the next (pipelined) request.
+//
+void http_connection_next_request(pi_connection_ptr connection) {
+    size_t remaining = connection->read_length - connection->read_position;
+
+    memmove(connection->read_buffer, connection->read_buffer + connection->read_position, remaining);
+    connection->read_buffer[remaining] = '\0';
+    connection->read_length = remaining;
+    connection->read_position = 0;
+
+    pi_string_delete(connection->response, true);
+    connection->response = NULL;
+    pi_file_cache_release(connection->response_file);
+    connection->response_file = NULL;
+    connection->write_position = 0;
+
+    connection->state = connection_state_reading;
+}
+
+void http_connection_write(pi_connection_ptr connection);
+
+// Workers hand finished connections back to the event loop through this list and poke the
+// eventfd so epoll wakes up.
+//
+pi_work_pool_ptr g_work_pool = NULL;
+int g_completion_fd = -1;
+pthread_mutex_t g_completion_lock = PTHREAD_MUTEX_INITIALIZER;
+pi_connection_ptr g_completed_connections = NULL;
+
+// Marks the eventfd in epoll, the listening socket uses NULL.
+//
+static int g_completion_marker = 0;
+
+void http_connection_work(void *work) {
+    pi_connection_ptr connection = work;
+
+    http_connection_process(connection);
+    http_connection_write(connection);
+
+    pthread_mutex_lock(&g_completion_lock);
+    connection->next_completed = g_completed_connections;
+    g_completed_connections = connection;
+    pthread_mutex_unlock(&g_completion_lock);
+
+    uint64_t one = 1;
+    if (write(g_completion_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        ERROR_LOG("Unable to signal the event loop, errno: %d", errno);
+    }
+}
+
+void http_connection_dispatch(pi_connection_ptr connection) {
+    connection->dispatched = true;
+
+    if (!pi_work_pool_submit(g_work_pool, connection)) {
+        connection->dispatched = false;
+        http_connection_process(connection);
+    }
+}
+
+void http_connection_read(pi_connection_ptr connection) {
+    // Edge triggered, so keep reading until the kernel tells us there is nothing left.
+    //
+    while (connection->state == connection_state_reading && !connection->peer_closed) {
+        size_t available = http_read_buffer_size - connection->read_length - 1;
+
+        if (0 == available) {
+            // Full, either of pipelined requests we will get back to or of one oversized request.
+            //
+            break;
+        }
+
+        ssize_t n = recv(connection->socket, connection->read_buffer + connection->read_length, available, 0);
+        http_stats_add(recv_calls, 1);
+
+        if (n > 0) {
+            connection->read_length += n;
+            connection->read_buffer[connection->read_length] = '\0';
+            connection->last_active = http_now();
+        }
+        else if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        else {
+            // Client finished sending or the socket failed, a request that is already
+            // buffered still gets its answer.
+            //
+            connection->peer_closed = true;
+            break;
+        }
+    }
+
+    if (connection->state != connection_state_reading) {
+        return;
+    }
+
+    if (!http_request_complete(connection)) {
+        if (connection->read_length + 1 >= http_read_buffer_size) {
+            ERROR_LOG("Request on socket %d exceeded %d bytes, closing", connection->socket, http_read_buffer_size);
+            connection->state = connection_state_closing;
+        }
+        else if (connection->peer_closed) {
+            connection->state = connection_state_closing;
+        }
+    }
+    else {
+        if (g_work_pool) {
+            http_connection_dispatch(connection);
+        }
+        else {
+            http_connection_process(connection);
+        }
+    }
+}
+
+// Sends the next chunk of the response: headers and in-memory bodies go out together with one
+// gathered write, big static files are streamed by the kernel with sendfile.
+//
+ssize_t http_connection_send(pi_connection_ptr connection) {
+    size_t header_length = pi_string_c_string_length(connection->response);
+    pi_file_entry_ptr file = connection->response_file;
+    size_t position = connection->write_position;
+
+    if (file && NULL == file->contents && position >= header_length) {
+        off_t offset = (off_t) (position - header_length);
+        return sendfile(connection->socket, file->fd, &offset, file->size - (size_t) offset);
+    }
+
+    struct iovec iov[2];
+    int iov_count = 0;
+
+    if (position < header_length) {
+        iov[iov_count].iov_base = pi_string_c_string(connection->response) + position;
+        iov[iov_count].iov_len = header_length - position;
+        iov_count++;
+    }
+
+    if (file && file->contents) {
+        size_t body_position = position > header_length ? position - header_length : 0;
+
+        iov[iov_count].iov_base = file->contents + body_position;
+        iov[iov_count].iov_len = file->size - body_position;
+        iov_count++;
+    }
+
+    // sendmsg is writev that lets us ask for EPIPE instead of SIGPIPE.
+    //
+    struct msghdr message;
+    memory_clear(&message, sizeof(message));
+    message.msg_iov = iov;
+    message.msg_iovlen = (size_t) iov_count;
+
+    return sendmsg(connection->socket, &message, MSG_NOSIGNAL);
+}
+
+void http_connection_write(pi_connection_ptr connection) {
+    size_t length = pi_string_c_string_length(connection->response);
+
+    if (connection->response_file) {
+        length += connection->response_file->size;
+    }
+
+    while (connection->write_position < length) {
+        ssize_t n = http_connection_send(connection);
+        http_stats_add(send_calls, 1);
+
+        if (n > 0) {
+            connection->write_position += n;
+            connection->last_active = http_now();
+        }
+        else if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // Socket buffer is full, wait for EPOLLOUT.
+            //
+            return;
+        }
+        else {
+            connection->keep_alive = false;
+            break;
+        }
+    }
+
+    if (connection->keep_alive) {
+        http_connection_next_request(connection);
+    }
+    else {
+        connection->state = connection_state_closing;
+    }
+}
+
+void http_connection_on_event(pi_connection_ptr connection, uint32_t events) {
+    if (connection->dispatched) {
+        // A worker owns it, whatever happened will be picked up when it is handed back.
+        //
+        return;
+    }
+
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        connection->state = connection_state_closing;
+    }
+
+    // With edge triggered events we may have missed an edge while a worker held the
+    // connection, so always try to make progress instead of trusting the event mask.
+    // Keep going while requests are pipelined behind each other.
+    //
+    while (!connection->dispatched) {
+        connection_state_t state = connection->state;
+
+        if (state == connection_state_reading) {
+            http_connection_read(connection);
+        }
+        else if (state == connection_state_writing) {
+            http_connection_write(connection);
+        }
+        else {
+            http_connection_delete(connection);
+            break;
+        }
+
+        // Stop once we are waiting on the socket.
         //
-        if (0 == strncmp(key, "Content-Length", 32)) {
-            content_size = (size_t) atol(value);
+        if (!connection->dispatched && connection->state == state) {
+            break;
+        }
+    }
+}
+
+// Closes connections that have been quiet for longer than the keep-alive timeout.
+//
+void http_connection_sweep() {
+    time_t now = http_now();
+    pi_connection_ptr connection = g_connections;
+
+    while (connection) {
+        pi_connection_ptr next = connection->next;
+
+        if (!connection->dispatched && now - connection->last_active >= get_keep_alive_timeout()) {
+            http_connection_delete(connection);
         }
+
+        connection = next;
+    }
+}
+
+void http_connection_completed() {
+    uint64_t count = 0;
+    if (read(g_completion_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        ERROR_LOG("Unable to read the completion eventfd, errno: %d", errno);
     }
 
-    pi_string_delete(string_buffer_ptr, true);
-    return content_size;
+    pthread_mutex_lock(&g_completion_lock);
+    pi_connection_ptr connection = g_completed_connections;
+    g_completed_connections = NULL;
+    pthread_mutex_unlock(&g_completion_lock);
+
+    while (connection) {
+        pi_connection_ptr next = connection->next_completed;
+
+        connection->next_completed = NULL;
+        connection->dispatched = false;
+        http_connection_on_event(connection, 0);
+
+        connection = next;
+    }
 }
 
+void http_accept_connections(int epoll_fd, int socket_fd) {
+    while (true) {
+        struct sockaddr_storage sockaddr_client;
+        socklen_t sockaddr_client_length = sizeof(sockaddr_client);
+        memory_clear(&sockaddr_client, sockaddr_client_length);
+
+        int client_socket = accept4(socket_fd,
+                                    (struct sockaddr *) &sockaddr_client,
+                                    &sockaddr_client_length,
+                                    SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (client_socket < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                ERROR_LOG("Accept failed on socket %d, errno: %d", socket_fd, errno);
+            }
+            break;
+        }
+
+        http_stats_add(connections, 1);
+
+        pi_connection_ptr connection = http_connection_new(client_socket);
+
+        struct epoll_event event;
+        memory_clear(&event, sizeof(event));
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.ptr = connection;
+
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_socket, &event) < 0) {
+            ERROR_LOG("Unable to add socket %d to epoll, errno: %d", client_socket, errno);
+            http_connection_delete(connection);
+        }
+    }
+}
 
 void *pi_server_thread(void __unused *arg) {
 
     INFO_LOG("Starting server thread on port %hu", get_server_port());
 
     if (get_server_port()) {
+        // sendfile has no MSG_NOSIGNAL, so a client hanging up mid transfer would raise SIGPIPE and
+        // stop the service.  Block it here, the workers inherit the mask and just see EPIPE.
+        //
+        sigset_t signal_set;
+        sigemptyset(&signal_set);
+        sigaddset(&signal_set, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &signal_set, NULL);
+
         int socket_fd = pi_chart_service_connection();
 
-        if (-1 != socket_fd) {
+        if (-1 != socket_fd && http_set_non_blocking(socket_fd)) {
             INFO_LOG("[INFO] Service has taking the stage on port %d", get_server_port());
 
-            pi_string_ptr request_buffer = NULL;
-
-            while (get_service_running()) {
-                request_buffer = pi_string_new(1024);
-
-                struct sockaddr_in sockaddr_client;
-                socklen_t sockaddr_client_length = sizeof(sockaddr_client);
-                memory_clear(&sockaddr_client, sockaddr_client_length);
-
-                int client_socket = accept(socket_fd, (struct sockaddr *) &sockaddr_client, &sockaddr_client_length);
+            int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
 
-                http_read_line(client_socket, request_buffer);
+            // The listening socket is the only entry without a connection attached.
+            //
+            struct epoll_event listen_event;
+            memory_clear(&listen_event, sizeof(listen_event));
+            listen_event.events = EPOLLIN | EPOLLET;
+            listen_event.data.ptr = NULL;
 
-                http_method_t method = http_map_string_to_method(request_buffer);
+            g_completion_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
 
-                pi_string_ptr request_path = http_parse_path(request_buffer);
+            struct epoll_event completion_event;
+            memory_clear(&completion_event, sizeof(completion_event));
+            completion_event.events = EPOLLIN | EPOLLET;
+            completion_event.data.ptr = &g_completion_marker;
 
-                pi_string_ptr response_buffer = pi_string_new(1024);
+            if (epoll_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, socket_fd, &listen_event) < 0) {
+                ERROR_LOG("[ERROR] Unable to setup epoll for socket %d, errno: %d", socket_fd, errno);
+            }
+            else if (g_completion_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, g_completion_fd, &completion_event) < 0) {
+                ERROR_LOG("[ERROR] Unable to setup the worker completion eventfd, errno: %d", errno);
+            }
+            else {
+                // With no workers every request is handled on this thread.
+                //
+                if (get_worker_count()) {
+                    g_work_pool = pi_work_pool_new(get_worker_count(), http_connection_work);
+                }
 
-                pi_strmap_ptr headers = pi_strmap_new(32);
+                struct epoll_event events[http_max_events];
+                time_t last_sweep = http_now();
 
-                parse_headers(client_socket, headers);
+                while (get_service_running()) {
+                    int count = epoll_wait(epoll_fd, events, http_max_events, http_poll_timeout_ms);
 
-                switch (method) {
-                    case http_get:
-                        http_output_response(request_path, headers, response_buffer);
-                        break;
-                    default:
-                        http_not_found(response_buffer);
+                    if (count < 0 && errno != EINTR) {
+                        ERROR_LOG("[ERROR] epoll_wait failed, errno: %d", errno);
                         break;
+                    }
+
+                    bool completed = false;
+
+                    for (int i = 0; i < count; i++) {
+                        if (NULL == events[i].data.ptr) {
+                            http_accept_connections(epoll_fd, socket_fd);
+                        }
+                        else if (&g_completion_marker == events[i].data.ptr) {
+                            completed = true;
+                        }
+                        else {
+                            http_connection_on_event(events[i].data.ptr, events[i].events);
+                        }
+                    }
+
+                    // Handed back connections may be closed, so only look at them once nothing
+                    // else in this batch can still point at them.
+                    //
+                    if (completed) {
+                        http_connection_completed();
+                    }
+
+                    if (http_now() != last_sweep) {
+                        last_sweep = http_now();
+                        http_connection_sweep();
+                    }
                 }
+            }
 
-                http_send_response(client_socket, response_buffer);
+            // Wait for the workers before tearing down the connections they may still be using.
+            //
+            pi_work_pool_delete(g_work_pool);
+            g_work_pool = NULL;
 
-                close(client_socket);
+            while (g_connections) {
+                http_connection_delete(g_connections);
+            }
 
-                pi_string_delete(response_buffer, true);
-                pi_string_delete(request_path, true);
-                pi_strmap_delete(headers);
+            if (g_completion_fd >= 0) {
+                close(g_completion_fd);
+                g_completion_fd = -1;
             }
-            pi_string_delete(request_buffer, true);
 
+            if (epoll_fd >= 0) {
+                close(epoll_fd);
+            }
             close(socket_fd);
         }
         else {
@@ -612,4 +1769,3 @@ void pi_chart_service_start() {
         pthread_create(&g_server_thread_id, NULL, &pi_server_thread, NULL);
     }
 }
-
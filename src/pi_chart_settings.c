@@ -37,6 +37,17 @@ unsigned short server_port = 8090;
 bool service_running = false;
 char *default_directory = ".";
 pi_string_ptr file_directory = NULL;
+int worker_count = -1;
+unsigned int keep_alive_timeout = 5;
+unsigned int max_keep_alive_requests = 100;
+unsigned int sample_interval = 1000;
+bool process_events = true;
+pi_string_ptr watch_list = NULL;
+pi_string_ptr sysfs_root = NULL;
+pi_string_ptr count_pins = NULL;
+unsigned int emulated_edge_rate = 0;
+pi_string_ptr i2c_bus = NULL;
+unsigned int emulated_sensors = 0;
 
 const char *get_pi_chart_version() {
     return PI_CHART_VERSION;
@@ -94,3 +105,144 @@ const char *get_file_directory() {
 
     return pi_string_c_string(file_directory);
 }
+
+unsigned int get_worker_count() {
+    if (worker_count < 0) {
+        // Default to one worker per online core.
+        //
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        return cores > 0 ? (unsigned int) cores : 1;
+    }
+
+    return (unsigned int) worker_count;
+}
+
+void set_worker_count(unsigned int value) {
+    worker_count = (int) value;
+}
+
+unsigned int get_keep_alive_timeout() {
+    return keep_alive_timeout;
+}
+
+void set_keep_alive_timeout(unsigned int value) {
+    keep_alive_timeout = value;
+}
+
+unsigned int get_max_keep_alive_requests() {
+    return max_keep_alive_requests;
+}
+
+void set_max_keep_alive_requests(unsigned int value) {
+    max_keep_alive_requests = value;
+}
+
+unsigned int get_sample_interval() {
+    return sample_interval;
+}
+
+void set_sample_interval(unsigned int value) {
+    sample_interval = value < 10 ? 10 : value;
+}
+
+bool get_process_events() {
+    return process_events;
+}
+
+void set_process_events(bool value) {
+    process_events = value;
+}
+
+void set_watch_list(char *value) {
+    if (NULL == watch_list) {
+        watch_list = pi_string_new(strlen(value));
+    }
+
+    pi_string_reset(watch_list);
+    pi_string_append_str(watch_list, value);
+}
+
+const char *get_watch_list() {
+    if (NULL == watch_list) {
+        return "";
+    }
+
+    return pi_string_c_string(watch_list);
+}
+
+void set_sysfs_root(char *value) {
+    if (NULL == sysfs_root) {
+        sysfs_root = pi_string_new(strlen(value));
+    }
+
+    pi_string_reset(sysfs_root);
+    pi_string_append_str(sysfs_root, value);
+}
+
+const char *get_sysfs_root() {
+    if (NULL == sysfs_root) {
+#ifdef __MACH__
+        // Mac OS Emulator code
+        //
+        return "./sys";
+#else
+        return "/sys";
+#endif
+    }
+
+    return pi_string_c_string(sysfs_root);
+}
+
+void set_count_pins(char *value) {
+    if (NULL == count_pins) {
+        count_pins = pi_string_new(strlen(value));
+    }
+
+    pi_string_reset(count_pins);
+    pi_string_append_str(count_pins, value);
+}
+
+const char *get_count_pins() {
+    if (NULL == count_pins) {
+        return "";
+    }
+
+    return pi_string_c_string(count_pins);
+}
+
+unsigned int get_emulated_edge_rate() {
+    return emulated_edge_rate;
+}
+
+void set_emulated_edge_rate(unsigned int value) {
+    emulated_edge_rate = value;
+}
+
+void set_i2c_bus(char *value) {
+    if (NULL == i2c_bus) {
+        i2c_bus = pi_string_new(strlen(value));
+    }
+
+    pi_string_reset(i2c_bus);
+    pi_string_append_str(i2c_bus, value);
+}
+
+const char *get_i2c_bus() {
+    if (NULL == i2c_bus) {
+#ifdef BCMHOST
+        return "/dev/i2c-1";
+#else
+        return "emulated";
+#endif
+    }
+
+    return pi_string_c_string(i2c_bus);
+}
+
+unsigned int get_emulated_sensors() {
+    return emulated_sensors;
+}
+
+void set_emulated_sensors(unsigned int value) {
+    emulated_sensors = value;
+}
@@ -54,4 +54,64 @@ void set_file_directory(char *directory);
 
 const char *get_file_directory();
 
+unsigned int get_worker_count();
+
+void set_worker_count(unsigned int value);
+
+unsigned int get_keep_alive_timeout();
+
+void set_keep_alive_timeout(unsigned int value);
+
+unsigned int get_max_keep_alive_requests();
+
+void set_max_keep_alive_requests(unsigned int value);
+
+// Milliseconds between samples of /proc and the other system sources.
+//
+unsigned int get_sample_interval();
+
+void set_sample_interval(unsigned int value);
+
+// Track processes through the netlink process connector instead of scanning /proc.
+//
+bool get_process_events();
+
+void set_process_events(bool value);
+
+// Comma separated names of processes to sample, on top of the ones templates ask for.
+//
+void set_watch_list(char *value);
+
+const char *get_watch_list();
+
+// Where sysfs is mounted, a copy of the tree lets the samplers run against fake devices.
+//
+void set_sysfs_root(char *value);
+
+const char *get_sysfs_root();
+
+// Comma separated pins whose rising edges are counted, on top of the ones templates ask for.
+//
+void set_count_pins(char *value);
+
+const char *get_count_pins();
+
+// Rising edges per second the emulator feeds every counted pin, 0 for none.
+//
+unsigned int get_emulated_edge_rate();
+
+void set_emulated_edge_rate(unsigned int value);
+
+// I2C bus the sensors are on, "emulated" for the bus that only exists in memory.
+//
+void set_i2c_bus(char *value);
+
+const char *get_i2c_bus();
+
+// Extra AM2315 sensors on the emulated bus, for measuring the bus scheduler.
+//
+unsigned int get_emulated_sensors();
+
+void set_emulated_sensors(unsigned int value);
+
 #endif //PI_CHART_SETTINGS_H
@@ -0,0 +1,1085 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pi_chart_symbols.h"
+#include "pi_am2315.h"
+#include "pi_chart_gpio.h"
+#include "pi_gpio_edges.h"
+#include "pi_mem_info.h"
+#include "pi_cpu_stat.h"
+#include "pi_disk_stats.h"
+#include "pi_net_dev.h"
+#include "pi_process.h"
+#include "pi_process_stats.h"
+#include "pi_process_top.h"
+#include "pi_thermal.h"
+#include "pi_utils.h"
+
+#ifndef __unused
+#define __unused
+#endif
+
+// The following symbols are supported:
+//      gpio.digital.#   - "HIGH" or "LOW" for pin #, as a boolean true when HIGH
+//      gpio.mode.#      - mode of pin #: IN, OUT, ALT0...ALT5
+//      gpio.#           - boolean, true when pin # is HIGH
+//      gpio.count.#     - rising edges counted on pin #, as a boolean true once there was one.
+//                         Naming a pin in a template starts counting it.
+//      gpio.hz.#        - frequency of the rising edges on pin #
+//      meminfo.MemTotal - any field of /proc/meminfo, e.g. total memory for the computer
+//      meminfo.MemFree  - total free memory on the computer
+//      thermal.#        - temperature of thermal zone # in Celsius, as a boolean true when the
+//                         zone could be read
+//      thermal.#.type   - what zone # measures, e.g. cpu-thermal
+//      thermal.count    - number of thermal zones
+//      cpufreq.#        - current frequency of core # in MHz, as a boolean true when the core
+//                         has cpufreq
+//      cpufreq.#.max    - highest frequency of core # in MHz
+//      cpufreq.count    - number of cores
+//      am2315.temperature - Celsius from the AM2315, also humidity (%), empty until the first good
+//                         reading.  Naming the sensor in a template starts polling it.
+//      am2315.age       - seconds since the last good reading, also errors
+//      am2315.fresh     - boolean, true while the last good reading is recent
+//      cpu.user         - percent of time all cores spent in user mode since the last sample, also
+//                         nice, system, idle, iowait, irq, softirq, steal and usage (not idle)
+//      cpu.#.user       - the same for core #
+//      cpu.count        - number of cores
+//      net.eth0.rx_bytes_per_sec - receive rate of an interface, also tx_bytes_per_sec and the
+//                         rx/tx packets, errors and drops per second
+//      net.eth0         - boolean, true while the interface exists
+//      disk.mmcblk0.read_bytes_per_sec - read rate of a block device, also write_bytes_per_sec,
+//                         reads_per_sec, writes_per_sec, read_latency_ms, write_latency_ms,
+//                         utilization (% of time busy) and in_flight.  Naming a partition in a
+//                         template starts tracking it.
+//      disk.mmcblk0     - boolean, true while the device exists
+//      process.name     - boolean, true if the process with the "name" is running
+//      process.name.cpu - CPU% of a watched process, also pid, rss, vsize (kB), threads,
+//                         read_bytes_per_sec and write_bytes_per_sec.  Naming a process in a
+//                         template adds it to the watch list.
+//      top.cpu.#.name   - name of the process using the #th most CPU (1 based), also pid, cpu and
+//                         rss.  top.rss.# ranks by resident memory.  top.cpu.# alone is a
+//                         boolean, true when there is a #th process.
+//
+
+// Highest pin number a tag may name.
+//
+#define symbols_max_pin 63
+
+#define symbols_pin_slots (symbols_max_pin + 1)
+
+typedef struct pi_chart_gpio_levels_struct {
+    gpio_bitset levels;
+} pi_chart_gpio_levels_t;
+
+typedef struct pi_chart_gpio_modes_struct {
+    gpio_mode modes[symbols_pin_slots];
+} pi_chart_gpio_modes_t;
+
+// One read of every pin per page.
+//
+void *pi_chart_symbols_levels_snapshot() {
+    pi_chart_gpio_levels_t *snapshot = memory_alloc(sizeof(pi_chart_gpio_levels_t));
+
+    snapshot->levels = gpio_snapshot();
+
+    return snapshot;
+}
+
+void *pi_chart_symbols_modes_snapshot() {
+    pi_chart_gpio_modes_t *snapshot = memory_alloc(sizeof(pi_chart_gpio_modes_t));
+    int pin_count = min(gpio_get_pin_count(), symbols_pin_slots);
+
+    for (int pin = 0; pin < pin_count; pin++) {
+        snapshot->modes[pin] = gpio_get_mode((unsigned char) pin);
+    }
+
+    return snapshot;
+}
+
+// Copies the sampler's latest meminfo, renders never read /proc/meminfo themselves.
+//
+void *pi_chart_symbols_mem_info_snapshot() {
+    pi_mem_info_ptr snapshot = memory_alloc(sizeof(pi_mem_info_t));
+
+    pi_mem_info_get(snapshot);
+
+    return snapshot;
+}
+
+bool pi_chart_symbols_bind_pin(const char *name, int *field) {
+    char *end = NULL;
+    long pin = strtol(name, &end, 10);
+
+    if (end == name || *end != '\0' || pin < 0 || pin > symbols_max_pin) {
+        return false;
+    }
+
+    *field = (int) pin;
+
+    return true;
+}
+
+bool pi_chart_symbols_digital_string(const pi_template_symbol_t *symbol, void *snapshot, pi_string_ptr value) {
+    pi_chart_gpio_levels_t *gpio = snapshot;
+
+    if (NULL == gpio) {
+        return false;
+    }
+
+    pi_string_append_str(value, gpio_snapshot_level(gpio->levels, (unsigned char) symbol->field) == LOW_SIGNAL
+                                ? "LOW" : "HIGH");
+    return true;
+}
+
+bool pi_chart_symbols_digital_boolean(const pi_template_symbol_t *symbol, void *snapshot, bool *value) {
+    pi_chart_gpio_levels_t *gpio = snapshot;
+
+    if (NULL == gpio) {
+        return false;
+    }
+
+    *value = gpio_snapshot_level(gpio->levels, (unsigned char) symbol->field) != LOW_SIGNAL;
+    return true;
+}
+
+bool pi_chart_symbols_mode_string(const pi_template_symbol_t *symbol, void *snapshot, pi_string_ptr value) {
+    pi_chart_gpio_modes_t *gpio = snapshot;
+
+    if (NULL == gpio) {
+        return false;
+    }
+
+    pi_string_append_str(value, gpio_get_mode_name(gpio->modes[symbol->field]));
+    return true;
+}
+
+// Copies the latest edge counts.
+//
+void *pi_chart_symbols_edges_snapshot() {
+    pi_gpio_edges_ptr snapshot = memory_alloc(sizeof(pi_gpio_edges_t));
+
+    pi_gpio_edges_get(snapshot);
+
+    return snapshot;
+}
+
+bool pi_chart_symbols_bind_edge_pin(const char *name, int *field) {
+    return pi_chart_symbols_bind_pin(name, field) && pi_gpio_edges_count((unsigned char) *field);
+}
+
+bool pi_chart_symbols_edge_count_string(const pi_template_symbol_t *symbol, void *snapshot, pi_string_ptr value) {
+    pi_gpio_edges_ptr edges = snapshot;
+
+    if (NULL == edges) {
+        return false;
+    }
+
+    pi_string_sprintf(value, "%llu", edges->pins[symbol->field].count);
+    return true;
+}
+
+bool pi_chart_symbols_edge_count_boolean(const pi_template_symbol_t *symbol, void *snapshot, bool *value) {
+    pi_gpio_edges_ptr edges = snapshot;
+
+    if (NULL == edges) {
+        return false;
+    }
+
+    *value = edges->pins[symbol->field].count > 0;
+    return true;
+}
+
+bool pi_chart_symbols_edge_hz_string(const pi_template_symbol_t *symbol, void *snapshot, pi_string_ptr value) {
+    pi_gpio_edges_ptr edges = snapshot;
+
+    if (NULL == edges) {
+        return false;
+    }
+
+    pi_string_sprintf(value, "%.2f", edges->pins[symbol->field].hz);
+    return true;
+}
+
+// Names the table does not know bind to -1 and are looked up among the sample's extra lines,
+// so any field of /proc/meminfo renders as it did before the table existed.
+//
+bool pi_chart_symbols_bind_mem_info(const char *name, int *field) {
+    *field = pi_mem_info_field(name);
+
+    return *field >= 0 || (strlen(name) > 0 && strlen(name) < mem_info_name_length);
+}
+
+bool pi_chart_symbols_mem_info_string(const pi_template_symbol_t *symbol, void *snapshot, pi_string_ptr value) {
+    pi_mem_info_ptr mem_info = snapshot;
+
+    if (NULL == mem_info) {
+        return false;
+    }
+
+    unsigned long long extra = 0;
+
+    if (symbol->field >= 0) {
+        pi_string_sprintf(value, "%llu", mem_info->values[symbol->field]);
+    }
+    else if (pi_mem_info_find_extra(mem_info, symbol->name, &extra)) {
+        pi_string_sprintf(value, "%llu", extra);
+    }
+
+    return true;
+}
+
+// Copies the thermal sampler's latest temperatures and frequencies.
+//
+void *pi_chart_symbols_thermal_snapshot() {
+    pi_thermal_ptr snapshot = memory_alloc(sizeof(pi_thermal_t));
+
+    pi_thermal_get(snapshot);
+
+    return snapshot;
+}
+
+#define thermal_symbol_value 0
+#define thermal_symbol_detail 1
+
+// "count", "#" or "#.<detail>", field is # times 2 plus thermal_symbol_value or
+// thermal_symbol_detail, -1 for the count.
+//
+static bool pi_chart_symbols_bind_indexed(const char *name, const char *detail, unsigned int limit, int *field) {
+    if (0 == strcmp(name, "count")) {
+        *field = -1;
+        return true;
+    }
+
+    if (*name < '0' || *name > '9') {
+        return false;
+    }
+
+    char *end = NULL;
+    long index = strtol(name, &end, 10);
+
+    if (index >= (long) limit) {
+        return false;
+    }
+
+    if (*end == '\0') {
+        *field = (int) index * 2 + thermal_symbol_value;
+    }
+    else if (*end == '.' && 0 == strcmp(end + 1, detail)) {
+        *field = (int) index * 2 + thermal_symbol_detail;
+    }
+    else {
+        return false;
+    }
+
+    return true;
+}
+
+bool pi_chart_symbols_bind_thermal(const char *name, int *field) {
+    return pi_chart_symbols_bind_indexed(name, "type", thermal_max_zones, field);
+}
+
+bool pi_chart_symbols_thermal_string(const pi_template_symbol_t *symbol, void *snapshot, pi_string_ptr value) {
+    pi_thermal_ptr thermal = snapshot;
+
+    if (NULL == thermal) {
+        return false;
+    }
+
+    if (symbol->field < 0) {
+        pi_string_sprintf(value, "%u", thermal->zone_count);
+        return true;
+    }
+
+    const pi_thermal_zone_t *zone = &thermal->zones[symbol->field / 2];
+
+    if (symbol->field % 2 == thermal_symbol_detail) {
+        pi_string_append_str(value, zone->type);
+    }
+    else {
+        pi_string_sprintf(value, "%.1f", zone->celsius);
+    }
+
+    return true;
+}
+
+bool pi_chart_symbols_thermal_boolean(const pi_template_symbol_t *symbol, void *snapshot, bool *value) {
+    pi_thermal_ptr thermal = snapshot;
+
+    if (NULL == thermal) {
+        return false;
+    }
+
+    *value = symbol->field < 0 ? thermal->zone_count > 0 : thermal->zones[symbol->field / 2].present;
+    return true;
+}
+
+bool pi_chart_symbols_bind_cpu_freq(const char *name, int *field) {
+    return pi_chart_symbols_bind_indexed(name, "max", thermal_max_cpus, field);
+}
+
+bool pi_chart_symbols_cpu_freq_string(const pi_template_symbol_t *symbol, void *snapshot, pi_string_ptr value) {
+    pi_thermal_ptr thermal = snapshot;
+
+    if (NULL == thermal) {
+        return false;
+    }
+
+    if (symbol->field < 0) {
+        pi_string_sprintf(value, "%u", thermal->cpu_count);
+        return true;
+    }
+
+    const pi_cpu_freq_t *cpu = &thermal->cpus[symbol->field / 2];
+
+    pi_string_sprintf(value, "%.0f", symbol->field % 2 == thermal_symbol_detail ? cpu->max_mhz : cpu->mhz);
+    return true;
+}
+
+bool pi_chart_symbols_cpu_freq_boolean(const pi_template_symbol_t *symbol, void *snapshot, bool *value) {
+    pi_thermal_ptr thermal = snapshot;
+
+    if (NULL == thermal) {
+        return false;
+    }
+
+    *value = symbol->field < 0 ? thermal->cpu_count > 0 : thermal->cpus[symbol->field / 2].present;
+    return true;
+}
+
+// Copies the AM2315's last reading.
+//
+void *pi_chart_symbols_am2315_snapshot() {
+    pi_sensor_reading_ptr snapshot = memory_alloc(sizeof(pi_sensor_reading_t));
+    pi_sensor_ptr sensor = pi_am2315_sensor();
+
+    if (NULL != sensor) {
+        pi_sensor_get(sensor, snapshot);
+    }
+
+    return snapshot;
+}
+
+static bool pi_chart_symbols_am2315_fresh(const pi_sensor_reading_t *reading) {
+    pi_sensor_ptr sensor = pi_am2315_sensor();
+
+    return NULL != sensor && pi_sensor_fresh(sensor, reading);
+}
+
+static const char *am2315_symbols[] = {"temperature", "humidity", "age", "errors", "fresh", NULL};
+
+#define am2315_symbol_temperature 0
+#define am2315_symbol_humidity 1
+#define am2315_symbol_age 2
+#define am2315_symbol_errors 3
+#define am2315_symbol_fresh 4
+
+bool pi_chart_symbols_bind_am2315(const char *name, int *field) {
+    for (int i = 0; am2315_symbols[i]; i++) {
+        if (0 == strcmp(name, am2315_symbols[i])) {
+            *field = i;
+            return NULL != pi_am2315_start();
+        }
+    }
+
+    return false;
+}
+
+bool pi_chart_symbols_am2315_string(const pi_template_symbol_t *symbol, void *snapshot, pi_string_ptr value) {
+    pi_sensor_reading_ptr reading = snapshot;
+
+    if (NULL == reading) {
+        return false;
+    }
+
+    switch (symbol->field) {
+        case am2315_symbol_temperature:
+            if (reading->valid) {
+                pi_string_sprintf(value, "%.1f", reading->values[am2315_temperature]);
+            }
+            break;
+
+        case am2315_symbol_humidity:
+            if (reading->valid) {
+                pi_string_sprintf(value, "%.1f", reading->values[am2315_humidity]);
+            }
+            break;
+
+        case am2315_symbol_age:
+            if (reading->valid) {
+                pi_string_sprintf(value, "%.0f", pi_sensor_age(reading));
+            }
+            break;
+
+        case am2315_symbol_errors:
+            pi_string_sprintf(value, "%llu", reading->errors);
+            break;
+
+        default:
+            pi_string_append_str(value, pi_chart_symbols_am2315_fresh(reading) ? "true" : "false");
+            break;
+    }
+
+    return true;
+}
+
+bool pi_chart_symbols_am2315_boolean(const pi_template_symbol_t *symbol, void *snapshot, bool *value) {
+    pi_sensor_reading_ptr reading = snapshot;
+
+    if (NULL == reading) {
+        return false;
+    }
+
+    *value = symbol->field == am2315_symbol_errors ? reading->errors > 0 : pi_chart_symbols_am2315_fresh(reading);
+    return true;
+}
+
+// Copies the watch sampler's latest per-process metrics.
+//
+void *pi_chart_symbols_process_watch_snapshot() {
+    pi_process_watch_ptr snapshot = memory_alloc(sizeof(pi_process_watch_t));
+
+    pi_process_watch_get(snapshot);
+
+    return snapshot;
+}
+
+// Copies the CPU sampler's latest percentages, all cores first.
+//
+void *pi_chart_symbols_cpu_snapshot() {
+    pi_cpu_usage_ptr snapshot = memory_alloc((pi_cpu_stat_core_count() + 1) * sizeof(pi_cpu_usage_t));
+
+    pi_cpu_stat_get(snapshot);
+
+    return snapshot;
+}
+
+// "user" or "3.user", field is the entry (0 for all cores, N + 1 for core N) times
+// cpu_stat_field_count plus the field.  "count" binds to -1.
+//
+bool pi_chart_symbols_bind_cpu(const char *name, int *field) {
+    if (0 == strcmp(name, "count")) {
+        *field = -1;
+        return true;
+    }
+
+    long entry = 0;
+
+    if (*name >= '0' && *name <= '9') {
+        char *end = NULL;
+        long core = strtol(name, &end, 10);
+
+        if (*end != '.' || core >= (long) pi_cpu_stat_core_count()) {
+            return false;
+        }
+
+        entry = core + 1;
+        name = end + 1;
+    }
+
+    int stat_field = pi_cpu_stat_field(name);
+
+    if (stat_field < 0) {
+        return false;
+    }
+
+    *field = (int) entry * cpu_stat_field_count + stat_field;
+
+    return true;
+}
+
+bool pi_chart_symbols_cpu_string(const pi_template_symbol_t *symbol, void *snapshot, pi_string_ptr value) {
+    pi_cpu_usage_ptr usage = snapshot;
+
+    if (symbol->field < 0) {
+        pi_string_sprintf(value, "%u", pi_cpu_stat_core_count());
+        return true;
+    }
+
+    if (NULL == usage) {
+        return false;
+    }
+
+    pi_string_sprintf(value, "%.1f",
+                      usage[symbol->field / cpu_stat_field_count].values[symbol->field % cpu_stat_field_count]);
+    return true;
+}
+
+// Copies the network sampler's latest rates.
+//
+void *pi_chart_symbols_net_snapshot() {
+    pi_net_dev_ptr snapshot = memory_alloc(sizeof(pi_net_dev_t));
+
+    pi_net_dev_get(snapshot);
+
+    return snapshot;
+}
+
+#define net_symbol_present net_dev_metric_count
+
+// "eth0" or "eth0.rx_bytes_per_sec", interface names may hold dots themselves.  field is the
+// slot times (net_dev_metric_count + 1) plus the metric, net_symbol_present for a bare name.
+//
+bool pi_chart_symbols_bind_net(const char *name, int *field) {
+    const char *dot = strrchr(name, '.');
+    int metric = dot ? pi_net_dev_metric(dot + 1) : -1;
+    size_t length = metric >= 0 ? (size_t) (dot - name) : strlen(name);
+
+    if (0 == length || length >= net_dev_name_length) {
+        return false;
+    }
+
+    char interface[net_dev_name_length];
+    memory_clear(interface, sizeof(interface));
+    memcpy(interface, name, length);
+
+    int slot = pi_net_dev_bind(interface);
+
+    if (slot < 0) {
+        return false;
+    }
+
+    *field = slot * (net_dev_metric_count + 1) + (metric >= 0 ? metric : net_symbol_present);
+
+    return true;
+}
+
+bool pi_chart_symbols_net_string(const pi_template_symbol_t *symbol, void *snapshot, pi_string_ptr value) {
+    pi_net_dev_ptr net_dev = snapshot;
+
+    if (NULL == net_dev) {
+        return false;
+    }
+
+    const pi_net_interface_t *interface = &net_dev->interfaces[symbol->field / (net_dev_metric_count + 1)];
+    int metric = symbol->field % (net_dev_metric_count + 1);
+
+    if (metric == net_symbol_present) {
+        pi_string_append_str(value, interface->present ? "true" : "false");
+    }
+    else {
+        pi_string_sprintf(value, "%.0f", interface->values[metric]);
+    }
+
+    return true;
+}
+
+bool pi_chart_symbols_net_boolean(const pi_template_symbol_t *symbol, void *snapshot, bool *value) {
+    pi_net_dev_ptr net_dev = snapshot;
+
+    if (NULL == net_dev) {
+        return false;
+    }
+
+    const pi_net_interface_t *interface = &net_dev->interfaces[symbol->field / (net_dev_metric_count + 1)];
+    int metric = symbol->field % (net_dev_metric_count + 1);
+
+    *value = metric == net_symbol_present ? interface->present : interface->values[metric] != 0;
+    return true;
+}
+
+// Copies the block device sampler's latest rates.
+//
+void *pi_chart_symbols_disk_snapshot() {
+    pi_disk_stats_ptr snapshot = memory_alloc(sizeof(pi_disk_stats_t));
+
+    pi_disk_stats_get(snapshot);
+
+    return snapshot;
+}
+
+#define disk_symbol_present disk_stats_metric_count
+
+// "mmcblk0" or "mmcblk0.utilization", field is the slot times (disk_stats_metric_count + 1) plus
+// the metric, disk_symbol_present for a bare name.
+//
+bool pi_chart_symbols_bind_disk(const char *name, int *field) {
+    const char *dot = strrchr(name, '.');
+    int metric = dot ? pi_disk_stats_metric(dot + 1) : -1;
+    size_t length = metric >= 0 ? (size_t) (dot - name) : strlen(name);
+
+    if (0 == length || length >= disk_stats_name_length) {
+        return false;
+    }
+
+    char device[disk_stats_name_length];
+    memory_clear(device, sizeof(device));
+    memcpy(device, name, length);
+
+    int slot = pi_disk_stats_bind(device);
+
+    if (slot < 0) {
+        return false;
+    }
+
+    *field = slot * (disk_stats_metric_count + 1) + (metric >= 0 ? metric : disk_symbol_present);
+
+    return true;
+}
+
+bool pi_chart_symbols_disk_string(const pi_template_symbol_t *symbol, void *snapshot, pi_string_ptr value) {
+    pi_disk_stats_ptr disk_stats = snapshot;
+
+    if (NULL == disk_stats) {
+        return false;
+    }
+
+    const pi_disk_device_t *device = &disk_stats->devices[symbol->field / (disk_stats_metric_count + 1)];
+    int metric = symbol->field % (disk_stats_metric_count + 1);
+
+    if (metric == disk_symbol_present) {
+        pi_string_append_str(value, device->present ? "true" : "false");
+    }
+    else if (metric == disk_stats_read_latency || metric == disk_stats_write_latency
+             || metric == disk_stats_utilization) {
+        pi_string_sprintf(value, "%.1f", device->values[metric]);
+    }
+    else {
+        pi_string_sprintf(value, "%.0f", device->values[metric]);
+    }
+
+    return true;
+}
+
+bool pi_chart_symbols_disk_boolean(const pi_template_symbol_t *symbol, void *snapshot, bool *value) {
+    pi_disk_stats_ptr disk_stats = snapshot;
+
+    if (NULL == disk_stats) {
+        return false;
+    }
+
+    const pi_disk_device_t *device = &disk_stats->devices[symbol->field / (disk_stats_metric_count + 1)];
+    int metric = symbol->field % (disk_stats_metric_count + 1);
+
+    *value = metric == disk_symbol_present ? device->present : device->values[metric] != 0;
+    return true;
+}
+
+// "name" or "name.metric", field is the watch list index times process_metric_count plus the
+// metric.  A plain name still works when the watch list is full.
+//
+bool pi_chart_symbols_bind_process(const char *name, int *field) {
+    if (*name == '\0') {
+        return false;
+    }
+
+    const char *dot = strrchr(name, '.');
+    int metric = dot ? pi_process_metric(dot + 1) : -1;
+    size_t length = strlen(name);
+
+    if (metric > process_metric_running) {
+        length = (size_t) (dot - name);
+    }
+    else {
+        metric = process_metric_running;
+    }
+
+    char process_name[process_name_length];
+    memory_clear(process_name, sizeof(process_name));
+    strncpy(process_name, name, min(length, sizeof(process_name) - 1));
+
+    int index = pi_process_watch(process_name);
+
+    if (index < 0 && metric != process_metric_running) {
+        return false;
+    }
+
+    *field = max(index, 0) * process_metric_count + metric;
+
+    return true;
+}
+
+bool pi_chart_symbols_process_string(const pi_template_symbol_t *symbol, void *snapshot, pi_string_ptr value) {
+    pi_process_watch_ptr watch = snapshot;
+    int metric = symbol->field % process_metric_count;
+    bool running = false;
+
+    if (metric == process_metric_running) {
+        pi_process_exist(&running, symbol->name);
+        pi_string_append_str(value, running ? "true" : "false");
+        return true;
+    }
+
+    if (NULL == watch) {
+        return false;
+    }
+
+    double metric_value = watch->processes[symbol->field / process_metric_count].values[metric];
+
+    pi_string_sprintf(value, metric == process_metric_cpu ? "%.1f" : "%.0f", metric_value);
+    return true;
+}
+
+bool pi_chart_symbols_process_boolean(const pi_template_symbol_t *symbol, void *snapshot, bool *value) {
+    pi_process_watch_ptr watch = snapshot;
+    int metric = symbol->field % process_metric_count;
+
+    if (metric == process_metric_running) {
+        return pi_process_exist(value, symbol->name);
+    }
+
+    if (NULL == watch) {
+        return false;
+    }
+
+    *value = watch->processes[symbol->field / process_metric_count].values[metric] != 0;
+    return true;
+}
+
+typedef enum {
+    top_column_present,
+    top_column_name,
+    top_column_pid,
+    top_column_cpu,
+    top_column_rss,
+    top_column_count
+} top_column_t;
+
+static const char *top_column_names[top_column_count] = {
+        "",
+        "name",
+        "pid",
+        "cpu",
+        "rss",
+};
+
+// Copies the latest lists for every key.
+//
+void *pi_chart_symbols_top_snapshot() {
+    pi_process_top_ptr snapshot = memory_alloc(process_top_key_count * sizeof(pi_process_top_t));
+
+    for (int key = 0; key < process_top_key_count; key++) {
+        pi_process_top_get((process_top_key_t) key, &snapshot[key]);
+    }
+
+    return snapshot;
+}
+
+// "cpu.3.name", field is (key * process_top_max + rank) * top_column_count + column.
+//
+bool pi_chart_symbols_bind_top(const char *name, int *field) {
+    const char *dot = strchr(name, '.');
+
+    if (NULL == dot || (size_t) (dot - name) >= 8) {
+        return false;
+    }
+
+    char key_name[8];
+    memory_clear(key_name, sizeof(key_name));
+    memcpy(key_name, name, (size_t) (dot - name));
+
+    int key = pi_process_top_key(key_name);
+
+    char *end = NULL;
+    long rank = strtol(dot + 1, &end, 10);
+
+    if (key < 0 || end == dot + 1 || rank < 1 || rank > process_top_max) {
+        return false;
+    }
+
+    int column = top_column_present;
+
+    if (*end == '.') {
+        column = -1;
+        for (int i = top_column_name; i < top_column_count; i++) {
+            if (0 == strcmp(end + 1, top_column_names[i])) {
+                column = i;
+            }
+        }
+    }
+    else if (*end != '\0') {
+        column = -1;
+    }
+
+    if (column < 0) {
+        return false;
+    }
+
+    *field = (key * process_top_max + (int) (rank - 1)) * top_column_count + column;
+
+    return true;
+}
+
+bool pi_chart_symbols_top_string(const pi_template_symbol_t *symbol, void *snapshot, pi_string_ptr value) {
+    pi_process_top_ptr top = snapshot;
+
+    if (NULL == top) {
+        return false;
+    }
+
+    int column = symbol->field % top_column_count;
+    int rank = (symbol->field / top_column_count) % process_top_max;
+    pi_process_top_ptr list = &top[symbol->field / top_column_count / process_top_max];
+
+    if (rank >= (int) list->count) {
+        return true;
+    }
+
+    const pi_process_top_entry_t *entry = &list->entries[rank];
+
+    switch (column) {
+        case top_column_name:
+            // Process names are chosen by whoever starts the process, keep them from adding markup.
+            //
+            for (const char *ptr = entry->name; *ptr; ptr++) {
+                if (*ptr == '<') {
+                    pi_string_append_str(value, "&lt;");
+                }
+                else if (*ptr == '>') {
+                    pi_string_append_str(value, "&gt;");
+                }
+                else if (*ptr == '&') {
+                    pi_string_append_str(value, "&amp;");
+                }
+                else {
+                    pi_string_append_char(value, *ptr);
+                }
+            }
+            break;
+
+        case top_column_pid:
+            pi_string_sprintf(value, "%d", (int) entry->pid);
+            break;
+
+        case top_column_cpu:
+            pi_string_sprintf(value, "%.1f", entry->cpu);
+            break;
+
+        case top_column_rss:
+            pi_string_sprintf(value, "%.0f", entry->rss);
+            break;
+
+        default:
+            pi_string_append_str(value, "true");
+            break;
+    }
+
+    return true;
+}
+
+bool pi_chart_symbols_top_boolean(const pi_template_symbol_t *symbol, void *snapshot, bool *value) {
+    pi_process_top_ptr top = snapshot;
+
+    if (NULL == top) {
+        return false;
+    }
+
+    int rank = (symbol->field / top_column_count) % process_top_max;
+
+    *value = rank < (int) top[symbol->field / top_column_count / process_top_max].count;
+    return true;
+}
+
+static const pi_template_source_t gpio_levels_source = {
+        pi_chart_symbols_levels_snapshot,
+        memory_free
+};
+
+static const pi_template_source_t gpio_modes_source = {
+        pi_chart_symbols_modes_snapshot,
+        memory_free
+};
+
+static const pi_template_source_t edges_source = {
+        pi_chart_symbols_edges_snapshot,
+        memory_free
+};
+
+static const pi_template_source_t mem_info_source = {
+        pi_chart_symbols_mem_info_snapshot,
+        memory_free
+};
+
+static const pi_template_source_t thermal_source = {
+        pi_chart_symbols_thermal_snapshot,
+        memory_free
+};
+
+static const pi_template_source_t am2315_source = {
+        pi_chart_symbols_am2315_snapshot,
+        memory_free
+};
+
+static const pi_template_source_t cpu_source = {
+        pi_chart_symbols_cpu_snapshot,
+        memory_free
+};
+
+static const pi_template_source_t net_source = {
+        pi_chart_symbols_net_snapshot,
+        memory_free
+};
+
+static const pi_template_source_t disk_source = {
+        pi_chart_symbols_disk_snapshot,
+        memory_free
+};
+
+static const pi_template_source_t process_watch_source = {
+        pi_chart_symbols_process_watch_snapshot,
+        memory_free
+};
+
+static const pi_template_source_t top_source = {
+        pi_chart_symbols_top_snapshot,
+        memory_free
+};
+
+static const pi_template_provider_t gpio_digital_provider = {
+        "gpio.digital.",
+        &gpio_levels_source,
+        pi_chart_symbols_bind_pin,
+        pi_chart_symbols_digital_string,
+        pi_chart_symbols_digital_boolean
+};
+
+static const pi_template_provider_t gpio_mode_provider = {
+        "gpio.mode.",
+        &gpio_modes_source,
+        pi_chart_symbols_bind_pin,
+        pi_chart_symbols_mode_string,
+        NULL
+};
+
+static const pi_template_provider_t gpio_provider = {
+        "gpio.",
+        &gpio_levels_source,
+        pi_chart_symbols_bind_pin,
+        NULL,
+        pi_chart_symbols_digital_boolean
+};
+
+static const pi_template_provider_t gpio_count_provider = {
+        "gpio.count.",
+        &edges_source,
+        pi_chart_symbols_bind_edge_pin,
+        pi_chart_symbols_edge_count_string,
+        pi_chart_symbols_edge_count_boolean
+};
+
+static const pi_template_provider_t gpio_hz_provider = {
+        "gpio.hz.",
+        &edges_source,
+        pi_chart_symbols_bind_edge_pin,
+        pi_chart_symbols_edge_hz_string,
+        NULL
+};
+
+static const pi_template_provider_t mem_info_provider = {
+        "meminfo.",
+        &mem_info_source,
+        pi_chart_symbols_bind_mem_info,
+        pi_chart_symbols_mem_info_string,
+        NULL
+};
+
+static const pi_template_provider_t thermal_provider = {
+        "thermal.",
+        &thermal_source,
+        pi_chart_symbols_bind_thermal,
+        pi_chart_symbols_thermal_string,
+        pi_chart_symbols_thermal_boolean
+};
+
+static const pi_template_provider_t cpu_freq_provider = {
+        "cpufreq.",
+        &thermal_source,
+        pi_chart_symbols_bind_cpu_freq,
+        pi_chart_symbols_cpu_freq_string,
+        pi_chart_symbols_cpu_freq_boolean
+};
+
+static const pi_template_provider_t am2315_provider = {
+        "am2315.",
+        &am2315_source,
+        pi_chart_symbols_bind_am2315,
+        pi_chart_symbols_am2315_string,
+        pi_chart_symbols_am2315_boolean
+};
+
+static const pi_template_provider_t cpu_provider = {
+        "cpu.",
+        &cpu_source,
+        pi_chart_symbols_bind_cpu,
+        pi_chart_symbols_cpu_string,
+        NULL
+};
+
+static const pi_template_provider_t net_provider = {
+        "net.",
+        &net_source,
+        pi_chart_symbols_bind_net,
+        pi_chart_symbols_net_string,
+        pi_chart_symbols_net_boolean
+};
+
+static const pi_template_provider_t disk_provider = {
+        "disk.",
+        &disk_source,
+        pi_chart_symbols_bind_disk,
+        pi_chart_symbols_disk_string,
+        pi_chart_symbols_disk_boolean
+};
+
+static const pi_template_provider_t process_provider = {
+        "process.",
+        &process_watch_source,
+        pi_chart_symbols_bind_process,
+        pi_chart_symbols_process_string,
+        pi_chart_symbols_process_boolean
+};
+
+static const pi_template_provider_t top_provider = {
+        "top.",
+        &top_source,
+        pi_chart_symbols_bind_top,
+        pi_chart_symbols_top_string,
+        pi_chart_symbols_top_boolean
+};
+
+static const pi_template_provider_t *const providers[] = {
+        &gpio_digital_provider,
+        &gpio_mode_provider,
+        &gpio_provider,
+        &gpio_count_provider,
+        &gpio_hz_provider,
+        &mem_info_provider,
+        &thermal_provider,
+        &cpu_freq_provider,
+        &am2315_provider,
+        &cpu_provider,
+        &net_provider,
+        &disk_provider,
+        &process_provider,
+        &top_provider,
+        NULL
+};
+
+const pi_template_provider_t *const *pi_chart_symbol_providers() {
+    return providers;
+}
@@ -0,0 +1,258 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#include <string.h>
+#include "pi_cpu_stat.h"
+#include "pi_proc_file.h"
+#include "pi_sampler.h"
+#include "pi_seqlock.h"
+#include "pi_utils.h"
+
+#ifndef __unused
+#define __unused
+#endif
+
+// The jiffy counters of a "cpu" line that the percentages are built from, guest time is
+// already part of user and nice.
+//
+#define cpu_stat_counter_count 8
+
+static const char *cpu_stat_names[cpu_stat_field_count] = {
+        "user",
+        "nice",
+        "system",
+        "idle",
+        "iowait",
+        "irq",
+        "softirq",
+        "steal",
+        "usage",
+};
+
+typedef struct pi_cpu_counters_struct {
+    unsigned long long values[cpu_stat_counter_count];
+
+    // False while the core is offline and has no line to read.
+    //
+    bool present;
+} pi_cpu_counters_t;
+
+// The arrays hold core_count + 1 entries, all cores first, and are allocated once at start up.
+//
+typedef struct pi_cpu_stat_sampler_struct {
+    pi_proc_file_ptr file;
+    pi_sampler_ptr sampler;
+    unsigned int core_count;
+
+    pi_cpu_counters_t *previous;
+    pi_cpu_counters_t *current;
+    pi_cpu_usage_t *sample;
+
+    pi_seqlock_t lock;
+    pi_cpu_usage_t *published;
+} pi_cpu_stat_sampler_t;
+
+pi_cpu_stat_sampler_t g_cpu_stat;
+
+const char *pi_cpu_stat_get_file_name() {
+#ifdef __MACH__
+    // Mac OS Emulator code
+    //
+    return "./proc/stat";
+#else
+    return "/proc/stat";
+#endif
+}
+
+int pi_cpu_stat_field(const char *name) {
+    for (int i = 0; i < cpu_stat_field_count; i++) {
+        if (0 == strcmp(name, cpu_stat_names[i])) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+const char *pi_cpu_stat_field_name(cpu_stat_field_t field) {
+    return field < cpu_stat_field_count ? cpu_stat_names[field] : "";
+}
+
+// Returns the entry a line belongs to: 0 for "cpu", N + 1 for "cpuN", -1 once the cpu lines
+// are over.  They come first in /proc/stat, so nothing after them is looked at.
+//
+int pi_cpu_stat_line_index(const pi_proc_line_t *line, const char **values) {
+    const char *ptr = line->begin;
+
+    if (line->end - ptr < 3 || 0 != strncmp(ptr, "cpu", 3)) {
+        return -1;
+    }
+
+    ptr += 3;
+
+    if (*ptr == ' ') {
+        *values = ptr;
+        return 0;
+    }
+
+    unsigned long long core = 0;
+    *values = pi_proc_parse_u64(ptr, line->end, &core);
+
+    return (int) core + 1;
+}
+
+void pi_cpu_stat_sample(void __unused *context) {
+    if (!pi_proc_file_read(g_cpu_stat.file)) {
+        return;
+    }
+
+    unsigned int entry_count = g_cpu_stat.core_count + 1;
+
+    // A core that went offline has no line, it reads as idle zeros until it comes back.  Its
+    // first sample back only sets the baseline, measured against the zeros it would show the
+    // average since boot.
+    //
+    memory_clear(g_cpu_stat.current, entry_count * sizeof(pi_cpu_counters_t));
+    memory_clear(g_cpu_stat.sample, entry_count * sizeof(pi_cpu_usage_t));
+
+    pi_proc_line_t line;
+    const char *values = NULL;
+    int index = 0;
+
+    while (pi_proc_file_next_line(g_cpu_stat.file, &line)
+           && (index = pi_cpu_stat_line_index(&line, &values)) >= 0) {
+        if ((unsigned int) index >= entry_count) {
+            continue;
+        }
+
+        pi_cpu_counters_t *current = &g_cpu_stat.current[index];
+        for (int i = 0; i < cpu_stat_counter_count; i++) {
+            values = pi_proc_parse_u64(values, line.end, &current->values[i]);
+        }
+        current->present = true;
+
+        pi_cpu_counters_t *previous = &g_cpu_stat.previous[index];
+        if (!previous->present) {
+            continue;
+        }
+
+        unsigned long long deltas[cpu_stat_counter_count];
+        unsigned long long total = 0;
+
+        for (int i = 0; i < cpu_stat_counter_count; i++) {
+            deltas[i] = current->values[i] >= previous->values[i] ? current->values[i] - previous->values[i] : 0;
+            total += deltas[i];
+        }
+
+        if (0 == total) {
+            continue;
+        }
+
+        pi_cpu_usage_t *usage = &g_cpu_stat.sample[index];
+        for (int i = 0; i < cpu_stat_counter_count; i++) {
+            usage->values[i] = (double) deltas[i] * 100.0 / (double) total;
+        }
+
+        usage->values[cpu_stat_usage] = 100.0 - usage->values[cpu_stat_idle] - usage->values[cpu_stat_iowait];
+    }
+
+    pi_cpu_counters_t *swap = g_cpu_stat.previous;
+    g_cpu_stat.previous = g_cpu_stat.current;
+    g_cpu_stat.current = swap;
+
+    pi_seqlock_write(&g_cpu_stat.lock, g_cpu_stat.published, g_cpu_stat.sample, entry_count * sizeof(pi_cpu_usage_t));
+}
+
+bool pi_cpu_stat_start() {
+    g_cpu_stat.file = pi_proc_file_new(pi_cpu_stat_get_file_name());
+
+    if (NULL == g_cpu_stat.file || !pi_proc_file_read(g_cpu_stat.file)) {
+        pi_proc_file_delete(g_cpu_stat.file);
+        g_cpu_stat.file = NULL;
+        return false;
+    }
+
+    pi_proc_line_t line;
+    const char *values = NULL;
+    int index = 0;
+
+    while (pi_proc_file_next_line(g_cpu_stat.file, &line)
+           && (index = pi_cpu_stat_line_index(&line, &values)) >= 0) {
+        g_cpu_stat.core_count = max(g_cpu_stat.core_count, (unsigned int) index);
+    }
+
+    unsigned int entry_count = g_cpu_stat.core_count + 1;
+    g_cpu_stat.previous = memory_alloc(entry_count * sizeof(pi_cpu_counters_t));
+    g_cpu_stat.current = memory_alloc(entry_count * sizeof(pi_cpu_counters_t));
+    g_cpu_stat.sample = memory_alloc(entry_count * sizeof(pi_cpu_usage_t));
+    g_cpu_stat.published = memory_alloc(entry_count * sizeof(pi_cpu_usage_t));
+
+    memory_clear(g_cpu_stat.previous, entry_count * sizeof(pi_cpu_counters_t));
+    memory_clear(g_cpu_stat.published, entry_count * sizeof(pi_cpu_usage_t));
+
+    // Cores online now are measured against zeros, cores that are not wait for a baseline.
+    //
+    if (pi_proc_file_read(g_cpu_stat.file)) {
+        while (pi_proc_file_next_line(g_cpu_stat.file, &line)
+               && (index = pi_cpu_stat_line_index(&line, &values)) >= 0) {
+            if ((unsigned int) index < entry_count) {
+                g_cpu_stat.previous[index].present = true;
+            }
+        }
+    }
+
+    INFO_LOG("Sampling %u cores from %s", g_cpu_stat.core_count, pi_cpu_stat_get_file_name());
+
+    // The first sample is measured against zeros, so it shows the averages since boot.
+    //
+    g_cpu_stat.sampler = pi_sampler_start("cpu", pi_cpu_stat_sample, NULL);
+
+    return NULL != g_cpu_stat.sampler;
+}
+
+void pi_cpu_stat_stop() {
+    pi_sampler_stop(g_cpu_stat.sampler);
+    g_cpu_stat.sampler = NULL;
+
+    pi_proc_file_delete(g_cpu_stat.file);
+    g_cpu_stat.file = NULL;
+}
+
+unsigned int pi_cpu_stat_core_count() {
+    return g_cpu_stat.core_count;
+}
+
+void pi_cpu_stat_get(pi_cpu_usage_ptr usage) {
+    if (NULL == g_cpu_stat.published) {
+        memory_clear(usage, sizeof(pi_cpu_usage_t));
+        return;
+    }
+
+    pi_seqlock_read(&g_cpu_stat.lock,
+                    usage,
+                    g_cpu_stat.published,
+                    (g_cpu_stat.core_count + 1) * sizeof(pi_cpu_usage_t));
+}
@@ -0,0 +1,76 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#ifndef PI_CPU_STAT_H
+#define PI_CPU_STAT_H
+
+#include <stdbool.h>
+
+// Share of time spent in each state since the previous sample, in percent.  usage is everything
+// but idle and iowait.
+//
+typedef enum {
+    cpu_stat_user,
+    cpu_stat_nice,
+    cpu_stat_system,
+    cpu_stat_idle,
+    cpu_stat_iowait,
+    cpu_stat_irq,
+    cpu_stat_softirq,
+    cpu_stat_steal,
+    cpu_stat_usage,
+    cpu_stat_field_count
+} cpu_stat_field_t;
+
+typedef struct pi_cpu_usage_struct {
+    double values[cpu_stat_field_count];
+} pi_cpu_usage_t;
+
+typedef pi_cpu_usage_t *pi_cpu_usage_ptr;
+
+// Counts the cores in /proc/stat, sizes the sample arrays for them and starts sampling every
+// get_sample_interval() milliseconds.
+//
+bool pi_cpu_stat_start();
+
+void pi_cpu_stat_stop();
+
+// Cores found at start up, 0 before pi_cpu_stat_start().
+//
+unsigned int pi_cpu_stat_core_count();
+
+// Copies the latest sample into pi_cpu_stat_core_count() + 1 entries: all cores together first,
+// then core N at N + 1.  Never touches the file system and never waits for the sampler.
+//
+void pi_cpu_stat_get(pi_cpu_usage_ptr usage);
+
+// Returns the field called name ("user") or -1.
+//
+int pi_cpu_stat_field(const char *name);
+
+const char *pi_cpu_stat_field_name(cpu_stat_field_t field);
+
+#endif //PI_CPU_STAT_H
@@ -0,0 +1,431 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "pi_disk_stats.h"
+#include "pi_chart_settings.h"
+#include "pi_proc_file.h"
+#include "pi_sampler.h"
+#include "pi_seqlock.h"
+#include "pi_utils.h"
+
+#ifndef __unused
+#define __unused
+#endif
+
+static const char *disk_stats_metric_names[disk_stats_metric_count] = {
+        "reads_per_sec",
+        "writes_per_sec",
+        "read_bytes_per_sec",
+        "write_bytes_per_sec",
+        "read_latency_ms",
+        "write_latency_ms",
+        "utilization",
+        "in_flight",
+};
+
+// Columns after the device name: reads completed, merged, sectors, ms reading, then the same
+// four for writes, I/Os in flight and ms spent doing I/O.  Newer kernels append discard and
+// flush columns which are not read.
+//
+typedef enum {
+    disk_column_reads,
+    disk_column_reads_merged,
+    disk_column_read_sectors,
+    disk_column_read_ms,
+    disk_column_writes,
+    disk_column_writes_merged,
+    disk_column_write_sectors,
+    disk_column_write_ms,
+    disk_column_in_flight,
+    disk_column_io_ms,
+    disk_column_count
+} disk_column_t;
+
+// /proc/diskstats counts 512 byte sectors whatever the device's block size.
+//
+#define disk_stats_sector_size 512
+
+// Lines past this are never tracked, the file lists every partition and loop device.
+//
+#define disk_stats_max_lines 1024
+
+typedef struct pi_disk_slot_struct {
+    char name[disk_stats_name_length];
+    bool used;
+
+    // A template named the device, the slot is not given away when the device goes.
+    //
+    bool bound;
+
+    // counters hold the previous sample of the device, rates need one.
+    //
+    bool counted;
+    unsigned long long counters[disk_column_count];
+} pi_disk_slot_t;
+
+// The sampler maps the lines of /proc/diskstats to slots once and only builds the map again
+// when a tracked line moves, the number of lines changes or a template binds a new device.
+// Lines without a slot are stepped over without parsing, so partitions and loop devices that
+// nobody asked for add a newline scan each and nothing else.  The lock guards the slots and
+// rebuild: binding takes it to claim one and the sampler holds it while it reads them.
+//
+typedef struct pi_disk_stats_sampler_struct {
+    pi_proc_file_ptr file;
+    pi_sampler_ptr sampler;
+    struct timespec sampled;
+
+    pthread_mutex_t lock;
+    pi_disk_slot_t slots[disk_stats_max_devices];
+    bool rebuild;
+
+    int line_slots[disk_stats_max_lines];
+    unsigned int line_count;
+
+    pi_seqlock_t published_lock;
+    pi_disk_stats_t published;
+} pi_disk_stats_sampler_t;
+
+pi_disk_stats_sampler_t g_disk_stats = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+const char *pi_disk_stats_get_file_name() {
+#ifdef __MACH__
+    // Mac OS Emulator code
+    //
+    return "./proc/diskstats";
+#else
+    return "/proc/diskstats";
+#endif
+}
+
+int pi_disk_stats_metric(const char *name) {
+    for (int i = 0; i < disk_stats_metric_count; i++) {
+        if (0 == strcmp(name, disk_stats_metric_names[i])) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+const char *pi_disk_stats_metric_name(disk_stats_metric_t metric) {
+    return metric < disk_stats_metric_count ? disk_stats_metric_names[metric] : "";
+}
+
+// Call with the lock held.
+//
+int pi_disk_stats_find_slot(const char *begin, const char *end, bool claim) {
+    int free_slot = -1;
+
+    for (int i = 0; i < disk_stats_max_devices; i++) {
+        if (!g_disk_stats.slots[i].used) {
+            free_slot = free_slot < 0 ? i : free_slot;
+        }
+        else if (pi_proc_token_equals(begin, end, g_disk_stats.slots[i].name)) {
+            return i;
+        }
+    }
+
+    if (!claim || free_slot < 0 || end - begin >= disk_stats_name_length) {
+        return -1;
+    }
+
+    pi_disk_slot_t *slot = &g_disk_stats.slots[free_slot];
+    memory_clear(slot, sizeof(pi_disk_slot_t));
+    memcpy(slot->name, begin, (size_t) (end - begin));
+    slot->used = true;
+
+    return free_slot;
+}
+
+int pi_disk_stats_bind(const char *name) {
+    pthread_mutex_lock(&g_disk_stats.lock);
+
+    int slot = pi_disk_stats_find_slot(name, name + strlen(name), true);
+
+    if (slot >= 0 && !g_disk_stats.slots[slot].bound) {
+        g_disk_stats.slots[slot].bound = true;
+        g_disk_stats.rebuild = true;
+    }
+
+    pthread_mutex_unlock(&g_disk_stats.lock);
+
+    return slot;
+}
+
+// Returns the device name of a line and where it ends, past the major and minor numbers.
+//
+static const char *pi_disk_stats_line_name(const pi_proc_line_t *line, const char **name_end) {
+    unsigned long long number;
+    const char *begin = pi_proc_parse_u64(line->begin, line->end, &number);
+    begin = pi_proc_parse_u64(begin, line->end, &number);
+
+    while (begin < line->end && *begin == ' ') {
+        begin++;
+    }
+
+    *name_end = pi_proc_scan(begin, line->end, ' ', '\t');
+
+    return begin;
+}
+
+// Devices nobody named are tracked when they are whole disks that can wear or stall.
+//
+bool pi_disk_stats_default_device(const char *begin, const char *end) {
+    size_t length = (size_t) (end - begin);
+
+    if (0 == length || length >= disk_stats_name_length
+        || (length > 4 && 0 == strncmp(begin, "loop", 4))
+        || (length > 3 && 0 == strncmp(begin, "ram", 3))) {
+        return false;
+    }
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/class/block/%.*s/partition", get_sysfs_root(), (int) length, begin);
+
+    return 0 != access(path, F_OK);
+}
+
+// True while the file has as many lines as when the map was built and every tracked line still
+// names its device.  Untracked lines are only counted.  Call with the lock held.
+//
+bool pi_disk_stats_map_current(pi_proc_file_ptr file) {
+    pi_proc_line_t line;
+    unsigned int index = 0;
+
+    while (pi_proc_file_next_line(file, &line)) {
+        if (line.begin == line.end) {
+            continue;
+        }
+
+        int slot = index < disk_stats_max_lines ? g_disk_stats.line_slots[index] : -1;
+        index++;
+
+        if (slot >= 0) {
+            const char *name_end;
+            const char *name = pi_disk_stats_line_name(&line, &name_end);
+
+            if (!pi_proc_token_equals(name, name_end, g_disk_stats.slots[slot].name)) {
+                return false;
+            }
+        }
+    }
+
+    return index == g_disk_stats.line_count;
+}
+
+// Gives tracked lines their slot, frees the slots of devices that went away unless a template
+// named them, and starts those over from zero.  Call with the lock held.
+//
+void pi_disk_stats_build_map(pi_proc_file_ptr file) {
+    bool seen[disk_stats_max_devices];
+    memory_clear(seen, sizeof(seen));
+
+    g_disk_stats.rebuild = false;
+
+    pi_proc_line_t line;
+    unsigned int tracked = 0;
+    g_disk_stats.line_count = 0;
+
+    while (pi_proc_file_next_line(file, &line)) {
+        if (line.begin == line.end) {
+            continue;
+        }
+
+        int slot = -1;
+
+        if (g_disk_stats.line_count < disk_stats_max_lines) {
+            const char *name_end;
+            const char *name = pi_disk_stats_line_name(&line, &name_end);
+
+            slot = pi_disk_stats_find_slot(name, name_end, false);
+
+            if (slot < 0 && pi_disk_stats_default_device(name, name_end)) {
+                slot = pi_disk_stats_find_slot(name, name_end, true);
+            }
+
+            g_disk_stats.line_slots[g_disk_stats.line_count] = slot;
+        }
+
+        if (slot >= 0) {
+            seen[slot] = true;
+            tracked++;
+        }
+
+        g_disk_stats.line_count++;
+    }
+
+    for (int i = 0; i < disk_stats_max_devices; i++) {
+        if (!seen[i]) {
+            g_disk_stats.slots[i].counted = false;
+            g_disk_stats.slots[i].used = g_disk_stats.slots[i].used && g_disk_stats.slots[i].bound;
+        }
+    }
+
+    DEBUG_LOG("Tracking %u of %u block devices", tracked, g_disk_stats.line_count);
+}
+
+// Change of a counter since the last sample, 0 when the counter went backwards.
+//
+static inline double pi_disk_stats_delta(const pi_disk_slot_t *slot, const unsigned long long *counters,
+                                         disk_column_t column) {
+    return counters[column] >= slot->counters[column] ? (double) (counters[column] - slot->counters[column]) : 0;
+}
+
+void pi_disk_stats_sample(void __unused *context) {
+    if (!pi_proc_file_read(g_disk_stats.file)) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_disk_stats.lock);
+
+    if (g_disk_stats.rebuild || !pi_disk_stats_map_current(g_disk_stats.file)) {
+        g_disk_stats.file->cursor = g_disk_stats.file->buffer;
+        pi_disk_stats_build_map(g_disk_stats.file);
+    }
+
+    g_disk_stats.file->cursor = g_disk_stats.file->buffer;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    double seconds = 0;
+    if (g_disk_stats.sampled.tv_sec || g_disk_stats.sampled.tv_nsec) {
+        seconds = (double) (now.tv_sec - g_disk_stats.sampled.tv_sec)
+                  + (double) (now.tv_nsec - g_disk_stats.sampled.tv_nsec) / 1000000000.0;
+    }
+    g_disk_stats.sampled = now;
+
+    pi_disk_stats_t sample;
+    memory_clear(&sample, sizeof(sample));
+
+    pi_proc_line_t line;
+    unsigned int index = 0;
+    unsigned int mapped = min(g_disk_stats.line_count, (unsigned int) disk_stats_max_lines);
+
+    while (index < mapped && pi_proc_file_next_line(g_disk_stats.file, &line)) {
+        if (line.begin == line.end) {
+            continue;
+        }
+
+        int slot_index = g_disk_stats.line_slots[index++];
+
+        if (slot_index < 0) {
+            continue;
+        }
+
+        unsigned long long counters[disk_column_count];
+        const char *name_end;
+        pi_disk_stats_line_name(&line, &name_end);
+
+        const char *ptr = name_end;
+        for (int i = 0; i < disk_column_count; i++) {
+            ptr = pi_proc_parse_u64(ptr, line.end, &counters[i]);
+        }
+
+        pi_disk_slot_t *slot = &g_disk_stats.slots[slot_index];
+        pi_disk_device_t *device = &sample.devices[slot_index];
+
+        memcpy(device->name, slot->name, sizeof(device->name));
+        device->present = true;
+        device->values[disk_stats_in_flight] = (double) counters[disk_column_in_flight];
+
+        if (slot->counted && seconds > 0) {
+            double reads = pi_disk_stats_delta(slot, counters, disk_column_reads);
+            double writes = pi_disk_stats_delta(slot, counters, disk_column_writes);
+
+            device->values[disk_stats_reads] = reads / seconds;
+            device->values[disk_stats_writes] = writes / seconds;
+            device->values[disk_stats_read_bytes] =
+                    pi_disk_stats_delta(slot, counters, disk_column_read_sectors) * disk_stats_sector_size / seconds;
+            device->values[disk_stats_write_bytes] =
+                    pi_disk_stats_delta(slot, counters, disk_column_write_sectors) * disk_stats_sector_size / seconds;
+
+            // Average time an I/O that completed in the interval took, queueing included.
+            //
+            if (reads > 0) {
+                device->values[disk_stats_read_latency] =
+                        pi_disk_stats_delta(slot, counters, disk_column_read_ms) / reads;
+            }
+
+            if (writes > 0) {
+                device->values[disk_stats_write_latency] =
+                        pi_disk_stats_delta(slot, counters, disk_column_write_ms) / writes;
+            }
+
+            // Percent of the interval the device had at least one I/O in flight.
+            //
+            device->values[disk_stats_utilization] =
+                    min(100.0, pi_disk_stats_delta(slot, counters, disk_column_io_ms) / (seconds * 10.0));
+        }
+
+        memcpy(slot->counters, counters, sizeof(slot->counters));
+        slot->counted = true;
+    }
+
+    // Named devices that are gone still report their name.
+    //
+    for (int i = 0; i < disk_stats_max_devices; i++) {
+        if (!sample.devices[i].present && g_disk_stats.slots[i].used) {
+            memcpy(sample.devices[i].name, g_disk_stats.slots[i].name, sizeof(sample.devices[i].name));
+        }
+    }
+
+    pthread_mutex_unlock(&g_disk_stats.lock);
+
+    pi_seqlock_write(&g_disk_stats.published_lock, &g_disk_stats.published, &sample, sizeof(sample));
+}
+
+bool pi_disk_stats_start() {
+    g_disk_stats.file = pi_proc_file_new(pi_disk_stats_get_file_name());
+
+    if (NULL == g_disk_stats.file) {
+        return false;
+    }
+
+    g_disk_stats.sampler = pi_sampler_start("disk", pi_disk_stats_sample, NULL);
+
+    return NULL != g_disk_stats.sampler;
+}
+
+void pi_disk_stats_stop() {
+    pi_sampler_stop(g_disk_stats.sampler);
+    g_disk_stats.sampler = NULL;
+
+    pi_proc_file_delete(g_disk_stats.file);
+    g_disk_stats.file = NULL;
+}
+
+void pi_disk_stats_get(pi_disk_stats_ptr disk_stats) {
+    pi_seqlock_read(&g_disk_stats.published_lock, disk_stats, &g_disk_stats.published, sizeof(pi_disk_stats_t));
+}
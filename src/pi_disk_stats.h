@@ -0,0 +1,91 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#ifndef PI_DISK_STATS_H
+#define PI_DISK_STATS_H
+
+#include <stdbool.h>
+
+// Most block devices that are tracked at once.
+//
+#define disk_stats_max_devices 32
+
+#define disk_stats_name_length 32
+
+// Rates per second, latency and utilization between the last two samples.
+//
+typedef enum {
+    disk_stats_reads,
+    disk_stats_writes,
+    disk_stats_read_bytes,
+    disk_stats_write_bytes,
+    disk_stats_read_latency,
+    disk_stats_write_latency,
+    disk_stats_utilization,
+    disk_stats_in_flight,
+    disk_stats_metric_count
+} disk_stats_metric_t;
+
+typedef struct pi_disk_device_struct {
+    char name[disk_stats_name_length];
+
+    // False for a slot that is free or whose device went away.
+    //
+    bool present;
+    double values[disk_stats_metric_count];
+} pi_disk_device_t;
+
+// Whole disks other than loop and ram devices are tracked on their own, partitions only once a
+// template names them.
+//
+typedef struct pi_disk_stats_struct {
+    pi_disk_device_t devices[disk_stats_max_devices];
+} pi_disk_stats_t;
+
+typedef pi_disk_stats_t *pi_disk_stats_ptr;
+
+// Starts sampling /proc/diskstats every get_sample_interval() milliseconds.
+//
+bool pi_disk_stats_start();
+
+void pi_disk_stats_stop();
+
+// Copies the latest sample, never touches the file system and never waits for the sampler.
+//
+void pi_disk_stats_get(pi_disk_stats_ptr disk_stats);
+
+// Returns the slot of device name, taking a free one if the device is not tracked yet, or -1
+// when all slots are taken.  The slot is kept even while the device is gone.
+//
+int pi_disk_stats_bind(const char *name);
+
+// Returns the metric called name ("read_bytes_per_sec") or -1.
+//
+int pi_disk_stats_metric(const char *name);
+
+const char *pi_disk_stats_metric_name(disk_stats_metric_t metric);
+
+#endif //PI_DISK_STATS_H
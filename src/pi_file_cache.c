@@ -0,0 +1,595 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#define _GNU_SOURCE
+
+#ifndef __unused
+#define __unused
+#endif
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <poll.h>
+#include <strings.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "pi_file_cache.h"
+#include "pi_chart_settings.h"
+#include "pi_chart_symbols.h"
+#include "pi_string.h"
+#include "pi_utils.h"
+
+#define file_cache_bucket_count 256
+
+// Keep a misconfigured --directory (say "/") from pulling the whole disk into memory.
+//
+#define file_cache_max_files 1024
+#define file_cache_max_bytes (32 * 1024 * 1024)
+
+// Files bigger than this are not held in memory, they keep an open descriptor for sendfile.
+//
+#define file_cache_max_file_size (1024 * 1024)
+
+// Without inotify we fall back to re-checking mtimes this often.
+//
+#define file_cache_poll_seconds 2
+
+#define file_cache_inotify_mask (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_DELETE_SELF)
+
+typedef struct pi_file_watch_struct {
+    int wd;
+    char *directory;
+} pi_file_watch_t;
+
+typedef struct pi_file_cache_struct {
+    pthread_rwlock_t lock;
+    pi_file_entry_ptr buckets[file_cache_bucket_count];
+
+    unsigned int file_count;
+    size_t memory_size;
+    unsigned int generation;
+
+    int inotify_fd;
+    pi_file_watch_t *watches;
+    unsigned int watch_count;
+
+    pthread_t watcher_thread_id;
+    bool watcher_running;
+} pi_file_cache_t;
+
+pi_file_cache_t g_file_cache = {
+        .lock = PTHREAD_RWLOCK_INITIALIZER,
+        .inotify_fd = -1,
+};
+
+static unsigned long pi_file_cache_hash(const char *str) {
+    unsigned long hash = 5381;
+    int c = 0;
+    while ((c = *str++)) {
+        hash = ((hash << 5) + hash) + c;
+    }
+
+    return hash;
+}
+
+// Builds the cache key: a single leading '/', no empty or "." components.
+//
+void pi_file_cache_normalize(const char *path, pi_string_ptr normalized) {
+    pi_string_reset(normalized);
+
+    while (*path) {
+        while (*path == '/') {
+            path++;
+        }
+
+        const char *component = path;
+        while (*path && *path != '/') {
+            path++;
+        }
+
+        size_t length = (size_t) (path - component);
+        if (length == 0 || (length == 1 && *component == '.')) {
+            continue;
+        }
+
+        pi_string_append_char(normalized, '/');
+        pi_string_append_str_length(normalized, component, length);
+    }
+
+    if (0 == pi_string_c_string_length(normalized)) {
+        pi_string_append_char(normalized, '/');
+    }
+}
+
+typedef struct pi_file_content_type_struct {
+    const char *extension;
+    const char *content_type;
+} pi_file_content_type_t;
+
+static const pi_file_content_type_t g_content_types[] = {
+        {".html", "text/html"},
+        {".htm",  "text/html"},
+        {".css",  "text/css"},
+        {".js",   "application/javascript"},
+        {".json", "application/json;charset=UTF-8"},
+        {".txt",  "text/plain"},
+        {".svg",  "image/svg+xml"},
+        {".png",  "image/png"},
+        {".jpg",  "image/jpeg"},
+        {".jpeg", "image/jpeg"},
+        {".gif",  "image/gif"},
+        {".ico",  "image/x-icon"},
+        {NULL, NULL}
+};
+
+const char *pi_file_cache_content_type(const char *path) {
+    const char *extension = strrchr(path, '.');
+
+    if (extension && NULL == strchr(extension, '/')) {
+        for (const pi_file_content_type_t *type = g_content_types; type->extension; type++) {
+            if (0 == strcasecmp(extension, type->extension)) {
+                return type->content_type;
+            }
+        }
+    }
+
+    return "application/octet-stream";
+}
+
+void pi_file_entry_delete(pi_file_entry_ptr entry) {
+    if (entry->fd >= 0) {
+        close(entry->fd);
+    }
+
+    pi_template_program_delete(entry->program);
+    memory_free(entry->response_header);
+    memory_free(entry->contents);
+    memory_free(entry->path);
+    memory_free(entry);
+}
+
+void pi_file_cache_release(pi_file_entry_ptr entry) {
+    if (entry && 0 == __atomic_sub_fetch(&entry->references, 1, __ATOMIC_ACQ_REL)) {
+        pi_file_entry_delete(entry);
+    }
+}
+
+pi_file_entry_ptr pi_file_cache_acquire(const char *path) {
+    pi_string_ptr key = pi_string_new(strlen(path) + 2);
+    pi_file_cache_normalize(path, key);
+
+    unsigned long index = pi_file_cache_hash(pi_string_c_string(key)) % file_cache_bucket_count;
+
+    pthread_rwlock_rdlock(&g_file_cache.lock);
+
+    pi_file_entry_ptr entry = g_file_cache.buckets[index];
+    while (entry && strcmp(entry->path, pi_string_c_string(key)) != 0) {
+        entry = entry->next;
+    }
+
+    if (entry) {
+        __atomic_add_fetch(&entry->references, 1, __ATOMIC_ACQ_REL);
+    }
+
+    pthread_rwlock_unlock(&g_file_cache.lock);
+
+    pi_string_delete(key, true);
+
+    return entry;
+}
+
+size_t pi_file_entry_memory_size(pi_file_entry_ptr entry) {
+    return sizeof(pi_file_entry_t)
+           + strlen(entry->path) + 1
+           + strlen(entry->response_header) + 1
+           + (entry->contents ? entry->size + 1 : 0);
+}
+
+// Swaps replacement in for whatever is cached under path, either may be NULL.  Readers still
+// holding the old entry keep it alive until they release it.
+//
+void pi_file_cache_replace(const char *path, pi_file_entry_ptr replacement) {
+    unsigned long index = pi_file_cache_hash(path) % file_cache_bucket_count;
+
+    pthread_rwlock_wrlock(&g_file_cache.lock);
+
+    pi_file_entry_ptr *link = &g_file_cache.buckets[index];
+    while (*link && strcmp((*link)->path, path) != 0) {
+        link = &(*link)->next;
+    }
+
+    pi_file_entry_ptr old_entry = *link;
+
+    if (old_entry) {
+        *link = old_entry->next;
+        g_file_cache.file_count--;
+        g_file_cache.memory_size -= pi_file_entry_memory_size(old_entry);
+    }
+
+    if (replacement) {
+        replacement->next = g_file_cache.buckets[index];
+        g_file_cache.buckets[index] = replacement;
+        g_file_cache.file_count++;
+        g_file_cache.memory_size += pi_file_entry_memory_size(replacement);
+    }
+
+    pthread_rwlock_unlock(&g_file_cache.lock);
+
+    pi_file_cache_release(old_entry);
+}
+
+void pi_file_cache_full_path(const char *path, pi_string_ptr full_path) {
+    pi_string_reset(full_path);
+    pi_string_sprintf(full_path, "%s%s", get_file_directory(), path);
+}
+
+char *pi_file_cache_read(const char *full_path, size_t size) {
+    int fd = open(full_path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        ERROR_LOG("Unable to open file %s", full_path);
+        return NULL;
+    }
+
+    char *contents = memory_alloc(size + 1);
+    size_t offset = 0;
+
+    while (offset < size) {
+        ssize_t n = read(fd, contents + offset, size - offset);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (n <= 0) {
+            break;
+        }
+
+        offset += n;
+    }
+
+    close(fd);
+
+    if (offset != size) {
+        ERROR_LOG("Unable to read file %s", full_path);
+        memory_free(contents);
+        return NULL;
+    }
+
+    return contents;
+}
+
+// Loads path into the cache unless the cached copy is still current.
+//
+void pi_file_cache_load(const char *path, const struct stat *file_stat, unsigned int generation) {
+    pi_file_entry_ptr current = pi_file_cache_acquire(path);
+
+    if (current && current->mtime == file_stat->st_mtime && current->size == (size_t) file_stat->st_size) {
+        current->generation = generation;
+        pi_file_cache_release(current);
+        return;
+    }
+
+    pi_file_cache_release(current);
+
+    if (!current && (g_file_cache.file_count >= file_cache_max_files
+                     || g_file_cache.memory_size + file_stat->st_size > file_cache_max_bytes)) {
+        ERROR_LOG("File cache is full, not caching %s", path);
+        return;
+    }
+
+    pi_file_entry_ptr entry = memory_alloc(sizeof(pi_file_entry_t));
+    entry->path = strdup(path);
+    entry->size = (size_t) file_stat->st_size;
+    entry->mtime = file_stat->st_mtime;
+    entry->generation = generation;
+    entry->references = 1;
+    entry->fd = -1;
+    entry->content_type = pi_file_cache_content_type(path);
+    entry->template = 0 == strcmp(entry->content_type, "text/html");
+
+    if (asprintf(&entry->response_header,
+                 "HTTP/1.1 200 OK\r\nServer: %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n",
+                 get_pi_chart_version(),
+                 entry->content_type,
+                 entry->size) < 0) {
+        entry->response_header = NULL;
+        pi_file_entry_delete(entry);
+        return;
+    }
+
+    pi_string_ptr full_path = pi_string_new(256);
+    pi_file_cache_full_path(path, full_path);
+
+    if (entry->size <= file_cache_max_file_size) {
+        entry->contents = pi_file_cache_read(pi_string_c_string(full_path), entry->size);
+    }
+    else {
+        entry->fd = open(pi_string_c_string(full_path), O_RDONLY | O_CLOEXEC);
+    }
+
+    pi_string_delete(full_path, true);
+
+    if (NULL == entry->contents && entry->fd < 0) {
+        ERROR_LOG("Unable to load %s", path);
+        pi_file_entry_delete(entry);
+        return;
+    }
+
+    if (entry->template && entry->contents) {
+        entry->program = pi_template_compile(entry->contents, entry->size, pi_chart_symbol_providers());
+    }
+
+    pi_file_cache_replace(entry->path, entry);
+}
+
+void pi_file_cache_unload(const char *path) {
+    pi_file_cache_replace(path, NULL);
+}
+
+void pi_file_cache_add_watch(const char *directory, const char *full_path) {
+    if (g_file_cache.inotify_fd < 0) {
+        return;
+    }
+
+    int wd = inotify_add_watch(g_file_cache.inotify_fd, full_path, file_cache_inotify_mask);
+    if (wd < 0) {
+        ERROR_LOG("Unable to watch %s, errno: %d", full_path, errno);
+        return;
+    }
+
+    for (unsigned int i = 0; i < g_file_cache.watch_count; i++) {
+        if (g_file_cache.watches[i].wd == wd) {
+            return;
+        }
+    }
+
+    g_file_cache.watches = memory_realloc(g_file_cache.watches,
+                                          (g_file_cache.watch_count + 1) * sizeof(pi_file_watch_t));
+    g_file_cache.watches[g_file_cache.watch_count].wd = wd;
+    g_file_cache.watches[g_file_cache.watch_count].directory = strdup(directory);
+    g_file_cache.watch_count++;
+}
+
+// Walks directory (relative to get_file_directory(), "" for the root) and loads what it finds.
+// Hidden files are skipped and symbolic links are not followed.
+//
+void pi_file_cache_scan(const char *directory, unsigned int generation) {
+    pi_string_ptr full_path = pi_string_new(256);
+    pi_file_cache_full_path(directory, full_path);
+
+    DIR *dir = opendir(pi_string_c_string(full_path));
+
+    if (NULL == dir) {
+        ERROR_LOG("Unable to read directory %s", pi_string_c_string(full_path));
+        pi_string_delete(full_path, true);
+        return;
+    }
+
+    pi_file_cache_add_watch(directory, pi_string_c_string(full_path));
+
+    pi_string_ptr path = pi_string_new(256);
+    struct dirent *dir_entry = NULL;
+
+    while (NULL != (dir_entry = readdir(dir))) {
+        if (dir_entry->d_name[0] == '.') {
+            continue;
+        }
+
+        pi_string_reset(path);
+        pi_string_sprintf(path, "%s/%s", directory, dir_entry->d_name);
+        pi_file_cache_full_path(pi_string_c_string(path), full_path);
+
+        struct stat file_stat;
+        if (lstat(pi_string_c_string(full_path), &file_stat) != 0) {
+            continue;
+        }
+
+        if (S_ISDIR(file_stat.st_mode)) {
+            pi_file_cache_scan(pi_string_c_string(path), generation);
+        }
+        else if (S_ISREG(file_stat.st_mode)) {
+            pi_file_cache_load(pi_string_c_string(path), &file_stat, generation);
+        }
+    }
+
+    closedir(dir);
+
+    pi_string_delete(path, true);
+    pi_string_delete(full_path, true);
+}
+
+// Drops every entry that a scan did not see again.
+//
+void pi_file_cache_remove_stale(unsigned int generation) {
+    for (int i = 0; i < file_cache_bucket_count; i++) {
+        bool removed = true;
+
+        while (removed) {
+            removed = false;
+            char *stale_path = NULL;
+
+            pthread_rwlock_rdlock(&g_file_cache.lock);
+            for (pi_file_entry_ptr entry = g_file_cache.buckets[i]; entry; entry = entry->next) {
+                if (entry->generation != generation) {
+                    stale_path = strdup(entry->path);
+                    break;
+                }
+            }
+            pthread_rwlock_unlock(&g_file_cache.lock);
+
+            if (stale_path) {
+                pi_file_cache_unload(stale_path);
+                memory_free(stale_path);
+                removed = true;
+            }
+        }
+    }
+}
+
+void pi_file_cache_rescan() {
+    unsigned int generation = ++g_file_cache.generation;
+
+    pi_file_cache_scan("", generation);
+    pi_file_cache_remove_stale(generation);
+}
+
+const char *pi_file_cache_watch_directory(int wd) {
+    for (unsigned int i = 0; i < g_file_cache.watch_count; i++) {
+        if (g_file_cache.watches[i].wd == wd) {
+            return g_file_cache.watches[i].directory;
+        }
+    }
+
+    return NULL;
+}
+
+void pi_file_cache_handle_event(const struct inotify_event *event) {
+    if (event->mask & IN_Q_OVERFLOW) {
+        pi_file_cache_rescan();
+        return;
+    }
+
+    const char *directory = pi_file_cache_watch_directory(event->wd);
+
+    if (NULL == directory || 0 == event->len || event->name[0] == '.') {
+        return;
+    }
+
+    pi_string_ptr path = pi_string_new(256);
+    pi_string_sprintf(path, "%s/%s", directory, event->name);
+
+    if (event->mask & IN_ISDIR) {
+        if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+            pi_file_cache_scan(pi_string_c_string(path), g_file_cache.generation);
+        }
+        else {
+            // A whole directory went away, let a full scan sort out what was under it.
+            //
+            pi_file_cache_rescan();
+        }
+    }
+    else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+        pi_file_cache_unload(pi_string_c_string(path));
+    }
+    else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+        pi_string_ptr full_path = pi_string_new(256);
+        pi_file_cache_full_path(pi_string_c_string(path), full_path);
+
+        struct stat file_stat;
+        if (lstat(pi_string_c_string(full_path), &file_stat) == 0 && S_ISREG(file_stat.st_mode)) {
+            pi_file_cache_load(pi_string_c_string(path), &file_stat, g_file_cache.generation);
+            DEBUG_LOG("Reloaded %s", pi_string_c_string(path));
+        }
+
+        pi_string_delete(full_path, true);
+    }
+
+    pi_string_delete(path, true);
+}
+
+void *pi_file_cache_watcher_thread(void __unused *arg) {
+    char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+    while (g_file_cache.watcher_running && get_service_running()) {
+        if (g_file_cache.inotify_fd < 0) {
+            sleep(file_cache_poll_seconds);
+            pi_file_cache_rescan();
+            continue;
+        }
+
+        struct pollfd poll_fd = {g_file_cache.inotify_fd, POLLIN, 0};
+        if (poll(&poll_fd, 1, 1000) <= 0) {
+            continue;
+        }
+
+        ssize_t length = read(g_file_cache.inotify_fd, buffer, sizeof(buffer));
+
+        for (char *ptr = buffer; length > 0 && ptr < buffer + length;) {
+            const struct inotify_event *event = (const struct inotify_event *) ptr;
+            pi_file_cache_handle_event(event);
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    return NULL;
+}
+
+bool pi_file_cache_start() {
+    struct timespec start_time = timer_start();
+
+    g_file_cache.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (g_file_cache.inotify_fd < 0) {
+        ERROR_LOG("inotify is not available (errno: %d), checking files every %d seconds",
+                  errno, file_cache_poll_seconds);
+    }
+
+    pi_file_cache_rescan();
+
+    INFO_LOG("Cached %u files from %s using %zu bytes in %lld ms",
+             g_file_cache.file_count,
+             get_file_directory(),
+             g_file_cache.memory_size,
+             timer_diff_milliseconds(start_time));
+
+    g_file_cache.watcher_running = true;
+    pthread_create(&g_file_cache.watcher_thread_id, NULL, &pi_file_cache_watcher_thread, NULL);
+
+    return true;
+}
+
+void pi_file_cache_stop() {
+    if (!g_file_cache.watcher_running) {
+        return;
+    }
+
+    g_file_cache.watcher_running = false;
+    pthread_join(g_file_cache.watcher_thread_id, NULL);
+
+    if (g_file_cache.inotify_fd >= 0) {
+        close(g_file_cache.inotify_fd);
+        g_file_cache.inotify_fd = -1;
+    }
+
+    for (unsigned int i = 0; i < g_file_cache.watch_count; i++) {
+        memory_free(g_file_cache.watches[i].directory);
+    }
+    memory_free(g_file_cache.watches);
+    g_file_cache.watches = NULL;
+    g_file_cache.watch_count = 0;
+
+    for (int i = 0; i < file_cache_bucket_count; i++) {
+        while (g_file_cache.buckets[i]) {
+            pi_file_cache_unload(g_file_cache.buckets[i]->path);
+        }
+    }
+}
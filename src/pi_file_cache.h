@@ -0,0 +1,83 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#ifndef PI_FILE_CACHE_H
+#define PI_FILE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include "pi_template_generator.h"
+
+// A file under get_file_directory(), keyed by its normalized path ("/css/app.css").
+//
+typedef struct pi_file_entry_struct {
+    char *path;
+
+    // Null terminated copy of the file, NULL when the file is too big to keep in memory.  Big
+    // files keep fd open instead so they can be streamed with sendfile.
+    //
+    char *contents;
+    int fd;
+    size_t size;
+    time_t mtime;
+
+    // Pages run through the template generator, everything else is sent as is.
+    //
+    bool template;
+    const char *content_type;
+
+    // Templates are compiled once when they are loaded, a changed file gets a new entry and so
+    // a new program.
+    //
+    pi_template_program_ptr program;
+
+    // Status line, Server, Content-Type and Content-Length for a 200 response, without the
+    // Connection header and the blank line that ends the headers.
+    //
+    char *response_header;
+
+    unsigned int references;
+    unsigned int generation;
+    struct pi_file_entry_struct *next;
+} pi_file_entry_t;
+
+typedef pi_file_entry_t *pi_file_entry_ptr;
+
+// Loads every file under get_file_directory() and starts watching the tree for changes.
+//
+bool pi_file_cache_start();
+
+void pi_file_cache_stop();
+
+// Returns the cached entry for path or NULL if there is no such file.  The entry stays valid
+// until it is released, even if the file changes in the meantime.
+//
+pi_file_entry_ptr pi_file_cache_acquire(const char *path);
+
+void pi_file_cache_release(pi_file_entry_ptr entry);
+
+#endif //PI_FILE_CACHE_H
@@ -0,0 +1,294 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "pi_gpio_capture.h"
+#include "pi_utils.h"
+
+#define gpio_capture_ring_mask (gpio_capture_ring_size - 1)
+
+// A capture running while it is downloaded may overwrite this many of the oldest samples
+// before the copy is done.
+//
+#define gpio_capture_slack (gpio_capture_ring_size / 8)
+
+// Below this the capture thread spins instead of sleeping until the next sample.
+//
+#define gpio_capture_spin_ns 100000
+
+#define gpio_capture_copy_attempts 3
+
+// The ring is written by the capture thread only, head counts the samples it holds and is
+// published after each one.
+//
+typedef struct pi_gpio_capture_struct {
+    gpio_bitset *ring;
+    unsigned long long head;
+    unsigned long long dropped;
+
+    pthread_mutex_t lock;
+    pthread_t thread_id;
+    bool running;
+    gpio_bitset pins;
+    unsigned int rate;
+    uint64_t started;
+    uint64_t stopped;
+} pi_gpio_capture_t;
+
+pi_gpio_capture_t g_gpio_capture = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static uint64_t pi_gpio_capture_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+// When sample number tick is due, in nanoseconds from the start, without overflowing on long
+// captures.
+//
+static inline uint64_t pi_gpio_capture_due(unsigned long long tick, unsigned int rate) {
+    return (tick / rate) * 1000000000ULL + (tick % rate) * 1000000000ULL / rate;
+}
+
+// Samples due by elapsed nanoseconds from the start.
+//
+static inline unsigned long long pi_gpio_capture_ticks(uint64_t elapsed, unsigned int rate) {
+    return (elapsed / 1000000000ULL) * rate + (elapsed % 1000000000ULL) * rate / 1000000000ULL;
+}
+
+// Keeps the capture on the last core, away from the server and the samplers which the
+// scheduler spreads from the first one.
+//
+static void pi_gpio_capture_pin_thread() {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cores > 1 ? (int) cores - 1 : 0, &set);
+
+    if (0 != pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) {
+        INFO_LOG("Unable to pin the GPIO capture thread to core %ld", cores - 1);
+    }
+}
+
+// Takes one sample per tick, sleeping until shortly before it is due and spinning the rest.  A
+// tick that is already past when the thread gets to it is counted as dropped, not taken late.
+//
+static void *pi_gpio_capture_thread(void *arg) {
+    (void) arg;
+
+    pi_gpio_capture_pin_thread();
+
+    gpio_bitset *ring = g_gpio_capture.ring;
+    gpio_bitset pins = g_gpio_capture.pins;
+    unsigned int rate = g_gpio_capture.rate;
+    uint64_t start = g_gpio_capture.started;
+
+    unsigned long long tick = 0;
+    unsigned long long head = 0;
+
+    while (__atomic_load_n(&g_gpio_capture.running, __ATOMIC_ACQUIRE)) {
+        uint64_t due = start + pi_gpio_capture_due(tick, rate);
+        uint64_t now = pi_gpio_capture_now();
+
+        if (due > now + gpio_capture_spin_ns) {
+            uint64_t wake = due - gpio_capture_spin_ns;
+            struct timespec until = {(time_t) (wake / 1000000000ULL), (long) (wake % 1000000000ULL)};
+
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL);
+        }
+
+        while (pi_gpio_capture_now() < due) {
+        }
+
+        ring[head & gpio_capture_ring_mask] = gpio_snapshot() & pins;
+        __atomic_store_n(&g_gpio_capture.head, ++head, __ATOMIC_RELEASE);
+
+        unsigned long long current = pi_gpio_capture_ticks(pi_gpio_capture_now() - start, rate);
+
+        if (current > tick + 1) {
+            __atomic_add_fetch(&g_gpio_capture.dropped, current - tick - 1, __ATOMIC_RELAXED);
+            tick = current;
+        }
+        else {
+            tick++;
+        }
+    }
+
+    return NULL;
+}
+
+bool pi_gpio_capture_start(gpio_bitset pins, unsigned int rate) {
+    if (0 == pins || 0 == rate || rate > gpio_capture_max_rate) {
+        return false;
+    }
+
+    pthread_mutex_lock(&g_gpio_capture.lock);
+
+    bool started = false;
+
+    if (!g_gpio_capture.running) {
+        if (NULL == g_gpio_capture.ring
+            && 0 != posix_memalign((void **) &g_gpio_capture.ring, 64, gpio_capture_ring_size * sizeof(gpio_bitset))) {
+            g_gpio_capture.ring = NULL;
+        }
+
+        if (g_gpio_capture.ring) {
+            g_gpio_capture.pins = pins;
+            g_gpio_capture.rate = rate;
+            g_gpio_capture.head = 0;
+            g_gpio_capture.dropped = 0;
+            g_gpio_capture.started = pi_gpio_capture_now();
+            g_gpio_capture.stopped = 0;
+            g_gpio_capture.running = true;
+
+            if (pthread_create(&g_gpio_capture.thread_id, NULL, &pi_gpio_capture_thread, NULL) == 0) {
+                INFO_LOG("Capturing GPIO pins 0x%llx at %u samples per second", (unsigned long long) pins, rate);
+                started = true;
+            }
+            else {
+                ERROR_LOG("Unable to start the GPIO capture thread");
+                g_gpio_capture.running = false;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&g_gpio_capture.lock);
+
+    return started;
+}
+
+void pi_gpio_capture_stop() {
+    pthread_mutex_lock(&g_gpio_capture.lock);
+
+    if (g_gpio_capture.running) {
+        __atomic_store_n(&g_gpio_capture.running, false, __ATOMIC_RELEASE);
+        pthread_join(g_gpio_capture.thread_id, NULL);
+        g_gpio_capture.stopped = pi_gpio_capture_now();
+
+        INFO_LOG("GPIO capture stopped after %llu samples, %llu dropped",
+                 g_gpio_capture.head, g_gpio_capture.dropped);
+    }
+
+    pthread_mutex_unlock(&g_gpio_capture.lock);
+}
+
+void pi_gpio_capture_status(pi_gpio_capture_status_ptr status) {
+    pthread_mutex_lock(&g_gpio_capture.lock);
+
+    memory_clear(status, sizeof(pi_gpio_capture_status_t));
+
+    status->running = g_gpio_capture.running;
+    status->pins = g_gpio_capture.pins;
+    status->rate = g_gpio_capture.rate;
+    status->samples = __atomic_load_n(&g_gpio_capture.head, __ATOMIC_ACQUIRE);
+    status->dropped = __atomic_load_n(&g_gpio_capture.dropped, __ATOMIC_RELAXED);
+
+    if (g_gpio_capture.started) {
+        uint64_t end = g_gpio_capture.running ? pi_gpio_capture_now() : g_gpio_capture.stopped;
+
+        if (end > g_gpio_capture.started) {
+            status->samples_per_sec = (double) status->samples * 1000000000.0 / (double) (end - g_gpio_capture.started);
+        }
+    }
+
+    pthread_mutex_unlock(&g_gpio_capture.lock);
+}
+
+// Copies the samples from first up to head out of the ring.
+//
+static void pi_gpio_capture_copy(gpio_bitset *samples, unsigned long long first, unsigned long long head) {
+    size_t begin = (size_t) (first & gpio_capture_ring_mask);
+    size_t count = (size_t) (head - first);
+    size_t part = min(count, gpio_capture_ring_size - begin);
+
+    memcpy(samples, g_gpio_capture.ring + begin, part * sizeof(gpio_bitset));
+    memcpy(samples + part, g_gpio_capture.ring, (count - part) * sizeof(gpio_bitset));
+}
+
+unsigned long long pi_gpio_capture_encode(pi_string_ptr output) {
+    pthread_mutex_lock(&g_gpio_capture.lock);
+
+    bool running = g_gpio_capture.running;
+    unsigned long long first = 0;
+    size_t count = 0;
+    gpio_bitset *samples = NULL;
+
+    if (g_gpio_capture.ring) {
+        samples = memory_alloc(gpio_capture_ring_size * sizeof(gpio_bitset));
+
+        for (int attempt = 0; attempt < gpio_capture_copy_attempts; attempt++) {
+            unsigned long long head = __atomic_load_n(&g_gpio_capture.head, __ATOMIC_ACQUIRE);
+            unsigned long long kept = min(head, (unsigned long long) gpio_capture_ring_size);
+
+            if (running) {
+                kept = kept > gpio_capture_slack ? kept - gpio_capture_slack : 0;
+            }
+
+            first = head - kept;
+            pi_gpio_capture_copy(samples, first, head);
+
+            // The capture may have lapped the copy if it took more than the slack.
+            //
+            if (!running || __atomic_load_n(&g_gpio_capture.head, __ATOMIC_ACQUIRE) - head <= gpio_capture_slack) {
+                count = (size_t) kept;
+                break;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&g_gpio_capture.lock);
+
+    pi_string_append_char(output, '[');
+
+    for (size_t i = 0; i < count;) {
+        size_t run = i + 1;
+
+        while (run < count && samples[run] == samples[i]) {
+            run++;
+        }
+
+        pi_string_sprintf(output, i ? ",[%llu,%zu]" : "[%llu,%zu]", (unsigned long long) samples[i], run - i);
+        i = run;
+    }
+
+    pi_string_append_char(output, ']');
+
+    memory_free(samples);
+
+    return first;
+}
@@ -0,0 +1,70 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#ifndef PI_GPIO_CAPTURE_H
+#define PI_GPIO_CAPTURE_H
+
+#include <stdbool.h>
+#include "pi_chart_gpio.h"
+#include "pi_string.h"
+
+// Samples kept, the newest overwrite the oldest.  A power of two.
+//
+#define gpio_capture_ring_size (1u << 18)
+
+#define gpio_capture_max_rate 10000000u
+
+typedef struct pi_gpio_capture_status_struct {
+    bool running;
+    gpio_bitset pins;
+    unsigned int rate;
+
+    // Samples taken since the capture started and sample times missed because the capture
+    // thread was late.
+    //
+    unsigned long long samples;
+    unsigned long long dropped;
+    double samples_per_sec;
+} pi_gpio_capture_status_t;
+
+typedef pi_gpio_capture_status_t *pi_gpio_capture_status_ptr;
+
+// Starts sampling pins rate times a second on a thread pinned to the last core, false when a
+// capture is already running or the arguments are out of range.
+//
+bool pi_gpio_capture_start(gpio_bitset pins, unsigned int rate);
+
+void pi_gpio_capture_stop();
+
+void pi_gpio_capture_status(pi_gpio_capture_status_ptr status);
+
+// Appends the samples in the ring, oldest first, as a JSON array of [levels, samples] runs, one
+// per change of the captured pins, and returns the number of the first sample.  Works while the
+// capture runs, the oldest samples the capture could overwrite during the copy are left out.
+//
+unsigned long long pi_gpio_capture_encode(pi_string_ptr output);
+
+#endif //PI_GPIO_CAPTURE_H
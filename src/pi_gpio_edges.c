@@ -0,0 +1,172 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pi_gpio_edges.h"
+#include "pi_chart_gpio.h"
+#include "pi_chart_settings.h"
+#include "pi_sampler.h"
+#include "pi_seqlock.h"
+#include "pi_utils.h"
+
+#ifndef __unused
+#define __unused
+#endif
+
+// Written by the edge handlers only, a cache line each so handlers of different pins do not
+// contend.  The time stamp is stored before the count is published.
+//
+typedef struct pi_gpio_edge_counter_struct {
+    unsigned long long count;
+    uint64_t last_edge;
+} __attribute__((aligned(64))) pi_gpio_edge_counter_t;
+
+// What the sampler saw last time, for the frequency.
+//
+typedef struct pi_gpio_edge_history_struct {
+    unsigned long long count;
+    uint64_t last_edge;
+    double hz;
+} pi_gpio_edge_history_t;
+
+typedef struct pi_gpio_edges_sampler_struct {
+    pi_gpio_edge_counter_t counters[gpio_edges_max_pins];
+    bool counting[gpio_edges_max_pins];
+
+    pthread_mutex_t lock;
+    pi_sampler_ptr sampler;
+    pi_gpio_edge_history_t history[gpio_edges_max_pins];
+
+    pi_seqlock_t published_lock;
+    pi_gpio_edges_t published;
+} pi_gpio_edges_sampler_t;
+
+pi_gpio_edges_sampler_t g_gpio_edges = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static void pi_gpio_edges_record(unsigned char pin, uint64_t nanoseconds) {
+    pi_gpio_edge_counter_t *counter = &g_gpio_edges.counters[pin];
+
+    __atomic_store_n(&counter->last_edge, nanoseconds, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&counter->count, 1, __ATOMIC_RELEASE);
+}
+
+bool pi_gpio_edges_count(unsigned char pin) {
+    if (pin >= gpio_edges_max_pins) {
+        return false;
+    }
+
+    pthread_mutex_lock(&g_gpio_edges.lock);
+
+    bool counting = g_gpio_edges.counting[pin];
+
+    if (!counting && gpio_watch_edges(pin, pi_gpio_edges_record)) {
+        __atomic_store_n(&g_gpio_edges.counting[pin], true, __ATOMIC_RELEASE);
+        counting = true;
+
+        INFO_LOG("Counting rising edges on pin %u", (unsigned int) pin);
+    }
+
+    pthread_mutex_unlock(&g_gpio_edges.lock);
+
+    return counting;
+}
+
+void pi_gpio_edges_sample(void __unused *context) {
+    struct timespec now_time;
+    clock_gettime(CLOCK_MONOTONIC, &now_time);
+    uint64_t now = (uint64_t) now_time.tv_sec * 1000000000ULL + (uint64_t) now_time.tv_nsec;
+
+    pi_gpio_edges_t sample;
+    memory_clear(&sample, sizeof(sample));
+
+    for (int pin = 0; pin < gpio_edges_max_pins; pin++) {
+        if (!__atomic_load_n(&g_gpio_edges.counting[pin], __ATOMIC_ACQUIRE)) {
+            continue;
+        }
+
+        pi_gpio_edge_counter_t *counter = &g_gpio_edges.counters[pin];
+        pi_gpio_edge_history_t *history = &g_gpio_edges.history[pin];
+
+        unsigned long long count = __atomic_load_n(&counter->count, __ATOMIC_ACQUIRE);
+        uint64_t last_edge = __atomic_load_n(&counter->last_edge, __ATOMIC_RELAXED);
+
+        // Edges since the last sample over the time from the last edge then to the last edge now
+        // is exact for slow signals, which a count per interval is not.
+        //
+        if (count > history->count && history->last_edge && last_edge > history->last_edge) {
+            history->hz = (double) (count - history->count) * 1000000000.0 / (double) (last_edge - history->last_edge);
+        }
+        else if (count == history->count && history->hz > 0
+                 && (double) (now - last_edge) > 2000000000.0 / history->hz) {
+            history->hz = 0;
+        }
+
+        history->count = count;
+        history->last_edge = last_edge;
+
+        sample.pins[pin].counting = true;
+        sample.pins[pin].count = count;
+        sample.pins[pin].hz = history->hz;
+    }
+
+    pi_seqlock_write(&g_gpio_edges.published_lock, &g_gpio_edges.published, &sample, sizeof(sample));
+}
+
+bool pi_gpio_edges_start() {
+    const char *list = get_count_pins();
+
+    while (list && *list) {
+        char *end = NULL;
+        long pin = strtol(list, &end, 10);
+
+        if (end == list || (*end != ',' && *end != '\0') || pin < 0 || pin >= gpio_edges_max_pins
+            || !pi_gpio_edges_count((unsigned char) pin)) {
+            ERROR_LOG("Unable to count edges on pin %ld", pin);
+        }
+
+        const char *comma = strchr(list, ',');
+        list = comma ? comma + 1 : NULL;
+    }
+
+    g_gpio_edges.sampler = pi_sampler_start("gpio edges", pi_gpio_edges_sample, NULL);
+
+    return NULL != g_gpio_edges.sampler;
+}
+
+void pi_gpio_edges_stop() {
+    pi_sampler_stop(g_gpio_edges.sampler);
+    g_gpio_edges.sampler = NULL;
+}
+
+void pi_gpio_edges_get(pi_gpio_edges_ptr edges) {
+    pi_seqlock_read(&g_gpio_edges.published_lock, edges, &g_gpio_edges.published, sizeof(pi_gpio_edges_t));
+}
@@ -0,0 +1,70 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#ifndef PI_GPIO_EDGES_H
+#define PI_GPIO_EDGES_H
+
+#include <stdbool.h>
+
+// Pins 0 to gpio_edges_max_pins - 1 can be counted, the same range templates may name.
+//
+#define gpio_edges_max_pins 64
+
+typedef struct pi_gpio_edge_count_struct {
+    bool counting;
+
+    // Rising edges since counting started.
+    //
+    unsigned long long count;
+
+    // From the time between the first and last edge of the latest interval, 0 once the pin has
+    // been quiet for two periods.
+    //
+    double hz;
+} pi_gpio_edge_count_t;
+
+typedef struct pi_gpio_edges_struct {
+    pi_gpio_edge_count_t pins[gpio_edges_max_pins];
+} pi_gpio_edges_t;
+
+typedef pi_gpio_edges_t *pi_gpio_edges_ptr;
+
+// Counts the pins in get_count_pins() and computes frequencies every get_sample_interval()
+// milliseconds.
+//
+bool pi_gpio_edges_start();
+
+void pi_gpio_edges_stop();
+
+// Starts counting rising edges on pin, true when the pin is counted.
+//
+bool pi_gpio_edges_count(unsigned char pin);
+
+// Copies the latest counts, never waits for the sampler or the edge handlers.
+//
+void pi_gpio_edges_get(pi_gpio_edges_ptr edges);
+
+#endif //PI_GPIO_EDGES_H
@@ -0,0 +1,183 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#include <strings.h>
+#include <string.h>
+#include "pi_http_headers.h"
+#include "pi_utils.h"
+
+typedef struct pi_http_known_header_struct {
+    const char *name;
+    size_t length;
+} pi_http_known_header_t;
+
+// Has to stay in sync with http_header_t.
+//
+static const pi_http_known_header_t g_known_headers[http_header_known_count] = {
+        {"Host",              4},
+        {"Connection",        10},
+        {"Content-Length",    14},
+        {"Transfer-Encoding", 17},
+        {"Accept-Encoding",   15},
+        {"If-None-Match",     13},
+};
+
+void pi_http_headers_reset(pi_http_headers_ptr headers, const char *buffer) {
+    memory_clear(headers->known_present, sizeof(headers->known_present));
+    headers->other_count = 0;
+    headers->dropped = false;
+    headers->buffer = buffer;
+}
+
+// Optional white space is only spaces and tabs (RFC 7230 3.2.3), request bytes may be anything.
+//
+static inline bool pi_http_is_ows(char c) {
+    return c == ' ' || c == '\t';
+}
+
+http_header_t pi_http_headers_identify(const char *key, size_t length) {
+    for (int i = 0; i < http_header_known_count; i++) {
+        if (g_known_headers[i].length == length && 0 == strncasecmp(g_known_headers[i].name, key, length)) {
+            return (http_header_t) i;
+        }
+    }
+
+    return http_header_known_count;
+}
+
+bool pi_http_headers_parse_line(pi_http_headers_ptr headers, unsigned int line_offset, unsigned int line_length) {
+    const char *line = headers->buffer + line_offset;
+    const char *colon = memchr(line, ':', line_length);
+
+    if (NULL == colon || colon == line) {
+        headers->dropped = true;
+        return false;
+    }
+
+    // Trim the optional white space around the key and the value.
+    //
+    const char *key_end = colon;
+    while (key_end > line && pi_http_is_ows(*(key_end - 1))) {
+        key_end--;
+    }
+
+    const char *value = colon + 1;
+    const char *value_end = line + line_length;
+    while (value < value_end && pi_http_is_ows(*value)) {
+        value++;
+    }
+    while (value_end > value && pi_http_is_ows(*(value_end - 1))) {
+        value_end--;
+    }
+
+    pi_http_slice_t key_slice = {line_offset, (unsigned int) (key_end - line)};
+    pi_http_slice_t value_slice = {(unsigned int) (value - headers->buffer), (unsigned int) (value_end - value)};
+
+    http_header_t header = pi_http_headers_identify(line, key_slice.length);
+
+    if (header != http_header_known_count) {
+        headers->known_present[header] = true;
+        headers->known[header] = value_slice;
+        return true;
+    }
+
+    if (headers->other_count >= http_max_other_headers) {
+        headers->dropped = true;
+        return false;
+    }
+
+    headers->other[headers->other_count].key = key_slice;
+    headers->other[headers->other_count].value = value_slice;
+    headers->other_count++;
+
+    return true;
+}
+
+bool pi_http_headers_get(pi_http_headers_ptr headers, http_header_t header, const char **value, size_t *length) {
+    if (header >= http_header_known_count || !headers->known_present[header]) {
+        return false;
+    }
+
+    *value = headers->buffer + headers->known[header].offset;
+    *length = headers->known[header].length;
+
+    return true;
+}
+
+bool pi_http_headers_find(pi_http_headers_ptr headers, const char *name, const char **value, size_t *length) {
+    size_t name_length = strlen(name);
+
+    http_header_t header = pi_http_headers_identify(name, name_length);
+    if (header != http_header_known_count) {
+        return pi_http_headers_get(headers, header, value, length);
+    }
+
+    for (unsigned int i = 0; i < headers->other_count; i++) {
+        pi_http_header_pair_t *pair = &headers->other[i];
+
+        if (pair->key.length == name_length
+            && 0 == strncasecmp(headers->buffer + pair->key.offset, name, name_length)) {
+            *value = headers->buffer + pair->value.offset;
+            *length = pair->value.length;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool pi_http_headers_has_token(pi_http_headers_ptr headers, http_header_t header, const char *token) {
+    const char *value = NULL;
+    size_t length = 0;
+    size_t token_length = strlen(token);
+
+    if (!pi_http_headers_get(headers, header, &value, &length)) {
+        return false;
+    }
+
+    const char *end = value + length;
+
+    while (value < end) {
+        const char *comma = memchr(value, ',', (size_t) (end - value));
+        const char *element_end = comma ? comma : end;
+        const char *element = value;
+
+        while (element < element_end && pi_http_is_ows(*element)) {
+            element++;
+        }
+        while (element_end > element && pi_http_is_ows(*(element_end - 1))) {
+            element_end--;
+        }
+
+        if ((size_t) (element_end - element) == token_length && 0 == strncasecmp(element, token, token_length)) {
+            return true;
+        }
+
+        value = comma ? comma + 1 : end;
+    }
+
+    return false;
+}
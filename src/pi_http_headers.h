@@ -0,0 +1,101 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#ifndef PI_HTTP_HEADERS_H
+#define PI_HTTP_HEADERS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Headers we look at ourselves get a fixed slot so finding them is an array index.
+//
+typedef enum {
+    http_header_host = 0,
+    http_header_connection,
+    http_header_content_length,
+    http_header_transfer_encoding,
+    http_header_accept_encoding,
+    http_header_if_none_match,
+    http_header_known_count
+} http_header_t;
+
+// Most headers we are willing to keep per request beyond the known ones, the rest are dropped.
+//
+#define http_max_other_headers 32
+
+// A view into the connection's read buffer, nothing is copied.
+//
+typedef struct pi_http_slice_struct {
+    unsigned int offset;
+    unsigned int length;
+} pi_http_slice_t;
+
+typedef struct pi_http_header_pair_struct {
+    pi_http_slice_t key;
+    pi_http_slice_t value;
+} pi_http_header_pair_t;
+
+// Request scoped and meant to live on the stack, the buffer has to outlive the table.
+//
+typedef struct pi_http_headers_struct {
+    const char *buffer;
+
+    bool known_present[http_header_known_count];
+    pi_http_slice_t known[http_header_known_count];
+
+    unsigned int other_count;
+    pi_http_header_pair_t other[http_max_other_headers];
+
+    // A line could not be stored, a header that matters to framing may be among the lost ones.
+    //
+    bool dropped;
+} pi_http_headers_t;
+
+typedef pi_http_headers_t *pi_http_headers_ptr;
+
+// Empties the table, all slices are relative to buffer.
+//
+void pi_http_headers_reset(pi_http_headers_ptr headers, const char *buffer);
+
+// Splits a "Key: value" header line that starts at line_offset in the buffer and records it.
+// Returns false and sets dropped for lines that are not headers or if there is no room left.
+//
+bool pi_http_headers_parse_line(pi_http_headers_ptr headers, unsigned int line_offset, unsigned int line_length);
+
+// Looks up one of the known headers, value points into the buffer and is not null terminated.
+//
+bool pi_http_headers_get(pi_http_headers_ptr headers, http_header_t header, const char **value, size_t *length);
+
+// Looks up any header by name (case insensitive).
+//
+bool pi_http_headers_find(pi_http_headers_ptr headers, const char *name, const char **value, size_t *length);
+
+// True if token is one of the comma separated elements of a known header (case insensitive),
+// as in "Connection: keep-alive, Upgrade".
+//
+bool pi_http_headers_has_token(pi_http_headers_ptr headers, http_header_t header, const char *token);
+
+#endif //PI_HTTP_HEADERS_H
@@ -0,0 +1,179 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "pi_i2c_bus.h"
+#include "pi_utils.h"
+
+#ifdef __linux__
+#include <linux/i2c-dev.h>
+#endif
+
+// Standard mode, 9 clocks a byte with the acknowledge.
+//
+#define i2c_emulated_bit_rate 100000
+#define i2c_bits_per_byte 9
+
+#define i2c_emulated_request_size 32
+
+typedef struct pi_i2c_emulated_device_struct {
+    pi_i2c_device_emulator_t emulator;
+    unsigned char request[i2c_emulated_request_size];
+    size_t request_length;
+} pi_i2c_emulated_device_t;
+
+// A bus is only used from the thread that schedules it.
+//
+struct pi_i2c_bus_struct {
+    char *name;
+
+    // -1 for the emulated bus.
+    //
+    int fd;
+
+    // The address the last I2C_SLAVE was set to, it sticks to the fd until it is set again.
+    //
+    int address;
+
+    pi_i2c_emulated_device_t *devices;
+};
+
+pi_i2c_bus_ptr pi_i2c_bus_open(const char *path) {
+    pi_i2c_bus_ptr bus = memory_alloc(sizeof(pi_i2c_bus_t));
+    bus->name = strdup(path);
+    bus->fd = -1;
+    bus->address = -1;
+
+    if (0 == strcmp(path, i2c_emulated_bus)) {
+        bus->devices = memory_alloc(i2c_max_addresses * sizeof(pi_i2c_emulated_device_t));
+        return bus;
+    }
+
+    bus->fd = open(path, O_RDWR | O_CLOEXEC);
+
+    if (bus->fd < 0) {
+        ERROR_LOG("Unable to open I2C bus %s, error: %d", path, errno);
+        pi_i2c_bus_close(bus);
+        return NULL;
+    }
+
+    return bus;
+}
+
+void pi_i2c_bus_close(pi_i2c_bus_ptr bus) {
+    if (bus) {
+        if (bus->fd >= 0) {
+            close(bus->fd);
+        }
+
+        memory_free(bus->devices);
+        memory_free(bus->name);
+        memory_free(bus);
+    }
+}
+
+const char *pi_i2c_bus_name(pi_i2c_bus_ptr bus) {
+    return bus->name;
+}
+
+bool pi_i2c_bus_emulate(pi_i2c_bus_ptr bus, unsigned char address, pi_i2c_device_emulator_t emulator) {
+    if (NULL == bus->devices || address >= i2c_max_addresses) {
+        return false;
+    }
+
+    bus->devices[address].emulator = emulator;
+
+    return true;
+}
+
+// Holds the calling thread for as long as the bytes plus the address byte take on the wire.
+//
+static void pi_i2c_bus_transfer_time(size_t length) {
+    long nanoseconds = (long) ((length + 1) * i2c_bits_per_byte * (1000000000L / i2c_emulated_bit_rate));
+    struct timespec wire = {nanoseconds / 1000000000L, nanoseconds % 1000000000L};
+
+    nanosleep(&wire, NULL);
+}
+
+// Points the fd at address, a no-op when it already is.
+//
+static bool pi_i2c_bus_address(pi_i2c_bus_ptr bus, unsigned char address) {
+    if (bus->address == address) {
+        return true;
+    }
+
+#ifdef __linux__
+    if (ioctl(bus->fd, I2C_SLAVE, address) < 0) {
+        ERROR_LOG("Unable to address 0x%x on I2C bus %s, error: %d", address, bus->name, errno);
+        return false;
+    }
+
+    bus->address = address;
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+ssize_t pi_i2c_bus_write(pi_i2c_bus_ptr bus, unsigned char address, const unsigned char *data, size_t length) {
+    if (bus->devices) {
+        pi_i2c_bus_transfer_time(length);
+
+        if (address >= i2c_max_addresses || NULL == bus->devices[address].emulator) {
+            return -1;
+        }
+
+        pi_i2c_emulated_device_t *device = &bus->devices[address];
+        device->request_length = min(length, sizeof(device->request));
+        memcpy(device->request, data, device->request_length);
+
+        return (ssize_t) length;
+    }
+
+    return pi_i2c_bus_address(bus, address) ? write(bus->fd, data, length) : -1;
+}
+
+ssize_t pi_i2c_bus_read(pi_i2c_bus_ptr bus, unsigned char address, unsigned char *data, size_t size) {
+    if (bus->devices) {
+        pi_i2c_bus_transfer_time(size);
+
+        if (address >= i2c_max_addresses || NULL == bus->devices[address].emulator) {
+            return -1;
+        }
+
+        pi_i2c_emulated_device_t *device = &bus->devices[address];
+
+        return device->emulator(device->request, device->request_length, data, size);
+    }
+
+    return pi_i2c_bus_address(bus, address) ? read(bus->fd, data, size) : -1;
+}
@@ -0,0 +1,72 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#ifndef PI_I2C_BUS_H
+#define PI_I2C_BUS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// I2C addresses are 7 bits.
+//
+#define i2c_max_addresses 128
+
+// Name of the bus that only exists in memory.
+//
+#define i2c_emulated_bus "emulated"
+
+// Answers a read for a device on the emulated bus from the last bytes written to it.  Returns
+// the number of bytes in response or -1 for a device that does not acknowledge.
+//
+typedef ssize_t (*pi_i2c_device_emulator_t)(const unsigned char *request, size_t request_length,
+                                             unsigned char *response, size_t size);
+
+typedef struct pi_i2c_bus_struct pi_i2c_bus_t;
+
+typedef pi_i2c_bus_t *pi_i2c_bus_ptr;
+
+// Opens an i2c-dev bus such as "/dev/i2c-1", or the emulated bus for i2c_emulated_bus.  Returns
+// NULL if the device cannot be opened.
+//
+pi_i2c_bus_ptr pi_i2c_bus_open(const char *path);
+
+void pi_i2c_bus_close(pi_i2c_bus_ptr bus);
+
+const char *pi_i2c_bus_name(pi_i2c_bus_ptr bus);
+
+// Puts an emulated device at address, false on a real bus.
+//
+bool pi_i2c_bus_emulate(pi_i2c_bus_ptr bus, unsigned char address, pi_i2c_device_emulator_t emulator);
+
+// One transaction each, the return values are those of write(2) and read(2).  The emulated bus
+// takes as long as the bytes would at 100 kHz.
+//
+ssize_t pi_i2c_bus_write(pi_i2c_bus_ptr bus, unsigned char address, const unsigned char *data, size_t length);
+
+ssize_t pi_i2c_bus_read(pi_i2c_bus_ptr bus, unsigned char address, unsigned char *data, size_t size);
+
+#endif //PI_I2C_BUS_H
@@ -24,11 +24,101 @@
 //
 **********************************************************************/
 
-#include <memory.h>
+#include <string.h>
 #include "pi_mem_info.h"
-#include "stdio.h"
+#include "pi_proc_file.h"
+#include "pi_sampler.h"
+#include "pi_seqlock.h"
 #include "pi_utils.h"
 
+#ifndef __unused
+#define __unused
+#endif
+
+static const char *mem_info_names[mem_info_field_count] = {
+        "MemTotal",
+        "MemFree",
+        "MemAvailable",
+        "Buffers",
+        "Cached",
+        "SwapCached",
+        "Active",
+        "Inactive",
+        "Active(anon)",
+        "Inactive(anon)",
+        "Active(file)",
+        "Inactive(file)",
+        "Unevictable",
+        "Mlocked",
+        "HighTotal",
+        "HighFree",
+        "LowTotal",
+        "LowFree",
+        "SwapTotal",
+        "SwapFree",
+        "Zswap",
+        "Zswapped",
+        "Dirty",
+        "Writeback",
+        "AnonPages",
+        "Mapped",
+        "Shmem",
+        "KReclaimable",
+        "Slab",
+        "SReclaimable",
+        "SUnreclaim",
+        "KernelStack",
+        "PageTables",
+        "SecPageTables",
+        "NFS_Unstable",
+        "Bounce",
+        "WritebackTmp",
+        "CommitLimit",
+        "Committed_AS",
+        "VmallocTotal",
+        "VmallocUsed",
+        "VmallocChunk",
+        "Percpu",
+        "HardwareCorrupted",
+        "AnonHugePages",
+        "ShmemHugePages",
+        "ShmemPmdMapped",
+        "FileHugePages",
+        "FilePmdMapped",
+        "CmaTotal",
+        "CmaFree",
+        "Unaccepted",
+        "Balloon",
+        "HugePages_Total",
+        "HugePages_Free",
+        "HugePages_Rsvd",
+        "HugePages_Surp",
+        "Hugepagesize",
+        "Hugetlb",
+        "DirectMap4k",
+        "DirectMap2M",
+        "DirectMap1G",
+};
+
+typedef struct pi_mem_info_sampler_struct {
+    pi_proc_file_ptr file;
+    pi_sampler_ptr sampler;
+    pi_seqlock_t lock;
+    pi_mem_info_t published;
+} pi_mem_info_sampler_t;
+
+pi_mem_info_sampler_t g_mem_info;
+
+int pi_mem_info_find_field(const char *begin, const char *end) {
+    for (int i = 0; i < mem_info_field_count; i++) {
+        if (pi_proc_token_equals(begin, end, mem_info_names[i])) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
 const char *pi_mem_info_get_file_name(){
 #ifdef __MACH__
     // Mac OS Emulator code
@@ -41,34 +131,80 @@ const char *pi_mem_info_get_file_name(){
 #endif
 }
 
-bool pi_mem_info_get_attribute(pi_string_ptr output_string, const char *symbol) {
+int pi_mem_info_field(const char *name) {
+    return pi_mem_info_find_field(name, name + strlen(name));
+}
+
+bool pi_mem_info_find_extra(const pi_mem_info_t *mem_info, const char *name, unsigned long long *value) {
+    for (unsigned int i = 0; i < mem_info->extra_count && i < mem_info_max_extra; i++) {
+        if (0 == strcmp(mem_info->extra[i].name, name)) {
+            *value = mem_info->extra[i].value;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void pi_mem_info_sample(void __unused *context) {
+    if (!pi_proc_file_read(g_mem_info.file)) {
+        return;
+    }
+
+    // Lines look like "MemTotal:        3867772 kB".  The fields come in the same order on
+    // every read, so the next field is tried first.
+    //
+    pi_mem_info_t sample;
+    memory_clear(&sample, sizeof(sample));
 
-    FILE *file_ptr = fopen(pi_mem_info_get_file_name(), "r");
-    bool found_value = false;
+    int next_field = 0;
+    pi_proc_line_t line;
 
-    if(file_ptr != NULL) {
-        const size_t buffer_size = 256;
-        char buffer[buffer_size];
-        memory_clear(buffer, sizeof(buffer));
+    while (pi_proc_file_next_line(g_mem_info.file, &line)) {
+        if (NULL == line.colon) {
+            continue;
+        }
 
-        char *ptr_to_token = NULL;
+        int field = next_field < mem_info_field_count
+                    && pi_proc_token_equals(line.begin, line.colon, mem_info_names[next_field])
+                    ? next_field
+                    : pi_mem_info_find_field(line.begin, line.colon);
 
-        while(*fgets(buffer, (buffer_size-1), file_ptr) != EOF){
-            ptr_to_token = strtok(buffer, ": ");
-            if(strcmp(ptr_to_token, symbol) == 0) {
-                pi_string_append_str(output_string, strtok(NULL, ": "));
-                found_value = true;
-                break;
-            }
+        if (field >= 0) {
+            pi_proc_parse_u64(line.colon + 1, line.end, &sample.values[field]);
+            next_field = field + 1;
+        }
+        else if (sample.extra_count < mem_info_max_extra && line.colon - line.begin < mem_info_name_length) {
+            pi_mem_info_extra_t *extra = &sample.extra[sample.extra_count++];
 
-            memory_clear(buffer, sizeof(buffer));
+            memcpy(extra->name, line.begin, (size_t) (line.colon - line.begin));
+            pi_proc_parse_u64(line.colon + 1, line.end, &extra->value);
         }
     }
-    else {
-        ERROR_LOG("meminfo not found: %s", pi_mem_info_get_file_name());
+
+    pi_seqlock_write(&g_mem_info.lock, &g_mem_info.published, &sample, sizeof(sample));
+}
+
+bool pi_mem_info_start() {
+    g_mem_info.file = pi_proc_file_new(pi_mem_info_get_file_name());
+
+    if (NULL == g_mem_info.file) {
+        return false;
     }
 
-    fclose(file_ptr);
+    g_mem_info.sampler = pi_sampler_start("meminfo", pi_mem_info_sample, NULL);
+
+    return NULL != g_mem_info.sampler;
+}
+
+void pi_mem_info_stop() {
+    pi_sampler_stop(g_mem_info.sampler);
+    g_mem_info.sampler = NULL;
+
+    pi_proc_file_delete(g_mem_info.file);
+    g_mem_info.file = NULL;
+}
 
-    return found_value;
-}
\ No newline at end of file
+void pi_mem_info_get(pi_mem_info_ptr mem_info) {
+    pi_seqlock_read(&g_mem_info.lock, mem_info, &g_mem_info.published, sizeof(pi_mem_info_t));
+}
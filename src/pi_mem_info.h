@@ -28,8 +28,112 @@
 #define PI_CHART_PI_MEM_INFO_H
 
 #include <stdbool.h>
-#include "pi_string.h"
 
-bool pi_mem_info_get_attribute(pi_string_ptr output_string, const char *symbol);
+// The /proc/meminfo fields that are sampled, values are in kB except the HugePages counts.
+//
+typedef enum {
+    mem_info_mem_total,
+    mem_info_mem_free,
+    mem_info_mem_available,
+    mem_info_buffers,
+    mem_info_cached,
+    mem_info_swap_cached,
+    mem_info_active,
+    mem_info_inactive,
+    mem_info_active_anon,
+    mem_info_inactive_anon,
+    mem_info_active_file,
+    mem_info_inactive_file,
+    mem_info_unevictable,
+    mem_info_mlocked,
+    mem_info_high_total,
+    mem_info_high_free,
+    mem_info_low_total,
+    mem_info_low_free,
+    mem_info_swap_total,
+    mem_info_swap_free,
+    mem_info_zswap,
+    mem_info_zswapped,
+    mem_info_dirty,
+    mem_info_writeback,
+    mem_info_anon_pages,
+    mem_info_mapped,
+    mem_info_shmem,
+    mem_info_kreclaimable,
+    mem_info_slab,
+    mem_info_sreclaimable,
+    mem_info_sunreclaim,
+    mem_info_kernel_stack,
+    mem_info_page_tables,
+    mem_info_sec_page_tables,
+    mem_info_nfs_unstable,
+    mem_info_bounce,
+    mem_info_writeback_tmp,
+    mem_info_commit_limit,
+    mem_info_committed_as,
+    mem_info_vmalloc_total,
+    mem_info_vmalloc_used,
+    mem_info_vmalloc_chunk,
+    mem_info_percpu,
+    mem_info_hardware_corrupted,
+    mem_info_anon_huge_pages,
+    mem_info_shmem_huge_pages,
+    mem_info_shmem_pmd_mapped,
+    mem_info_file_huge_pages,
+    mem_info_file_pmd_mapped,
+    mem_info_cma_total,
+    mem_info_cma_free,
+    mem_info_unaccepted,
+    mem_info_balloon,
+    mem_info_huge_pages_total,
+    mem_info_huge_pages_free,
+    mem_info_huge_pages_rsvd,
+    mem_info_huge_pages_surp,
+    mem_info_huge_page_size,
+    mem_info_hugetlb,
+    mem_info_direct_map_4k,
+    mem_info_direct_map_2m,
+    mem_info_direct_map_1g,
+    mem_info_field_count
+} mem_info_field_t;
+
+// Lines the table above does not know, newer kernels keep adding fields.
+//
+#define mem_info_max_extra 16
+#define mem_info_name_length 32
+
+typedef struct pi_mem_info_extra_struct {
+    char name[mem_info_name_length];
+    unsigned long long value;
+} pi_mem_info_extra_t;
+
+typedef struct pi_mem_info_struct {
+    unsigned long long values[mem_info_field_count];
+
+    // The first mem_info_max_extra lines that are not in the table, in file order.
+    //
+    unsigned int extra_count;
+    pi_mem_info_extra_t extra[mem_info_max_extra];
+} pi_mem_info_t;
+
+typedef pi_mem_info_t *pi_mem_info_ptr;
+
+// Starts sampling /proc/meminfo every get_sample_interval() milliseconds.
+//
+bool pi_mem_info_start();
+
+void pi_mem_info_stop();
+
+// Copies the latest sample, never touches the file system and never waits for the sampler.
+//
+void pi_mem_info_get(pi_mem_info_ptr mem_info);
+
+// Returns the field called name ("MemTotal") or -1.
+//
+int pi_mem_info_field(const char *name);
+
+// Looks up a line that is not in the table by name, false if the sample does not have it.
+//
+bool pi_mem_info_find_extra(const pi_mem_info_t *mem_info, const char *name, unsigned long long *value);
 
 #endif //PI_CHART_PI_MEM_INFO_H
@@ -0,0 +1,336 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include "pi_net_dev.h"
+#include "pi_proc_file.h"
+#include "pi_sampler.h"
+#include "pi_seqlock.h"
+#include "pi_utils.h"
+
+#ifndef __unused
+#define __unused
+#endif
+
+static const char *net_dev_metric_names[net_dev_metric_count] = {
+        "rx_bytes_per_sec",
+        "tx_bytes_per_sec",
+        "rx_packets_per_sec",
+        "tx_packets_per_sec",
+        "rx_errors_per_sec",
+        "tx_errors_per_sec",
+        "rx_drops_per_sec",
+        "tx_drops_per_sec",
+};
+
+// Receive bytes, packets, errs and drop are the first four columns after the ':', transmit
+// starts at column 8 in the same order.
+//
+#define net_dev_column_count 16
+#define net_dev_tx_column 8
+
+typedef struct pi_net_slot_struct {
+    char name[net_dev_name_length];
+    bool used;
+
+    // A template named the interface, the slot is not given away when the interface goes.
+    //
+    bool bound;
+
+    // counters hold the previous sample of the interface, rates need one.
+    //
+    bool counted;
+    unsigned long long counters[net_dev_metric_count];
+} pi_net_slot_t;
+
+// The sampler maps the lines of /proc/net/dev to slots once and only builds the map again when
+// the interfaces in the file change.  The lock guards the slots: binding takes it to claim one
+// and the sampler holds it while it reads them, which only waits while a template is compiled.
+//
+typedef struct pi_net_dev_sampler_struct {
+    pi_proc_file_ptr file;
+    pi_sampler_ptr sampler;
+    struct timespec sampled;
+
+    pthread_mutex_t lock;
+    pi_net_slot_t slots[net_dev_max_interfaces];
+
+    int line_slots[net_dev_max_interfaces];
+    unsigned int line_count;
+
+    pi_seqlock_t published_lock;
+    pi_net_dev_t published;
+} pi_net_dev_sampler_t;
+
+pi_net_dev_sampler_t g_net_dev = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+const char *pi_net_dev_get_file_name() {
+#ifdef __MACH__
+    // Mac OS Emulator code
+    //
+    return "./proc/net/dev";
+#else
+    return "/proc/net/dev";
+#endif
+}
+
+int pi_net_dev_metric(const char *name) {
+    for (int i = 0; i < net_dev_metric_count; i++) {
+        if (0 == strcmp(name, net_dev_metric_names[i])) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+const char *pi_net_dev_metric_name(net_dev_metric_t metric) {
+    return metric < net_dev_metric_count ? net_dev_metric_names[metric] : "";
+}
+
+// Call with the lock held.
+//
+int pi_net_dev_find_slot(const char *begin, const char *end, bool claim) {
+    int free_slot = -1;
+
+    for (int i = 0; i < net_dev_max_interfaces; i++) {
+        if (!g_net_dev.slots[i].used) {
+            free_slot = free_slot < 0 ? i : free_slot;
+        }
+        else if (pi_proc_token_equals(begin, end, g_net_dev.slots[i].name)) {
+            return i;
+        }
+    }
+
+    if (!claim || free_slot < 0 || end - begin >= net_dev_name_length) {
+        return -1;
+    }
+
+    pi_net_slot_t *slot = &g_net_dev.slots[free_slot];
+    memory_clear(slot, sizeof(pi_net_slot_t));
+    memcpy(slot->name, begin, (size_t) (end - begin));
+    slot->used = true;
+
+    return free_slot;
+}
+
+int pi_net_dev_bind(const char *name) {
+    pthread_mutex_lock(&g_net_dev.lock);
+
+    int slot = pi_net_dev_find_slot(name, name + strlen(name), true);
+
+    if (slot >= 0) {
+        g_net_dev.slots[slot].bound = true;
+    }
+
+    pthread_mutex_unlock(&g_net_dev.lock);
+
+    return slot;
+}
+
+// Returns the interface name of a line, leading blanks skipped.
+//
+static const char *pi_net_dev_line_name(const pi_proc_line_t *line) {
+    const char *begin = line->begin;
+
+    while (begin < line->colon && *begin == ' ') {
+        begin++;
+    }
+
+    return begin;
+}
+
+// True while every line still names the interface it named when the map was built.  Call with
+// the lock held.
+//
+bool pi_net_dev_map_current(pi_proc_file_ptr file) {
+    pi_proc_line_t line;
+    unsigned int index = 0;
+
+    while (pi_proc_file_next_line(file, &line)) {
+        if (NULL == line.colon) {
+            continue;
+        }
+
+        int slot = index < g_net_dev.line_count ? g_net_dev.line_slots[index] : -1;
+
+        if (index >= g_net_dev.line_count
+            || (slot >= 0 && !pi_proc_token_equals(pi_net_dev_line_name(&line), line.colon, g_net_dev.slots[slot].name))) {
+            return false;
+        }
+
+        index++;
+    }
+
+    return index == g_net_dev.line_count;
+}
+
+// Gives every line a slot, frees the slots of interfaces that went away unless a template
+// named them, and starts those over from zero.  Call with the lock held.
+//
+void pi_net_dev_build_map(pi_proc_file_ptr file) {
+    bool seen[net_dev_max_interfaces];
+    memory_clear(seen, sizeof(seen));
+
+    pi_proc_line_t line;
+    g_net_dev.line_count = 0;
+
+    while (pi_proc_file_next_line(file, &line) && g_net_dev.line_count < net_dev_max_interfaces) {
+        if (NULL == line.colon) {
+            continue;
+        }
+
+        int slot = pi_net_dev_find_slot(pi_net_dev_line_name(&line), line.colon, true);
+
+        if (slot >= 0) {
+            seen[slot] = true;
+        }
+
+        g_net_dev.line_slots[g_net_dev.line_count++] = slot;
+    }
+
+    for (int i = 0; i < net_dev_max_interfaces; i++) {
+        if (!seen[i]) {
+            g_net_dev.slots[i].counted = false;
+            g_net_dev.slots[i].used = g_net_dev.slots[i].used && g_net_dev.slots[i].bound;
+        }
+    }
+
+    DEBUG_LOG("Tracking %u network interfaces", g_net_dev.line_count);
+}
+
+void pi_net_dev_sample(void __unused *context) {
+    if (!pi_proc_file_read(g_net_dev.file)) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_net_dev.lock);
+
+    if (!pi_net_dev_map_current(g_net_dev.file)) {
+        g_net_dev.file->cursor = g_net_dev.file->buffer;
+        pi_net_dev_build_map(g_net_dev.file);
+    }
+
+    g_net_dev.file->cursor = g_net_dev.file->buffer;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    double seconds = 0;
+    if (g_net_dev.sampled.tv_sec || g_net_dev.sampled.tv_nsec) {
+        seconds = (double) (now.tv_sec - g_net_dev.sampled.tv_sec)
+                  + (double) (now.tv_nsec - g_net_dev.sampled.tv_nsec) / 1000000000.0;
+    }
+    g_net_dev.sampled = now;
+
+    pi_net_dev_t sample;
+    memory_clear(&sample, sizeof(sample));
+
+    pi_proc_line_t line;
+    unsigned int index = 0;
+
+    while (pi_proc_file_next_line(g_net_dev.file, &line) && index < g_net_dev.line_count) {
+        if (NULL == line.colon) {
+            continue;
+        }
+
+        int slot_index = g_net_dev.line_slots[index++];
+
+        if (slot_index < 0) {
+            continue;
+        }
+
+        unsigned long long columns[net_dev_column_count];
+        const char *ptr = line.colon + 1;
+
+        for (int i = 0; i < net_dev_column_count; i++) {
+            ptr = pi_proc_parse_u64(ptr, line.end, &columns[i]);
+        }
+
+        // Metrics alternate receive and transmit: bytes, packets, errors, drops.
+        //
+        unsigned long long counters[net_dev_metric_count];
+        for (int i = 0; i < net_dev_metric_count; i++) {
+            counters[i] = columns[(i / 2) + (i % 2 ? net_dev_tx_column : 0)];
+        }
+
+        pi_net_slot_t *slot = &g_net_dev.slots[slot_index];
+        pi_net_interface_t *interface = &sample.interfaces[slot_index];
+
+        memcpy(interface->name, slot->name, sizeof(interface->name));
+        interface->present = true;
+
+        for (int i = 0; i < net_dev_metric_count; i++) {
+            if (slot->counted && seconds > 0 && counters[i] >= slot->counters[i]) {
+                interface->values[i] = (double) (counters[i] - slot->counters[i]) / seconds;
+            }
+
+            slot->counters[i] = counters[i];
+        }
+
+        slot->counted = true;
+    }
+
+    // Named interfaces that are down still report their name.
+    //
+    for (int i = 0; i < net_dev_max_interfaces; i++) {
+        if (!sample.interfaces[i].present && g_net_dev.slots[i].used) {
+            memcpy(sample.interfaces[i].name, g_net_dev.slots[i].name, sizeof(sample.interfaces[i].name));
+        }
+    }
+
+    pthread_mutex_unlock(&g_net_dev.lock);
+
+    pi_seqlock_write(&g_net_dev.published_lock, &g_net_dev.published, &sample, sizeof(sample));
+}
+
+bool pi_net_dev_start() {
+    g_net_dev.file = pi_proc_file_new(pi_net_dev_get_file_name());
+
+    if (NULL == g_net_dev.file) {
+        return false;
+    }
+
+    g_net_dev.sampler = pi_sampler_start("net", pi_net_dev_sample, NULL);
+
+    return NULL != g_net_dev.sampler;
+}
+
+void pi_net_dev_stop() {
+    pi_sampler_stop(g_net_dev.sampler);
+    g_net_dev.sampler = NULL;
+
+    pi_proc_file_delete(g_net_dev.file);
+    g_net_dev.file = NULL;
+}
+
+void pi_net_dev_get(pi_net_dev_ptr net_dev) {
+    pi_seqlock_read(&g_net_dev.published_lock, net_dev, &g_net_dev.published, sizeof(pi_net_dev_t));
+}
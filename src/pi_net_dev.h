@@ -0,0 +1,90 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#ifndef PI_NET_DEV_H
+#define PI_NET_DEV_H
+
+#include <stdbool.h>
+
+// Most interfaces that are tracked at once.
+//
+#define net_dev_max_interfaces 32
+
+#define net_dev_name_length 16
+
+// Rates per second between the last two samples.
+//
+typedef enum {
+    net_dev_rx_bytes,
+    net_dev_tx_bytes,
+    net_dev_rx_packets,
+    net_dev_tx_packets,
+    net_dev_rx_errors,
+    net_dev_tx_errors,
+    net_dev_rx_drops,
+    net_dev_tx_drops,
+    net_dev_metric_count
+} net_dev_metric_t;
+
+typedef struct pi_net_interface_struct {
+    char name[net_dev_name_length];
+
+    // False for a slot that is free or whose interface went away.
+    //
+    bool present;
+    double values[net_dev_metric_count];
+} pi_net_interface_t;
+
+// Interfaces keep their slot for as long as they exist, or for good once a template names them.
+//
+typedef struct pi_net_dev_struct {
+    pi_net_interface_t interfaces[net_dev_max_interfaces];
+} pi_net_dev_t;
+
+typedef pi_net_dev_t *pi_net_dev_ptr;
+
+// Starts sampling /proc/net/dev every get_sample_interval() milliseconds.
+//
+bool pi_net_dev_start();
+
+void pi_net_dev_stop();
+
+// Copies the latest sample, never touches the file system and never waits for the sampler.
+//
+void pi_net_dev_get(pi_net_dev_ptr net_dev);
+
+// Returns the slot of interface name, taking a free one if the interface has not been seen, or
+// -1 when all slots are taken.  The slot is kept even while the interface is down.
+//
+int pi_net_dev_bind(const char *name);
+
+// Returns the metric called name ("rx_bytes_per_sec") or -1.
+//
+int pi_net_dev_metric(const char *name);
+
+const char *pi_net_dev_metric_name(net_dev_metric_t metric);
+
+#endif //PI_NET_DEV_H
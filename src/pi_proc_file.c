@@ -0,0 +1,206 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#define _GNU_SOURCE
+
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "pi_proc_file.h"
+#include "pi_utils.h"
+
+#define proc_file_initial_size 4096
+
+pi_proc_file_ptr pi_proc_file_new(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        ERROR_LOG("Unable to open %s", path);
+        return NULL;
+    }
+
+    pi_proc_file_ptr file = memory_alloc(sizeof(pi_proc_file_t));
+    file->path = strdup(path);
+    file->fd = fd;
+    file->size = proc_file_initial_size;
+    file->buffer = memory_alloc(file->size);
+    file->cursor = file->buffer;
+
+    return file;
+}
+
+void pi_proc_file_delete(pi_proc_file_ptr file) {
+    if (file) {
+        close(file->fd);
+        memory_free(file->buffer);
+        memory_free(file->path);
+        memory_free(file);
+    }
+}
+
+bool pi_proc_file_read(pi_proc_file_ptr file) {
+    size_t length = 0;
+
+    for (;;) {
+        ssize_t n = pread(file->fd, file->buffer + length, file->size - 1 - length, (off_t) length);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (n < 0) {
+            if (!file->failing) {
+                ERROR_LOG("Unable to read %s (errno: %d)", file->path, errno);
+                file->failing = true;
+            }
+            file->length = 0;
+            file->buffer[0] = '\0';
+            file->cursor = file->buffer;
+            return false;
+        }
+
+        length += n;
+
+        // /proc hands out as much as fits, a short read is the end of the file.
+        //
+        if (length < file->size - 1) {
+            break;
+        }
+
+        file->size *= 2;
+        file->buffer = memory_realloc(file->buffer, file->size);
+    }
+
+    if (file->failing) {
+        INFO_LOG("Reading %s again", file->path);
+        file->failing = false;
+    }
+
+    file->buffer[length] = '\0';
+    file->length = length;
+    file->cursor = file->buffer;
+
+    return true;
+}
+
+bool pi_proc_file_next_line(pi_proc_file_ptr file, pi_proc_line_ptr line) {
+    const char *end = file->buffer + file->length;
+
+    if (file->cursor >= end) {
+        return false;
+    }
+
+    line->begin = file->cursor;
+    line->end = pi_proc_scan(line->begin, end, ':', '\n');
+    line->colon = NULL;
+
+    if (line->end < end && *line->end == ':') {
+        line->colon = line->end;
+        line->end = pi_proc_scan(line->colon, end, '\n', '\n');
+    }
+
+    file->cursor = line->end < end ? line->end + 1 : end;
+
+    return true;
+}
+
+const char *pi_proc_scan(const char *begin, const char *end, char a, char b) {
+    const char *ptr = begin;
+
+#if defined(__SSE2__)
+    const __m128i match_a = _mm_set1_epi8(a);
+    const __m128i match_b = _mm_set1_epi8(b);
+
+    for (; ptr + 16 <= end; ptr += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) ptr);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, match_a), _mm_cmpeq_epi8(chunk, match_b)));
+
+        if (mask) {
+            return ptr + __builtin_ctz((unsigned int) mask);
+        }
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const uint8x16_t match_a = vdupq_n_u8((uint8_t) a);
+    const uint8x16_t match_b = vdupq_n_u8((uint8_t) b);
+
+    for (; ptr + 16 <= end; ptr += 16) {
+        uint8x16_t chunk = vld1q_u8((const uint8_t *) ptr);
+        uint8x16_t hits = vorrq_u8(vceqq_u8(chunk, match_a), vceqq_u8(chunk, match_b));
+
+        // Any hit in the 16 bytes?  Narrow to 64 bits first, then find the byte in scalar.
+        //
+        uint64x2_t wide = vreinterpretq_u64_u8(hits);
+        if (vgetq_lane_u64(wide, 0) | vgetq_lane_u64(wide, 1)) {
+            break;
+        }
+    }
+#endif
+
+    return pi_proc_scan_scalar(ptr, end, a, b);
+}
+
+const char *pi_proc_scan_scalar(const char *begin, const char *end, char a, char b) {
+    for (const char *ptr = begin; ptr < end; ptr++) {
+        if (*ptr == a || *ptr == b) {
+            return ptr;
+        }
+    }
+
+    return end;
+}
+
+const char *pi_proc_parse_u64(const char *begin, const char *end, unsigned long long *value) {
+    const char *ptr = begin;
+
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t')) {
+        ptr++;
+    }
+
+    unsigned long long result = 0;
+
+    while (ptr < end && (unsigned char) (*ptr - '0') < 10) {
+        result = result * 10 + (unsigned long long) (*ptr - '0');
+        ptr++;
+    }
+
+    *value = result;
+
+    return ptr;
+}
+
+bool pi_proc_token_equals(const char *begin, const char *end, const char *token) {
+    size_t length = (size_t) (end - begin);
+
+    return strncmp(begin, token, length) == 0 && token[length] == '\0';
+}
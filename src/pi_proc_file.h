@@ -0,0 +1,97 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#ifndef PI_PROC_FILE_H
+#define PI_PROC_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// A /proc (or /sys) file kept open and reread from offset 0 into a buffer that is reused
+// between reads, so a sample costs one pread instead of open, stdio buffering and close.
+//
+typedef struct pi_proc_file_struct {
+    char *path;
+    int fd;
+
+    // Null terminated contents of the last read.
+    //
+    char *buffer;
+    size_t size;
+    size_t length;
+
+    // Where pi_proc_file_next_line() continues.
+    //
+    const char *cursor;
+
+    // The last read failed, a file that keeps failing is only logged when it starts.
+    //
+    bool failing;
+} pi_proc_file_t;
+
+typedef pi_proc_file_t *pi_proc_file_ptr;
+
+// One line of the buffer, end points at the '\n' (or the end of the buffer).  colon is the
+// first ':' on the line or NULL.
+//
+typedef struct pi_proc_line_struct {
+    const char *begin;
+    const char *end;
+    const char *colon;
+} pi_proc_line_t;
+
+typedef pi_proc_line_t *pi_proc_line_ptr;
+
+// Returns NULL if path cannot be opened.
+//
+pi_proc_file_ptr pi_proc_file_new(const char *path);
+
+void pi_proc_file_delete(pi_proc_file_ptr file);
+
+// Rereads the whole file, growing the buffer if it did not fit, and rewinds the line cursor.
+// An error is logged when the file starts failing, not on every failed read.
+//
+bool pi_proc_file_read(pi_proc_file_ptr file);
+
+bool pi_proc_file_next_line(pi_proc_file_ptr file, pi_proc_line_ptr line);
+
+// Returns the first of a or b in [begin, end) or end.  Uses SSE2 or NEON when the target has it.
+//
+const char *pi_proc_scan(const char *begin, const char *end, char a, char b);
+
+// The byte at a time loop pi_proc_scan() finishes with, exposed so proc_bench can compare them.
+//
+const char *pi_proc_scan_scalar(const char *begin, const char *end, char a, char b);
+
+// Skips blanks and parses an unsigned decimal number, returns where the number ended.
+//
+const char *pi_proc_parse_u64(const char *begin, const char *end, unsigned long long *value);
+
+// Compares [begin, end) with a C string.
+//
+bool pi_proc_token_equals(const char *begin, const char *end, const char *token);
+
+#endif //PI_PROC_FILE_H
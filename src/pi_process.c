@@ -24,32 +24,553 @@
 //
 **********************************************************************/
 
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
 #include <stdio.h>
-#include <memory.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+
 #include "pi_process.h"
+#include "pi_chart_settings.h"
+#include "pi_sampler.h"
 #include "pi_utils.h"
 
-bool pi_process_exist(bool *value, const char *symbol) {
-    *value = false;
+#ifndef __unused
+#define __unused
+#endif
+
+#define process_bucket_count 1024
+
+typedef struct pi_process_entry_struct {
+    pid_t pid;
+    char name[process_name_length];
+
+    // Refresh that last saw the PID in /proc.
+    //
+    unsigned int generation;
+
+    // Set once the name has been read on two refreshes, see pi_process_refresh().
+    //
+    bool settled;
+
+    struct pi_process_entry_struct *next_by_pid;
+    struct pi_process_entry_struct *next_by_name;
+} pi_process_entry_t;
+
+typedef pi_process_entry_t *pi_process_entry_ptr;
+
+// Every process is on two hash chains, one by PID for the refresh and one by name for lookups.
+// Only one thread changes the table, either the sampler or the process event listener, lookups
+// take the read lock.
+//
+typedef struct pi_process_table_struct {
+    pthread_rwlock_t lock;
+    pi_process_entry_ptr by_pid[process_bucket_count];
+    pi_process_entry_ptr by_name[process_bucket_count];
+    unsigned int count;
+    unsigned int generation;
+
+    DIR *proc_directory;
+    pi_sampler_ptr sampler;
+
+    // Netlink process connector socket, -1 when the table is kept current by scanning.
+    //
+    int events_fd;
+    pthread_t listener_thread_id;
+    bool listener_running;
+} pi_process_table_t;
+
+pi_process_table_t g_process_table = {
+        .lock = PTHREAD_RWLOCK_INITIALIZER,
+        .events_fd = -1,
+};
+
+static unsigned long pi_process_name_hash(const char *name) {
+    unsigned long hash = 5381;
+
+    for (int i = 0; i < process_name_length - 1 && name[i]; i++) {
+        hash = ((hash << 5) + hash) + (unsigned char) name[i];
+    }
+
+    return hash % process_bucket_count;
+}
+
+static unsigned long pi_process_pid_hash(pid_t pid) {
+    return (unsigned long) pid % process_bucket_count;
+}
+
+static bool pi_process_name_equals(const char *entry_name, const char *name) {
+    return 0 == strncmp(entry_name, name, process_name_length - 1);
+}
+
+pi_process_entry_ptr pi_process_find_pid(pid_t pid) {
+    pi_process_entry_ptr entry = g_process_table.by_pid[pi_process_pid_hash(pid)];
+
+    while (entry && entry->pid != pid) {
+        entry = entry->next_by_pid;
+    }
+
+    return entry;
+}
+
+// Reads /proc/[pid]/comm relative to the open /proc directory, false if the process is gone.
+//
+bool pi_process_read_name(pid_t pid, char *name) {
+    char path[32];
+    snprintf(path, sizeof(path), "%d/comm", (int) pid);
+
+    int fd = openat(dirfd(g_process_table.proc_directory), path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    ssize_t length = 0;
+    do {
+        length = read(fd, name, process_name_length);
+    } while (length < 0 && errno == EINTR);
+
+    close(fd);
+
+    if (length <= 0) {
+        return false;
+    }
+
+    if (length > process_name_length - 1) {
+        length = process_name_length - 1;
+    }
+
+    if (name[length - 1] == '\n') {
+        length--;
+    }
+
+    name[length] = '\0';
+
+    return true;
+}
+
+void pi_process_unlink_name(pi_process_entry_ptr entry) {
+    pi_process_entry_ptr *link = &g_process_table.by_name[pi_process_name_hash(entry->name)];
+
+    while (*link && *link != entry) {
+        link = &(*link)->next_by_name;
+    }
+
+    if (*link) {
+        *link = entry->next_by_name;
+    }
+}
+
+void pi_process_link_name(pi_process_entry_ptr entry) {
+    pi_process_entry_ptr *bucket = &g_process_table.by_name[pi_process_name_hash(entry->name)];
+
+    entry->next_by_name = *bucket;
+    *bucket = entry;
+}
+
+void pi_process_add(pid_t pid, const char *name) {
+    pi_process_entry_ptr entry = memory_alloc(sizeof(pi_process_entry_t));
+    entry->pid = pid;
+    entry->generation = g_process_table.generation;
+    strncpy(entry->name, name, process_name_length - 1);
+
+    pi_process_entry_ptr *bucket = &g_process_table.by_pid[pi_process_pid_hash(pid)];
+
+    pthread_rwlock_wrlock(&g_process_table.lock);
+
+    entry->next_by_pid = *bucket;
+    *bucket = entry;
+    pi_process_link_name(entry);
+    g_process_table.count++;
+
+    pthread_rwlock_unlock(&g_process_table.lock);
+}
+
+void pi_process_rename(pi_process_entry_ptr entry, const char *name) {
+    pthread_rwlock_wrlock(&g_process_table.lock);
+
+    pi_process_unlink_name(entry);
+    strncpy(entry->name, name, process_name_length - 1);
+    pi_process_link_name(entry);
+
+    pthread_rwlock_unlock(&g_process_table.lock);
+}
+
+void pi_process_remove(pid_t pid) {
+    pi_process_entry_ptr *link = &g_process_table.by_pid[pi_process_pid_hash(pid)];
+
+    while (*link && (*link)->pid != pid) {
+        link = &(*link)->next_by_pid;
+    }
+
+    pi_process_entry_ptr entry = *link;
+
+    if (NULL == entry) {
+        return;
+    }
+
+    pthread_rwlock_wrlock(&g_process_table.lock);
+
+    *link = entry->next_by_pid;
+    pi_process_unlink_name(entry);
+    g_process_table.count--;
+
+    pthread_rwlock_unlock(&g_process_table.lock);
+
+    memory_free(entry);
+}
+
+// Drops every process the last refresh did not see.
+//
+void pi_process_sweep() {
+    pi_process_entry_ptr vanished = NULL;
+
+    pthread_rwlock_wrlock(&g_process_table.lock);
+
+    for (int i = 0; i < process_bucket_count; i++) {
+        pi_process_entry_ptr *link = &g_process_table.by_pid[i];
+
+        while (*link) {
+            pi_process_entry_ptr entry = *link;
+
+            if (entry->generation == g_process_table.generation) {
+                link = &entry->next_by_pid;
+                continue;
+            }
+
+            *link = entry->next_by_pid;
+            pi_process_unlink_name(entry);
+            g_process_table.count--;
+
+            entry->next_by_pid = vanished;
+            vanished = entry;
+        }
+    }
+
+    pthread_rwlock_unlock(&g_process_table.lock);
+
+    while (vanished) {
+        pi_process_entry_ptr entry = vanished;
+        vanished = entry->next_by_pid;
+        memory_free(entry);
+    }
+}
+
+// Lists /proc and only reads comm for PIDs that are new.  A process is read once more on the
+// refresh after it first shows up, which catches the usual fork followed by exec.
+//
+void pi_process_refresh(void __unused *context) {
+    g_process_table.generation++;
+
+    rewinddir(g_process_table.proc_directory);
+
+    struct dirent *directory_entry = NULL;
+    while (NULL != (directory_entry = readdir(g_process_table.proc_directory))) {
+        const char *ptr = directory_entry->d_name;
+        pid_t pid = 0;
+
+        while ((unsigned char) (*ptr - '0') < 10) {
+            pid = pid * 10 + (*ptr - '0');
+            ptr++;
+        }
+
+        if (*ptr != '\0' || pid <= 0) {
+            continue;
+        }
+
+        char name[process_name_length];
+        pi_process_entry_ptr entry = pi_process_find_pid(pid);
+
+        if (entry) {
+            entry->generation = g_process_table.generation;
+
+            if (!entry->settled) {
+                entry->settled = true;
+
+                if (pi_process_read_name(pid, name) && !pi_process_name_equals(entry->name, name)) {
+                    pi_process_rename(entry, name);
+                }
+            }
+        }
+        else if (pi_process_read_name(pid, name)) {
+            pi_process_add(pid, name);
+        }
+    }
+
+    pi_process_sweep();
+}
 
-    FILE *output = popen("ps -ax | awk '{ print $4 }' | awk -F\"/\" '{ print $NF }'", "r");
+// Reads the name again for a new program or a new process, both are thread group leaders.
+//
+void pi_process_update(pid_t pid) {
+    char name[process_name_length];
+
+    if (!pi_process_read_name(pid, name)) {
+        return;
+    }
+
+    pi_process_entry_ptr entry = pi_process_find_pid(pid);
+
+    if (NULL == entry) {
+        pi_process_add(pid, name);
+    }
+    else if (!pi_process_name_equals(entry->name, name)) {
+        pi_process_rename(entry, name);
+    }
+}
+
+void pi_process_handle_event(const struct proc_event *event) {
+    switch (event->what) {
+        case PROC_EVENT_FORK:
+            if (event->event_data.fork.child_pid == event->event_data.fork.child_tgid) {
+                pi_process_update(event->event_data.fork.child_pid);
+            }
+            break;
+
+        case PROC_EVENT_EXEC:
+            if (event->event_data.exec.process_pid == event->event_data.exec.process_tgid) {
+                pi_process_update(event->event_data.exec.process_pid);
+            }
+            break;
+
+        case PROC_EVENT_COMM:
+            if (event->event_data.comm.process_pid == event->event_data.comm.process_tgid) {
+                pi_process_update(event->event_data.comm.process_pid);
+            }
+            break;
 
-    if (!output) {
+        case PROC_EVENT_EXIT:
+            if (event->event_data.exit.process_pid == event->event_data.exit.process_tgid) {
+                pi_process_remove(event->event_data.exit.process_pid);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+// Subscribes to the process connector, this needs CAP_NET_ADMIN.
+//
+bool pi_process_connect() {
+    int fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+
+    if (fd < 0) {
         return false;
     }
 
-    char buffer[1024];
-    memory_clear(buffer, sizeof(buffer));
+    struct sockaddr_nl address;
+    memory_clear(&address, sizeof(address));
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = CN_IDX_PROC;
+
+    struct __attribute__ ((aligned(NLMSG_ALIGNTO))) {
+        struct nlmsghdr header;
+        struct __attribute__ ((__packed__)) {
+            struct cn_msg message;
+            enum proc_cn_mcast_op operation;
+        } body;
+    } request;
+
+    memory_clear(&request, sizeof(request));
+    request.header.nlmsg_len = sizeof(request);
+    request.header.nlmsg_type = NLMSG_DONE;
+    request.header.nlmsg_pid = (__u32) getpid();
+    request.body.message.id.idx = CN_IDX_PROC;
+    request.body.message.id.val = CN_VAL_PROC;
+    request.body.message.len = sizeof(enum proc_cn_mcast_op);
+    request.body.operation = PROC_CN_MCAST_LISTEN;
+
+    if (bind(fd, (struct sockaddr *) &address, sizeof(address)) < 0
+        || send(fd, &request, sizeof(request), 0) < 0) {
+        close(fd);
+        return false;
+    }
 
-    while (NULL != fgets(buffer, sizeof(buffer), output)){
-        if (strcmp(buffer, symbol)){
-            *value = true;
+    g_process_table.events_fd = fd;
+
+    return true;
+}
+
+// Returns false when the socket broke and the table has to go back to scanning.
+//
+bool pi_process_receive_events() {
+    char buffer[8192] __attribute__ ((aligned(NLMSG_ALIGNTO)));
+
+    ssize_t length = recv(g_process_table.events_fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+
+    if (length < 0) {
+        if (errno == EINTR || errno == EAGAIN) {
+            return true;
+        }
+
+        if (errno == ENOBUFS) {
+            // The kernel dropped events, a scan puts the table right again.
+            //
+            DEBUG_LOG("Process events overflowed, rescanning /proc");
+            pi_process_refresh(NULL);
+            return true;
+        }
+
+        ERROR_LOG("Process events failed (errno: %d)", errno);
+        return false;
+    }
+
+    size_t remaining = (size_t) length;
+    for (struct nlmsghdr *header = (struct nlmsghdr *) buffer; NLMSG_OK(header, remaining);
+         header = NLMSG_NEXT(header, remaining)) {
+        if (header->nlmsg_type == NLMSG_NOOP || header->nlmsg_type == NLMSG_ERROR) {
+            continue;
+        }
+
+        const struct cn_msg *message = NLMSG_DATA(header);
+
+        if (message->id.idx == CN_IDX_PROC && message->id.val == CN_VAL_PROC) {
+            pi_process_handle_event((const struct proc_event *) message->data);
+        }
+    }
+
+    return true;
+}
+
+void *pi_process_listener_thread(void __unused *arg) {
+    while (g_process_table.listener_running) {
+        struct pollfd poll_fd = {g_process_table.events_fd, POLLIN, 0};
+        if (poll(&poll_fd, 1, 1000) <= 0) {
+            continue;
+        }
+
+        if (!pi_process_receive_events()) {
+            close(g_process_table.events_fd);
+            g_process_table.events_fd = -1;
+            g_process_table.sampler = pi_sampler_start("process", pi_process_refresh, NULL);
             break;
         }
-        memory_clear(buffer, sizeof(buffer));
     }
 
-    pclose(output);
+    return NULL;
+}
+
+bool pi_process_start() {
+    g_process_table.proc_directory = opendir("/proc");
+
+    if (NULL == g_process_table.proc_directory) {
+        ERROR_LOG("Unable to open /proc, process symbols are not available");
+        return false;
+    }
+
+    // Subscribe before the first scan so nothing that starts in between is missed.
+    //
+    if (get_process_events() && pi_process_connect()) {
+        pi_process_refresh(NULL);
+
+        g_process_table.listener_running = true;
+        if (pthread_create(&g_process_table.listener_thread_id, NULL, &pi_process_listener_thread, NULL) == 0) {
+            INFO_LOG("Tracking %u processes with process events", g_process_table.count);
+            return true;
+        }
+
+        g_process_table.listener_running = false;
+        close(g_process_table.events_fd);
+        g_process_table.events_fd = -1;
+    }
+    else if (get_process_events()) {
+        INFO_LOG("Process events are not available (errno: %d), scanning /proc instead", errno);
+    }
+
+    g_process_table.sampler = pi_sampler_start("process", pi_process_refresh, NULL);
+
+    if (NULL == g_process_table.sampler) {
+        closedir(g_process_table.proc_directory);
+        g_process_table.proc_directory = NULL;
+        return false;
+    }
+
+    DEBUG_LOG("Process table holds %u processes", g_process_table.count);
+
+    return true;
+}
+
+void pi_process_stop() {
+    if (g_process_table.listener_running) {
+        g_process_table.listener_running = false;
+        pthread_join(g_process_table.listener_thread_id, NULL);
+    }
+
+    if (g_process_table.events_fd >= 0) {
+        close(g_process_table.events_fd);
+        g_process_table.events_fd = -1;
+    }
+
+    pi_sampler_stop(g_process_table.sampler);
+    g_process_table.sampler = NULL;
+
+    // Nothing is current any more, the sweep releases the whole table.
+    //
+    g_process_table.generation++;
+    pi_process_sweep();
+
+    if (g_process_table.proc_directory) {
+        closedir(g_process_table.proc_directory);
+        g_process_table.proc_directory = NULL;
+    }
+}
+
+pid_t pi_process_find(const char *name) {
+    pid_t pid = 0;
+
+    pthread_rwlock_rdlock(&g_process_table.lock);
+
+    pi_process_entry_ptr entry = g_process_table.by_name[pi_process_name_hash(name)];
+
+    while (entry && !pi_process_name_equals(entry->name, name)) {
+        entry = entry->next_by_name;
+    }
+
+    if (entry) {
+        pid = entry->pid;
+    }
+
+    pthread_rwlock_unlock(&g_process_table.lock);
+
+    return pid;
+}
+
+unsigned int pi_process_list(pid_t *pids, unsigned int size) {
+    unsigned int count = 0;
+
+    pthread_rwlock_rdlock(&g_process_table.lock);
+
+    for (int i = 0; i < process_bucket_count && count < size; i++) {
+        for (pi_process_entry_ptr entry = g_process_table.by_pid[i]; entry && count < size; entry = entry->next_by_pid) {
+            pids[count++] = entry->pid;
+        }
+    }
+
+    unsigned int total = g_process_table.count;
+
+    pthread_rwlock_unlock(&g_process_table.lock);
+
+    return total;
+}
+
+bool pi_process_exist(bool *value, const char *symbol) {
+    *value = false;
+
+    if (NULL == g_process_table.proc_directory) {
+        return false;
+    }
+
+    *value = 0 != pi_process_find(symbol);
 
     return true;
-}
\ No newline at end of file
+}
@@ -28,7 +28,34 @@
 #define PI_CHART_PI_PROCESS_H
 
 #include <stdbool.h>
+#include <sys/types.h>
 
+// The kernel keeps 15 characters of a process name in comm.
+//
+#define process_name_length 16
+
+// Builds the process table from /proc and keeps it current.  With get_process_events() the
+// table follows fork, exec and exit events from the netlink process connector.  Without them,
+// or without CAP_NET_ADMIN, a sampler thread rescans instead: each refresh lists /proc but only
+// reads /proc/[pid]/comm for PIDs it has not seen before, vanished PIDs are dropped.
+//
+bool pi_process_start();
+
+void pi_process_stop();
+
+// Returns the PID of a running process called name or 0.  A hash lookup, it never touches /proc.
+// Names longer than the kernel keeps in comm (15 characters) match on their first 15.
+//
+pid_t pi_process_find(const char *name);
+
+// Copies up to size PIDs of running processes into pids and returns how many there are, which
+// may be more than size.
+//
+unsigned int pi_process_list(pid_t *pids, unsigned int size);
+
+// Sets value to true if a process called symbol is running, returns false if there is no
+// process table to ask.
+//
 bool pi_process_exist(bool *value, const char *symbol);
 
 #endif //PI_CHART_PI_PROCESS_H
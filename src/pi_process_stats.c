@@ -0,0 +1,383 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pi_process_stats.h"
+#include "pi_chart_settings.h"
+#include "pi_sampler.h"
+#include "pi_seqlock.h"
+#include "pi_utils.h"
+
+#ifndef __unused
+#define __unused
+#endif
+
+static const char *process_metric_names[process_metric_count] = {
+        "running",
+        "pid",
+        "cpu",
+        "rss",
+        "vsize",
+        "threads",
+        "read_bytes_per_sec",
+        "write_bytes_per_sec",
+};
+
+// A watched process and the files it is sampled from, these stay open while the PID lives.
+//
+typedef struct pi_process_watched_struct {
+    char name[process_name_length];
+    pid_t pid;
+
+    pi_proc_file_ptr stat;
+    pi_proc_file_ptr statm;
+    pi_proc_file_ptr io;
+
+    // Counters of the previous sample, sampled is zero until there is one.
+    //
+    pi_process_counters_t counters;
+    struct timespec sampled;
+} pi_process_watched_t;
+
+typedef pi_process_watched_t *pi_process_watched_ptr;
+
+// The lock guards the names and the count, everything else belongs to the sampler thread.
+//
+typedef struct pi_process_stats_struct {
+    pthread_mutex_t lock;
+    pi_process_watched_t watched[process_watch_max];
+    unsigned int count;
+
+    long ticks_per_second;
+    unsigned long long page_kb;
+
+    pi_sampler_ptr sampler;
+    pi_seqlock_t published_lock;
+    pi_process_watch_t published;
+} pi_process_stats_t;
+
+pi_process_stats_t g_process_stats = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+// Skips one blank separated field.
+//
+static const char *pi_process_skip_field(const char *ptr, const char *end) {
+    while (ptr < end && *ptr == ' ') {
+        ptr++;
+    }
+
+    while (ptr < end && *ptr != ' ') {
+        ptr++;
+    }
+
+    return ptr;
+}
+
+bool pi_process_parse_stat(const char *begin, const char *end, pi_process_counters_ptr counters, char *name) {
+    // The name is in parentheses and may hold anything, fields are counted from the last ')'.
+    // Field 3 is the state, utime and stime are 14 and 15, num_threads is 20 and rss 24.
+    //
+    const char *open = memchr(begin, '(', (size_t) (end - begin));
+    const char *ptr = memrchr(begin, ')', (size_t) (end - begin));
+
+    if (NULL == open || NULL == ptr || ptr < open) {
+        return false;
+    }
+
+    if (name) {
+        size_t length = min((size_t) (ptr - open - 1), (size_t) process_name_length - 1);
+        memcpy(name, open + 1, length);
+        name[length] = '\0';
+    }
+
+    ptr++;
+
+    unsigned long long utime = 0;
+    unsigned long long stime = 0;
+
+    for (int field = 3; field <= 24 && ptr < end; field++) {
+        switch (field) {
+            case 14:
+                ptr = pi_proc_parse_u64(ptr, end, &utime);
+                break;
+
+            case 15:
+                ptr = pi_proc_parse_u64(ptr, end, &stime);
+                break;
+
+            case 20:
+                ptr = pi_proc_parse_u64(ptr, end, &counters->threads);
+                break;
+
+            case 24:
+                ptr = pi_proc_parse_u64(ptr, end, &counters->resident_pages);
+                break;
+
+            default:
+                ptr = pi_process_skip_field(ptr, end);
+                break;
+        }
+    }
+
+    counters->cpu_ticks = utime + stime;
+
+    return true;
+}
+
+bool pi_process_parse_statm(pi_proc_file_ptr file, pi_process_counters_ptr counters) {
+    const char *end = file->buffer + file->length;
+
+    const char *ptr = pi_proc_parse_u64(file->buffer, end, &counters->size_pages);
+    pi_proc_parse_u64(ptr, end, &counters->resident_pages);
+
+    return file->length > 0;
+}
+
+bool pi_process_parse_io(pi_proc_file_ptr file, pi_process_counters_ptr counters) {
+    pi_proc_line_t line;
+
+    while (pi_proc_file_next_line(file, &line)) {
+        if (NULL == line.colon) {
+            continue;
+        }
+
+        if (pi_proc_token_equals(line.begin, line.colon, "read_bytes")) {
+            pi_proc_parse_u64(line.colon + 1, line.end, &counters->read_bytes);
+        }
+        else if (pi_proc_token_equals(line.begin, line.colon, "write_bytes")) {
+            pi_proc_parse_u64(line.colon + 1, line.end, &counters->write_bytes);
+        }
+    }
+
+    return file->length > 0;
+}
+
+int pi_process_metric(const char *name) {
+    for (int i = 0; i < process_metric_count; i++) {
+        if (0 == strcmp(name, process_metric_names[i])) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+const char *pi_process_metric_name(process_metric_t metric) {
+    return metric < process_metric_count ? process_metric_names[metric] : "";
+}
+
+void pi_process_stats_detach(pi_process_watched_ptr watched) {
+    pi_proc_file_delete(watched->stat);
+    pi_proc_file_delete(watched->statm);
+    pi_proc_file_delete(watched->io);
+
+    watched->stat = NULL;
+    watched->statm = NULL;
+    watched->io = NULL;
+    watched->pid = 0;
+    memory_clear(&watched->counters, sizeof(watched->counters));
+    memory_clear(&watched->sampled, sizeof(watched->sampled));
+}
+
+// Opens the files of a new PID.  io is only readable for our own processes unless we are root,
+// the other metrics still work without it.
+//
+void pi_process_stats_attach(pi_process_watched_ptr watched, pid_t pid) {
+    pi_process_stats_detach(watched);
+
+    if (0 == pid) {
+        return;
+    }
+
+    char path[64];
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int) pid);
+    watched->stat = pi_proc_file_new(path);
+
+    snprintf(path, sizeof(path), "/proc/%d/statm", (int) pid);
+    watched->statm = pi_proc_file_new(path);
+
+    snprintf(path, sizeof(path), "/proc/%d/io", (int) pid);
+    watched->io = pi_proc_file_new(path);
+
+    watched->pid = pid;
+}
+
+void pi_process_stats_sample_one(pi_process_watched_ptr watched,
+                                 pi_process_metrics_t *metrics,
+                                 const struct timespec *now) {
+    pid_t pid = pi_process_find(watched->name);
+
+    if (pid != watched->pid) {
+        pi_process_stats_attach(watched, pid);
+    }
+
+    if (NULL == watched->stat || !pi_proc_file_read(watched->stat)) {
+        return;
+    }
+
+    pi_process_counters_t counters;
+    memory_clear(&counters, sizeof(counters));
+
+    pi_process_parse_stat(watched->stat->buffer, watched->stat->buffer + watched->stat->length, &counters, NULL);
+
+    if (watched->statm && pi_proc_file_read(watched->statm)) {
+        pi_process_parse_statm(watched->statm, &counters);
+    }
+
+    if (watched->io && pi_proc_file_read(watched->io)) {
+        pi_process_parse_io(watched->io, &counters);
+    }
+
+    double *values = metrics->values;
+    values[process_metric_running] = 1;
+    values[process_metric_pid] = pid;
+    values[process_metric_rss] = (double) (counters.resident_pages * g_process_stats.page_kb);
+    values[process_metric_vsize] = (double) (counters.size_pages * g_process_stats.page_kb);
+    values[process_metric_threads] = (double) counters.threads;
+
+    if (watched->sampled.tv_sec || watched->sampled.tv_nsec) {
+        double seconds = (double) (now->tv_sec - watched->sampled.tv_sec)
+                         + (double) (now->tv_nsec - watched->sampled.tv_nsec) / 1000000000.0;
+
+        if (seconds > 0) {
+            values[process_metric_cpu] = (double) (counters.cpu_ticks - watched->counters.cpu_ticks)
+                                         * 100.0 / (double) g_process_stats.ticks_per_second / seconds;
+            values[process_metric_read_rate] = (double) (counters.read_bytes - watched->counters.read_bytes) / seconds;
+            values[process_metric_write_rate] =
+                    (double) (counters.write_bytes - watched->counters.write_bytes) / seconds;
+        }
+    }
+
+    watched->counters = counters;
+    watched->sampled = *now;
+}
+
+void pi_process_stats_sample(void __unused *context) {
+    pi_process_watch_t sample;
+    memory_clear(&sample, sizeof(sample));
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    // Names are written before the count is raised and never change, so only the count needs
+    // the lock.
+    //
+    pthread_mutex_lock(&g_process_stats.lock);
+    unsigned int count = g_process_stats.count;
+    pthread_mutex_unlock(&g_process_stats.lock);
+
+    for (unsigned int i = 0; i < count; i++) {
+        strcpy(sample.processes[i].name, g_process_stats.watched[i].name);
+        pi_process_stats_sample_one(&g_process_stats.watched[i], &sample.processes[i], &now);
+    }
+
+    sample.count = count;
+
+    pi_seqlock_write(&g_process_stats.published_lock, &g_process_stats.published, &sample, sizeof(sample));
+}
+
+int pi_process_watch(const char *name) {
+    if (NULL == name || '\0' == *name) {
+        return -1;
+    }
+
+    int index = -1;
+
+    pthread_mutex_lock(&g_process_stats.lock);
+
+    for (unsigned int i = 0; i < g_process_stats.count; i++) {
+        if (0 == strncmp(g_process_stats.watched[i].name, name, process_name_length - 1)) {
+            index = (int) i;
+            break;
+        }
+    }
+
+    if (index < 0 && g_process_stats.count < process_watch_max) {
+        index = (int) g_process_stats.count;
+        strncpy(g_process_stats.watched[index].name, name, process_name_length - 1);
+        g_process_stats.count++;
+
+        DEBUG_LOG("Watching process %s", g_process_stats.watched[index].name);
+    }
+    else if (index < 0) {
+        ERROR_LOG("Already watching %d processes, not watching %s", process_watch_max, name);
+    }
+
+    pthread_mutex_unlock(&g_process_stats.lock);
+
+    return index;
+}
+
+bool pi_process_stats_start() {
+    g_process_stats.ticks_per_second = sysconf(_SC_CLK_TCK);
+    if (g_process_stats.ticks_per_second <= 0) {
+        g_process_stats.ticks_per_second = 100;
+    }
+
+    g_process_stats.page_kb = (unsigned long long) sysconf(_SC_PAGESIZE) / 1024;
+
+    const char *list = get_watch_list();
+
+    while (list && *list) {
+        const char *comma = strchr(list, ',');
+        size_t length = comma ? (size_t) (comma - list) : strlen(list);
+        char name[process_name_length];
+
+        if (length > 0) {
+            memory_clear(name, sizeof(name));
+            strncpy(name, list, min(length, sizeof(name) - 1));
+            pi_process_watch(name);
+        }
+
+        list = comma ? comma + 1 : NULL;
+    }
+
+    g_process_stats.sampler = pi_sampler_start("process stats", pi_process_stats_sample, NULL);
+
+    return NULL != g_process_stats.sampler;
+}
+
+void pi_process_stats_stop() {
+    pi_sampler_stop(g_process_stats.sampler);
+    g_process_stats.sampler = NULL;
+
+    for (unsigned int i = 0; i < g_process_stats.count; i++) {
+        pi_process_stats_detach(&g_process_stats.watched[i]);
+    }
+}
+
+void pi_process_watch_get(pi_process_watch_ptr watch) {
+    pi_seqlock_read(&g_process_stats.published_lock, watch, &g_process_stats.published, sizeof(pi_process_watch_t));
+}
@@ -0,0 +1,114 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#ifndef PI_PROCESS_STATS_H
+#define PI_PROCESS_STATS_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include "pi_proc_file.h"
+#include "pi_process.h"
+
+// Most processes that can be watched at once.
+//
+#define process_watch_max 32
+
+// Raw counters of one process, cumulative ones only mean something as deltas.
+//
+typedef struct pi_process_counters_struct {
+    unsigned long long cpu_ticks;
+    unsigned long long threads;
+    unsigned long long size_pages;
+    unsigned long long resident_pages;
+    unsigned long long read_bytes;
+    unsigned long long write_bytes;
+} pi_process_counters_t;
+
+typedef pi_process_counters_t *pi_process_counters_ptr;
+
+// What a watched process is sampled for.  running is answered by the process table when it is
+// asked for directly, the rest come from the watch sampler.
+//
+typedef enum {
+    process_metric_running,
+    process_metric_pid,
+    process_metric_cpu,
+    process_metric_rss,
+    process_metric_vsize,
+    process_metric_threads,
+    process_metric_read_rate,
+    process_metric_write_rate,
+    process_metric_count
+} process_metric_t;
+
+typedef struct pi_process_metrics_struct {
+    char name[process_name_length];
+
+    // cpu is a percentage of one core, rss and vsize are kB, the rates are bytes per second.
+    //
+    double values[process_metric_count];
+} pi_process_metrics_t;
+
+typedef struct pi_process_watch_struct {
+    unsigned int count;
+    pi_process_metrics_t processes[process_watch_max];
+} pi_process_watch_t;
+
+typedef pi_process_watch_t *pi_process_watch_ptr;
+
+// Parsers for /proc/[pid]/stat, statm and io, each fills in its part of counters.  stat also
+// gives resident_pages, name may be NULL or gets the name from the stat line.
+//
+bool pi_process_parse_stat(const char *begin, const char *end, pi_process_counters_ptr counters, char *name);
+
+bool pi_process_parse_statm(pi_proc_file_ptr file, pi_process_counters_ptr counters);
+
+bool pi_process_parse_io(pi_proc_file_ptr file, pi_process_counters_ptr counters);
+
+// Adds the comma separated get_watch_list() and starts sampling the watched processes every
+// get_sample_interval() milliseconds.  A sample reads three files per watched process, however
+// many processes are running.
+//
+bool pi_process_stats_start();
+
+void pi_process_stats_stop();
+
+// Adds name to the watch list unless it is there already, returns its index or -1 when the
+// list is full.  Templates add the processes they name when they are compiled.
+//
+int pi_process_watch(const char *name);
+
+// Copies the latest sample, never waits for the sampler.
+//
+void pi_process_watch_get(pi_process_watch_ptr watch);
+
+// Returns the metric called name ("cpu") or -1.
+//
+int pi_process_metric(const char *name);
+
+const char *pi_process_metric_name(process_metric_t metric);
+
+#endif //PI_PROCESS_STATS_H
@@ -0,0 +1,361 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#define _GNU_SOURCE
+
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include "pi_process_top.h"
+#include "pi_process_stats.h"
+#include "pi_sampler.h"
+#include "pi_seqlock.h"
+#include "pi_utils.h"
+
+#ifndef __unused
+#define __unused
+#endif
+
+#define process_top_bucket_count 1024
+
+static const char *process_top_key_names[process_top_key_count] = {
+        "cpu",
+        "rss",
+};
+
+// CPU time of a process at the previous tick, CPU% is the difference.
+//
+typedef struct pi_process_history_struct {
+    pid_t pid;
+    unsigned long long cpu_ticks;
+    unsigned int generation;
+    struct pi_process_history_struct *next;
+} pi_process_history_t;
+
+typedef pi_process_history_t *pi_process_history_ptr;
+
+typedef struct pi_process_heap_struct {
+    unsigned int count;
+    pi_process_top_entry_t entries[process_top_max];
+} pi_process_heap_t;
+
+// Everything but the published lists belongs to the sampler thread.
+//
+typedef struct pi_process_top_sampler_struct {
+    int proc_fd;
+    pid_t *pids;
+    unsigned int pid_size;
+
+    pi_process_history_ptr history[process_top_bucket_count];
+    unsigned int generation;
+    struct timespec sampled;
+
+    long ticks_per_second;
+    unsigned long long page_kb;
+
+    pi_sampler_ptr sampler;
+    pi_seqlock_t lock;
+    pi_process_top_t published[process_top_key_count];
+} pi_process_top_sampler_t;
+
+pi_process_top_sampler_t g_process_top = {
+        .proc_fd = -1,
+};
+
+static double pi_process_top_value(const pi_process_top_entry_t *entry, process_top_key_t key) {
+    return key == process_top_cpu ? entry->cpu : entry->rss;
+}
+
+static void pi_process_heap_swap(pi_process_heap_t *heap, unsigned int a, unsigned int b) {
+    pi_process_top_entry_t entry = heap->entries[a];
+    heap->entries[a] = heap->entries[b];
+    heap->entries[b] = entry;
+}
+
+static void pi_process_heap_sift_down(pi_process_heap_t *heap, process_top_key_t key, unsigned int index) {
+    for (;;) {
+        unsigned int smallest = index;
+        unsigned int left = 2 * index + 1;
+        unsigned int right = left + 1;
+
+        if (left < heap->count
+            && pi_process_top_value(&heap->entries[left], key) < pi_process_top_value(&heap->entries[smallest], key)) {
+            smallest = left;
+        }
+
+        if (right < heap->count
+            && pi_process_top_value(&heap->entries[right], key) < pi_process_top_value(&heap->entries[smallest], key)) {
+            smallest = right;
+        }
+
+        if (smallest == index) {
+            return;
+        }
+
+        pi_process_heap_swap(heap, index, smallest);
+        index = smallest;
+    }
+}
+
+// Keeps the process_top_max largest entries, the smallest of them at the root.
+//
+static void pi_process_heap_push(pi_process_heap_t *heap, process_top_key_t key, const pi_process_top_entry_t *entry) {
+    double value = pi_process_top_value(entry, key);
+
+    if (heap->count < process_top_max) {
+        unsigned int index = heap->count++;
+        heap->entries[index] = *entry;
+
+        while (index > 0) {
+            unsigned int parent = (index - 1) / 2;
+
+            if (pi_process_top_value(&heap->entries[parent], key) <= value) {
+                break;
+            }
+
+            pi_process_heap_swap(heap, index, parent);
+            index = parent;
+        }
+    }
+    else if (value > pi_process_top_value(&heap->entries[0], key)) {
+        heap->entries[0] = *entry;
+        pi_process_heap_sift_down(heap, key, 0);
+    }
+}
+
+// Pops the heap from the smallest up, which leaves top largest first.
+//
+static void pi_process_heap_drain(pi_process_heap_t *heap, process_top_key_t key, pi_process_top_ptr top) {
+    top->count = heap->count;
+
+    while (heap->count > 0) {
+        top->entries[heap->count - 1] = heap->entries[0];
+        heap->entries[0] = heap->entries[--heap->count];
+        pi_process_heap_sift_down(heap, key, 0);
+    }
+}
+
+// Returns the CPU ticks the process had at the previous tick and records the current ones,
+// new processes report no CPU use for their first tick.
+//
+unsigned long long pi_process_top_previous_ticks(pid_t pid, unsigned long long cpu_ticks) {
+    pi_process_history_ptr *bucket = &g_process_top.history[(unsigned long) pid % process_top_bucket_count];
+    pi_process_history_ptr history = *bucket;
+
+    while (history && history->pid != pid) {
+        history = history->next;
+    }
+
+    if (NULL == history) {
+        history = memory_alloc(sizeof(pi_process_history_t));
+        history->pid = pid;
+        history->cpu_ticks = cpu_ticks;
+        history->next = *bucket;
+        *bucket = history;
+    }
+
+    unsigned long long previous = history->cpu_ticks <= cpu_ticks ? history->cpu_ticks : cpu_ticks;
+
+    history->cpu_ticks = cpu_ticks;
+    history->generation = g_process_top.generation;
+
+    return previous;
+}
+
+void pi_process_top_sweep_history() {
+    for (int i = 0; i < process_top_bucket_count; i++) {
+        pi_process_history_ptr *link = &g_process_top.history[i];
+
+        while (*link) {
+            pi_process_history_ptr history = *link;
+
+            if (history->generation == g_process_top.generation) {
+                link = &history->next;
+                continue;
+            }
+
+            *link = history->next;
+            memory_free(history);
+        }
+    }
+}
+
+bool pi_process_top_read(pid_t pid, pi_process_top_entry_t *entry, unsigned long long *cpu_ticks) {
+    char path[32];
+    char buffer[1024];
+
+    snprintf(path, sizeof(path), "%d/stat", (int) pid);
+
+    int fd = openat(g_process_top.proc_fd, path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    ssize_t length = 0;
+    do {
+        length = read(fd, buffer, sizeof(buffer) - 1);
+    } while (length < 0 && errno == EINTR);
+
+    close(fd);
+
+    if (length <= 0) {
+        return false;
+    }
+
+    buffer[length] = '\0';
+
+    pi_process_counters_t counters;
+    memory_clear(&counters, sizeof(counters));
+
+    if (!pi_process_parse_stat(buffer, buffer + length, &counters, entry->name)) {
+        return false;
+    }
+
+    entry->pid = pid;
+    entry->rss = (double) (counters.resident_pages * g_process_top.page_kb);
+    *cpu_ticks = counters.cpu_ticks;
+
+    return true;
+}
+
+void pi_process_top_sample(void __unused *context) {
+    unsigned int count = pi_process_list(g_process_top.pids, g_process_top.pid_size);
+
+    if (count > g_process_top.pid_size) {
+        g_process_top.pid_size = count + count / 4;
+        g_process_top.pids = memory_realloc(g_process_top.pids, g_process_top.pid_size * sizeof(pid_t));
+        count = pi_process_list(g_process_top.pids, g_process_top.pid_size);
+        count = min(count, g_process_top.pid_size);
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    double seconds = 0;
+    if (g_process_top.sampled.tv_sec || g_process_top.sampled.tv_nsec) {
+        seconds = (double) (now.tv_sec - g_process_top.sampled.tv_sec)
+                  + (double) (now.tv_nsec - g_process_top.sampled.tv_nsec) / 1000000000.0;
+    }
+
+    g_process_top.sampled = now;
+    g_process_top.generation++;
+
+    pi_process_heap_t heaps[process_top_key_count];
+    for (int key = 0; key < process_top_key_count; key++) {
+        heaps[key].count = 0;
+    }
+
+    for (unsigned int i = 0; i < count; i++) {
+        pi_process_top_entry_t entry;
+        unsigned long long cpu_ticks = 0;
+
+        memory_clear(&entry, sizeof(entry));
+
+        if (!pi_process_top_read(g_process_top.pids[i], &entry, &cpu_ticks)) {
+            continue;
+        }
+
+        unsigned long long previous = pi_process_top_previous_ticks(entry.pid, cpu_ticks);
+
+        if (seconds > 0) {
+            entry.cpu = (double) (cpu_ticks - previous) * 100.0 / (double) g_process_top.ticks_per_second / seconds;
+        }
+
+        for (int key = 0; key < process_top_key_count; key++) {
+            pi_process_heap_push(&heaps[key], (process_top_key_t) key, &entry);
+        }
+    }
+
+    pi_process_top_sweep_history();
+
+    pi_process_top_t sample[process_top_key_count];
+    for (int key = 0; key < process_top_key_count; key++) {
+        pi_process_heap_drain(&heaps[key], (process_top_key_t) key, &sample[key]);
+    }
+
+    pi_seqlock_write(&g_process_top.lock, g_process_top.published, sample, sizeof(sample));
+}
+
+bool pi_process_top_start() {
+    g_process_top.proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (g_process_top.proc_fd < 0) {
+        ERROR_LOG("Unable to open /proc, top processes are not available");
+        return false;
+    }
+
+    g_process_top.ticks_per_second = sysconf(_SC_CLK_TCK);
+    if (g_process_top.ticks_per_second <= 0) {
+        g_process_top.ticks_per_second = 100;
+    }
+
+    g_process_top.page_kb = (unsigned long long) sysconf(_SC_PAGESIZE) / 1024;
+
+    g_process_top.pid_size = 256;
+    g_process_top.pids = memory_alloc(g_process_top.pid_size * sizeof(pid_t));
+
+    g_process_top.sampler = pi_sampler_start("top", pi_process_top_sample, NULL);
+
+    return NULL != g_process_top.sampler;
+}
+
+void pi_process_top_stop() {
+    pi_sampler_stop(g_process_top.sampler);
+    g_process_top.sampler = NULL;
+
+    // Nothing is current any more, the sweep releases all of the history.
+    //
+    g_process_top.generation++;
+    pi_process_top_sweep_history();
+
+    memory_free(g_process_top.pids);
+    g_process_top.pids = NULL;
+    g_process_top.pid_size = 0;
+
+    if (g_process_top.proc_fd >= 0) {
+        close(g_process_top.proc_fd);
+        g_process_top.proc_fd = -1;
+    }
+}
+
+void pi_process_top_get(process_top_key_t key, pi_process_top_ptr top) {
+    pi_seqlock_read(&g_process_top.lock, top, &g_process_top.published[key], sizeof(pi_process_top_t));
+}
+
+int pi_process_top_key(const char *name) {
+    for (int i = 0; i < process_top_key_count; i++) {
+        if (0 == strcmp(name, process_top_key_names[i])) {
+            return i;
+        }
+    }
+
+    return -1;
+}
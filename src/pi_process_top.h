@@ -0,0 +1,79 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#ifndef PI_PROCESS_TOP_H
+#define PI_PROCESS_TOP_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include "pi_process.h"
+
+// Longest list that can be asked for.
+//
+#define process_top_max 32
+
+typedef enum {
+    process_top_cpu,
+    process_top_rss,
+    process_top_key_count
+} process_top_key_t;
+
+typedef struct pi_process_top_entry_struct {
+    pid_t pid;
+    char name[process_name_length];
+
+    // Percentage of one core and kB.
+    //
+    double cpu;
+    double rss;
+} pi_process_top_entry_t;
+
+// Largest first.
+//
+typedef struct pi_process_top_struct {
+    unsigned int count;
+    pi_process_top_entry_t entries[process_top_max];
+} pi_process_top_t;
+
+typedef pi_process_top_t *pi_process_top_ptr;
+
+// Samples /proc/[pid]/stat of every process each get_sample_interval() milliseconds.  Each
+// sample is pushed into a bounded min-heap per key as it is read, so a tick costs
+// O(processes * log process_top_max) and nothing sorts the whole process table.
+//
+bool pi_process_top_start();
+
+void pi_process_top_stop();
+
+// Copies the latest list for key, never waits for the sampler.
+//
+void pi_process_top_get(process_top_key_t key, pi_process_top_ptr top);
+
+// Returns the key called name ("cpu" or "rss") or -1.
+//
+int pi_process_top_key(const char *name);
+
+#endif //PI_PROCESS_TOP_H
@@ -0,0 +1,168 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+
+#include "pi_sampler.h"
+#include "pi_chart_settings.h"
+#include "pi_utils.h"
+
+struct pi_sampler_struct {
+    const char *name;
+    pi_sampler_function_t sample_function;
+    pi_timer_function_t timer_function;
+    void *context;
+
+    // Milliseconds the timer function asked to wait.
+    //
+    unsigned int delay;
+
+    pthread_t thread_id;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool running;
+};
+
+void *pi_sampler_thread(void *parameter) {
+    pi_sampler_ptr sampler = (pi_sampler_ptr) parameter;
+
+    pthread_mutex_lock(&sampler->lock);
+
+    while (sampler->running) {
+        // Sleep until the next sample is due, measured on the monotonic clock so a clock change
+        // does not stall the sampler.
+        //
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+        unsigned int interval = sampler->timer_function ? sampler->delay : get_sample_interval();
+        deadline.tv_sec += interval / 1000;
+        deadline.tv_nsec += (long) (interval % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        int result = 0;
+        while (sampler->running && result != ETIMEDOUT) {
+            result = pthread_cond_timedwait(&sampler->wake, &sampler->lock, &deadline);
+        }
+
+        if (!sampler->running) {
+            break;
+        }
+
+        pthread_mutex_unlock(&sampler->lock);
+
+        if (sampler->timer_function) {
+            sampler->delay = (*sampler->timer_function)(sampler->context);
+        }
+        else {
+            (*sampler->sample_function)(sampler->context);
+        }
+
+        pthread_mutex_lock(&sampler->lock);
+    }
+
+    pthread_mutex_unlock(&sampler->lock);
+
+    DEBUG_LOG("Sampler %s stopped", sampler->name);
+
+    return NULL;
+}
+
+static pi_sampler_ptr pi_sampler_create(const char *name, pi_sampler_function_t sample_function,
+                                        pi_timer_function_t timer_function, void *context) {
+    pi_sampler_ptr sampler = memory_alloc(sizeof(pi_sampler_t));
+    sampler->name = name;
+    sampler->sample_function = sample_function;
+    sampler->timer_function = timer_function;
+    sampler->context = context;
+    sampler->running = true;
+
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&sampler->wake, &attributes);
+    pthread_condattr_destroy(&attributes);
+
+    pthread_mutex_init(&sampler->lock, NULL);
+
+    if (sample_function) {
+        (*sample_function)(context);
+    }
+
+    if (pthread_create(&sampler->thread_id, NULL, &pi_sampler_thread, sampler) != 0) {
+        ERROR_LOG("Unable to start sampler %s", name);
+        pthread_cond_destroy(&sampler->wake);
+        pthread_mutex_destroy(&sampler->lock);
+        memory_free(sampler);
+        return NULL;
+    }
+
+    return sampler;
+}
+
+pi_sampler_ptr pi_sampler_start(const char *name, pi_sampler_function_t sample_function, void *context) {
+    pi_sampler_ptr sampler = pi_sampler_create(name, sample_function, NULL, context);
+
+    if (sampler) {
+        INFO_LOG("Sampler %s started, sampling every %u ms", name, get_sample_interval());
+    }
+
+    return sampler;
+}
+
+pi_sampler_ptr pi_sampler_start_timer(const char *name, pi_timer_function_t timer_function, void *context) {
+    pi_sampler_ptr sampler = pi_sampler_create(name, NULL, timer_function, context);
+
+    if (sampler) {
+        INFO_LOG("Timer %s started", name);
+    }
+
+    return sampler;
+}
+
+void pi_sampler_stop(pi_sampler_ptr sampler) {
+    if (NULL == sampler) {
+        return;
+    }
+
+    pthread_mutex_lock(&sampler->lock);
+    sampler->running = false;
+    pthread_cond_signal(&sampler->wake);
+    pthread_mutex_unlock(&sampler->lock);
+
+    pthread_join(sampler->thread_id, NULL);
+
+    pthread_cond_destroy(&sampler->wake);
+    pthread_mutex_destroy(&sampler->lock);
+    memory_free(sampler);
+}
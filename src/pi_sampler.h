@@ -0,0 +1,58 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#ifndef PI_SAMPLER_H
+#define PI_SAMPLER_H
+
+#include <stdbool.h>
+
+// Called on the sampler thread every get_sample_interval() milliseconds.
+//
+typedef void (*pi_sampler_function_t)(void *context);
+
+// Called on the timer thread, returns how many milliseconds to wait before the next call.
+//
+typedef unsigned int (*pi_timer_function_t)(void *context);
+
+typedef struct pi_sampler_struct pi_sampler_t;
+
+typedef pi_sampler_t *pi_sampler_ptr;
+
+// Takes the first sample on the calling thread, so readers have data as soon as this returns,
+// then keeps sampling on a thread of its own.
+//
+pi_sampler_ptr pi_sampler_start(const char *name, pi_sampler_function_t sample_function, void *context);
+
+// Calls timer_function on a thread of its own, first right away and then after whatever delay
+// the previous call returned.  For state machines that wait different times between steps.
+//
+pi_sampler_ptr pi_sampler_start_timer(const char *name, pi_timer_function_t timer_function, void *context);
+
+// Wakes the sampler up, waits for it to exit and releases it.
+//
+void pi_sampler_stop(pi_sampler_ptr sampler);
+
+#endif //PI_SAMPLER_H
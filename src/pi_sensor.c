@@ -0,0 +1,384 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#include <limits.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include "pi_sensor.h"
+#include "pi_chart_settings.h"
+#include "pi_sampler.h"
+#include "pi_seqlock.h"
+#include "pi_utils.h"
+
+// Largest response a driver may read.
+//
+#define sensor_response_size 32
+
+typedef struct pi_sensor_bus_struct pi_sensor_bus_t;
+
+struct pi_sensor_struct {
+    const pi_sensor_driver_t *driver;
+    unsigned char address;
+    pi_sensor_bus_t *bus;
+
+    // Scheduler state, only touched with the bus lock held.  started_ms is 0 before the first
+    // reading, responding is set once every step was sent.
+    //
+    unsigned long long due_ms;
+    unsigned long long started_ms;
+    unsigned long long ready_ms;
+    unsigned int step;
+    bool active;
+    bool responding;
+    pi_sensor_reading_t reading;
+
+    pi_seqlock_t published_lock;
+    pi_sensor_reading_t published;
+};
+
+// Every transaction on a bus happens on its timer thread with the lock held, adding a sensor
+// takes the lock too, so devices never talk over each other.
+//
+struct pi_sensor_bus_struct {
+    pi_i2c_bus_ptr i2c;
+    pi_sampler_ptr timer;
+    pthread_mutex_t lock;
+
+    pi_sensor_ptr sensors[sensor_max_sensors];
+    unsigned int count;
+    unsigned int active;
+
+    unsigned long long opened_ms;
+    double latency_total_ms;
+    pi_sensor_bus_stats_t stats;
+
+    pi_seqlock_t stats_lock;
+    pi_sensor_bus_stats_t published_stats;
+};
+
+typedef struct pi_sensors_struct {
+    pthread_mutex_t lock;
+    pi_sensor_bus_t *buses[sensor_max_buses];
+    unsigned int bus_count;
+    pi_sensor_ptr sensors[sensor_max_sensors];
+    unsigned int sensor_count;
+} pi_sensors_t;
+
+pi_sensors_t g_sensors = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static unsigned long long pi_sensor_now_ms() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (unsigned long long) now.tv_sec * 1000ULL + (unsigned long long) now.tv_nsec / 1000000ULL;
+}
+
+static unsigned long long pi_sensor_interval(pi_sensor_ptr sensor) {
+    return max(get_sample_interval(), sensor->driver->min_interval_ms);
+}
+
+// Earliest the device may be woken again.
+//
+static unsigned long long pi_sensor_allowed(pi_sensor_ptr sensor) {
+    return sensor->started_ms ? sensor->started_ms + sensor->driver->min_interval_ms : 0;
+}
+
+// Takes every sensor that is due, or will be within the batch window, into one wake cycle as
+// long as its minimum interval has passed.  Reading them early keeps them in step afterwards.
+//
+static void pi_sensor_bus_start_cycle(pi_sensor_bus_t *bus, unsigned long long now) {
+    for (unsigned int i = 0; i < bus->count; i++) {
+        pi_sensor_ptr sensor = bus->sensors[i];
+
+        if (sensor->due_ms <= now + sensor_batch_window_ms && pi_sensor_allowed(sensor) <= now) {
+            sensor->active = true;
+            sensor->responding = false;
+            sensor->step = 0;
+            sensor->ready_ms = now;
+            bus->active++;
+        }
+    }
+
+    if (bus->active) {
+        bus->stats.cycles++;
+    }
+}
+
+static void pi_sensor_finish(pi_sensor_bus_t *bus, pi_sensor_ptr sensor, const double *values) {
+    unsigned long long now = pi_sensor_now_ms();
+
+    sensor->active = false;
+    bus->active--;
+
+    if (values) {
+        double latency = (double) (now - min(sensor->due_ms, sensor->started_ms));
+
+        sensor->reading.valid = true;
+        memcpy(sensor->reading.values, values, sizeof(sensor->reading.values));
+        sensor->reading.taken_ms = now;
+        sensor->reading.taken = time(NULL);
+        sensor->reading.reads++;
+        sensor->reading.latency_ms = latency;
+
+        bus->stats.readings++;
+        bus->latency_total_ms += latency;
+        bus->stats.mean_latency_ms = bus->latency_total_ms / (double) bus->stats.readings;
+        bus->stats.max_latency_ms = max(bus->stats.max_latency_ms, latency);
+    }
+    else {
+        sensor->reading.errors++;
+        bus->stats.errors++;
+
+        DEBUG_LOG("Reading %s at 0x%x failed", sensor->driver->name, sensor->address);
+    }
+
+    sensor->due_ms = sensor->started_ms + pi_sensor_interval(sensor);
+
+    if (now > bus->opened_ms) {
+        bus->stats.readings_per_sec = (double) bus->stats.readings * 1000.0 / (double) (now - bus->opened_ms);
+    }
+
+    pi_seqlock_write(&sensor->published_lock, &sensor->published, &sensor->reading, sizeof(pi_sensor_reading_t));
+    pi_seqlock_write(&bus->stats_lock, &bus->published_stats, &bus->stats, sizeof(pi_sensor_bus_stats_t));
+}
+
+static void pi_sensor_run_step(pi_sensor_bus_t *bus, pi_sensor_ptr sensor, unsigned long long now) {
+    const pi_sensor_driver_t *driver = sensor->driver;
+
+    if (!sensor->responding) {
+        unsigned int delay = 0;
+        bool done = false;
+
+        if (0 == sensor->step) {
+            sensor->started_ms = now;
+        }
+
+        if (!driver->schedule(bus->i2c, sensor->address, sensor->step++, &delay, &done)) {
+            pi_sensor_finish(bus, sensor, NULL);
+            return;
+        }
+
+        sensor->responding = done;
+        sensor->ready_ms = pi_sensor_now_ms() + delay;
+        return;
+    }
+
+    unsigned char response[sensor_response_size];
+    double values[sensor_max_values];
+
+    memory_clear(response, sizeof(response));
+    memory_clear(values, sizeof(values));
+
+    ssize_t length = driver->read(bus->i2c, sensor->address, response, sizeof(response));
+
+    pi_sensor_finish(bus, sensor, driver->decode(response, length, values) ? values : NULL);
+}
+
+// Runs every step that is ready, then sleeps until the next one.  While a cycle is under way
+// only its sensors count, the others wait for the next cycle.
+//
+static unsigned int pi_sensor_bus_step(void *context) {
+    pi_sensor_bus_t *bus = context;
+
+    pthread_mutex_lock(&bus->lock);
+
+    unsigned long long now = pi_sensor_now_ms();
+
+    if (0 == bus->active) {
+        pi_sensor_bus_start_cycle(bus, now);
+    }
+
+    for (unsigned int i = 0; i < bus->count; i++) {
+        pi_sensor_ptr sensor = bus->sensors[i];
+
+        if (sensor->active && sensor->ready_ms <= now) {
+            pi_sensor_run_step(bus, sensor, now);
+        }
+    }
+
+    unsigned long long next = ULLONG_MAX;
+
+    for (unsigned int i = 0; i < bus->count; i++) {
+        pi_sensor_ptr sensor = bus->sensors[i];
+
+        if (bus->active) {
+            next = sensor->active ? min(next, sensor->ready_ms) : next;
+        }
+        else {
+            next = min(next, max(sensor->due_ms, pi_sensor_allowed(sensor)));
+        }
+    }
+
+    pthread_mutex_unlock(&bus->lock);
+
+    now = pi_sensor_now_ms();
+
+    if (ULLONG_MAX == next) {
+        return get_sample_interval();
+    }
+
+    return next > now ? (unsigned int) (next - now) : 0;
+}
+
+// Call with g_sensors.lock held.
+//
+static pi_sensor_bus_t *pi_sensor_get_bus(const char *bus_path) {
+    for (unsigned int i = 0; i < g_sensors.bus_count; i++) {
+        if (0 == strcmp(pi_i2c_bus_name(g_sensors.buses[i]->i2c), bus_path)) {
+            return g_sensors.buses[i];
+        }
+    }
+
+    if (g_sensors.bus_count >= sensor_max_buses) {
+        ERROR_LOG("Unable to add I2C bus %s, %d buses are in use", bus_path, sensor_max_buses);
+        return NULL;
+    }
+
+    pi_i2c_bus_ptr i2c = pi_i2c_bus_open(bus_path);
+
+    if (NULL == i2c) {
+        return NULL;
+    }
+
+    pi_sensor_bus_t *bus = memory_alloc(sizeof(pi_sensor_bus_t));
+    bus->i2c = i2c;
+    bus->opened_ms = pi_sensor_now_ms();
+    pthread_mutex_init(&bus->lock, NULL);
+    strncpy(bus->stats.name, bus_path, sizeof(bus->stats.name) - 1);
+
+    g_sensors.buses[g_sensors.bus_count++] = bus;
+
+    return bus;
+}
+
+pi_sensor_ptr pi_sensor_add(const char *bus_path, const pi_sensor_driver_t *driver, unsigned char address) {
+    pthread_mutex_lock(&g_sensors.lock);
+
+    pi_sensor_ptr sensor = NULL;
+    pi_sensor_bus_t *bus = pi_sensor_get_bus(bus_path);
+
+    for (unsigned int i = 0; bus && i < bus->count; i++) {
+        if (bus->sensors[i]->address == address) {
+            sensor = bus->sensors[i];
+        }
+    }
+
+    if (bus && NULL == sensor && g_sensors.sensor_count < sensor_max_sensors) {
+        pthread_mutex_lock(&bus->lock);
+
+        if (driver->emulate) {
+            pi_i2c_bus_emulate(bus->i2c, address, driver->emulate);
+        }
+
+        if (NULL == driver->open || driver->open(bus->i2c, address)) {
+            sensor = memory_alloc(sizeof(pi_sensor_t));
+            sensor->driver = driver;
+            sensor->address = address;
+            sensor->bus = bus;
+            sensor->due_ms = pi_sensor_now_ms();
+
+            bus->sensors[bus->count++] = sensor;
+            bus->stats.sensors = bus->count;
+            g_sensors.sensors[g_sensors.sensor_count++] = sensor;
+        }
+        else {
+            ERROR_LOG("Unable to open %s at 0x%x on %s", driver->name, address, bus_path);
+        }
+
+        pthread_mutex_unlock(&bus->lock);
+
+        if (sensor) {
+            INFO_LOG("Reading %s at 0x%x on %s", driver->name, address, bus_path);
+        }
+
+        if (sensor && NULL == bus->timer) {
+            bus->timer = pi_sampler_start_timer(pi_i2c_bus_name(bus->i2c), pi_sensor_bus_step, bus);
+        }
+    }
+
+    pthread_mutex_unlock(&g_sensors.lock);
+
+    return sensor;
+}
+
+const pi_sensor_driver_t *pi_sensor_get_driver(pi_sensor_ptr sensor) {
+    return sensor->driver;
+}
+
+unsigned char pi_sensor_get_address(pi_sensor_ptr sensor) {
+    return sensor->address;
+}
+
+const char *pi_sensor_get_bus_name(pi_sensor_ptr sensor) {
+    return pi_i2c_bus_name(sensor->bus->i2c);
+}
+
+void pi_sensor_get(pi_sensor_ptr sensor, pi_sensor_reading_ptr reading) {
+    pi_seqlock_read(&sensor->published_lock, reading, &sensor->published, sizeof(pi_sensor_reading_t));
+}
+
+double pi_sensor_age(const pi_sensor_reading_t *reading) {
+    return reading->valid ? (double) (pi_sensor_now_ms() - reading->taken_ms) / 1000.0 : -1;
+}
+
+bool pi_sensor_fresh(pi_sensor_ptr sensor, const pi_sensor_reading_t *reading) {
+    return reading->valid && pi_sensor_age(reading) * 1000.0 <= 3.0 * (double) pi_sensor_interval(sensor);
+}
+
+unsigned int pi_sensor_bus_stats(pi_sensor_bus_stats_ptr stats, unsigned int size) {
+    pthread_mutex_lock(&g_sensors.lock);
+
+    unsigned int count = g_sensors.bus_count;
+
+    for (unsigned int i = 0; i < count && i < size; i++) {
+        pi_sensor_bus_t *bus = g_sensors.buses[i];
+
+        pi_seqlock_read(&bus->stats_lock, &stats[i], &bus->published_stats, sizeof(pi_sensor_bus_stats_t));
+
+        // Before the first reading nothing has been published.
+        //
+        memcpy(stats[i].name, bus->stats.name, sizeof(stats[i].name));
+        stats[i].sensors = bus->count;
+    }
+
+    pthread_mutex_unlock(&g_sensors.lock);
+
+    return count;
+}
+
+unsigned int pi_sensor_list(pi_sensor_ptr *sensors, unsigned int size) {
+    pthread_mutex_lock(&g_sensors.lock);
+
+    unsigned int count = g_sensors.sensor_count;
+    memcpy(sensors, g_sensors.sensors, min(count, size) * sizeof(pi_sensor_ptr));
+
+    pthread_mutex_unlock(&g_sensors.lock);
+
+    return count;
+}
@@ -0,0 +1,157 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#ifndef PI_SENSOR_H
+#define PI_SENSOR_H
+
+#include <stdbool.h>
+#include <time.h>
+#include "pi_i2c_bus.h"
+
+#define sensor_max_values 4
+#define sensor_max_sensors 32
+#define sensor_max_buses 4
+
+// Sensors due within this many milliseconds of each other are read in the same wake cycle.
+//
+#define sensor_batch_window_ms 250
+
+// A driver reads a device in steps the bus scheduler runs, so one bus thread can interleave the
+// readings of several devices while each of them waits for its conversion.
+//
+typedef struct pi_sensor_driver_struct {
+    const char *name;
+
+    // Where the device answers unless it is added somewhere else.
+    //
+    unsigned char address;
+
+    // Shortest time between two readings the device allows.
+    //
+    unsigned int min_interval_ms;
+
+    // NULL terminated, at most sensor_max_values.
+    //
+    const char *const *value_names;
+
+    // Gets the device ready once when it is added, false if it is not there.  May be NULL.
+    //
+    bool (*open)(pi_i2c_bus_ptr bus, unsigned char address);
+
+    // Sends step (0 first) of a reading and sets how many milliseconds to wait before the next
+    // one.  Sets done once the response can be read after that wait.  False if the step failed.
+    //
+    bool (*schedule)(pi_i2c_bus_ptr bus, unsigned char address, unsigned int step, unsigned int *delay_ms,
+                     bool *done);
+
+    // Reads the response into buffer, returns its length or -1.
+    //
+    ssize_t (*read)(pi_i2c_bus_ptr bus, unsigned char address, unsigned char *buffer, size_t size);
+
+    // Checks and converts a response, false if it is corrupt.
+    //
+    bool (*decode)(const unsigned char *response, ssize_t length, double *values);
+
+    // Answers for the device on the emulated bus.
+    //
+    pi_i2c_device_emulator_t emulate;
+} pi_sensor_driver_t;
+
+typedef struct pi_sensor_reading_struct {
+    // False until the first reading passed decode.
+    //
+    bool valid;
+    double values[sensor_max_values];
+
+    // When the last good reading was taken, on the monotonic clock and the wall clock.
+    //
+    unsigned long long taken_ms;
+    time_t taken;
+
+    unsigned long long reads;
+    unsigned long long errors;
+
+    // Milliseconds from when the reading was due to when it was decoded.
+    //
+    double latency_ms;
+} pi_sensor_reading_t;
+
+typedef pi_sensor_reading_t *pi_sensor_reading_ptr;
+
+typedef struct pi_sensor_bus_stats_struct {
+    char name[64];
+    unsigned int sensors;
+
+    // Wake cycles and the readings and errors they produced since the bus was opened.
+    //
+    unsigned long long cycles;
+    unsigned long long readings;
+    unsigned long long errors;
+    double readings_per_sec;
+    double mean_latency_ms;
+    double max_latency_ms;
+} pi_sensor_bus_stats_t;
+
+typedef pi_sensor_bus_stats_t *pi_sensor_bus_stats_ptr;
+
+typedef struct pi_sensor_struct pi_sensor_t;
+
+typedef pi_sensor_t *pi_sensor_ptr;
+
+// Reads the device at address on the bus at bus_path (see pi_i2c_bus_open()) every
+// get_sample_interval() milliseconds, or every driver->min_interval_ms if that is longer.  The
+// bus is opened and given a scheduler the first time it is named.  On the emulated bus the
+// driver's emulator answers at address.  Returns the sensor already there if address is taken.
+//
+pi_sensor_ptr pi_sensor_add(const char *bus_path, const pi_sensor_driver_t *driver, unsigned char address);
+
+const pi_sensor_driver_t *pi_sensor_get_driver(pi_sensor_ptr sensor);
+
+// Copies the last reading, never touches the bus and never waits for it.
+//
+void pi_sensor_get(pi_sensor_ptr sensor, pi_sensor_reading_ptr reading);
+
+// Seconds since the reading was taken, -1 if there has not been a good one.
+//
+double pi_sensor_age(const pi_sensor_reading_t *reading);
+
+// True while the reading is no older than three reading intervals of sensor.
+//
+bool pi_sensor_fresh(pi_sensor_ptr sensor, const pi_sensor_reading_t *reading);
+
+// Copies the statistics of up to size buses, returns how many there are.
+//
+unsigned int pi_sensor_bus_stats(pi_sensor_bus_stats_ptr stats, unsigned int size);
+
+// Copies up to size sensors, returns how many there are.
+//
+unsigned int pi_sensor_list(pi_sensor_ptr *sensors, unsigned int size);
+
+unsigned char pi_sensor_get_address(pi_sensor_ptr sensor);
+
+const char *pi_sensor_get_bus_name(pi_sensor_ptr sensor);
+
+#endif //PI_SENSOR_H
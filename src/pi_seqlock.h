@@ -0,0 +1,68 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#ifndef PI_SEQLOCK_H
+#define PI_SEQLOCK_H
+
+#include <stdbool.h>
+#include <string.h>
+
+// Sequence lock for data with a single writer, typically a sampler thread.  Readers never
+// block the writer: they copy the data and retry if the sequence changed while they did.
+// The sequence is odd while a write is in progress.
+//
+typedef struct pi_seqlock_struct {
+    unsigned int sequence;
+} pi_seqlock_t;
+
+typedef pi_seqlock_t *pi_seqlock_ptr;
+
+static inline void pi_seqlock_write(pi_seqlock_ptr lock, void *destination, const void *source, size_t size) {
+    unsigned int sequence = __atomic_load_n(&lock->sequence, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&lock->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy(destination, source, size);
+
+    __atomic_store_n(&lock->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+static inline void pi_seqlock_read(pi_seqlock_ptr lock, void *destination, const void *source, size_t size) {
+    unsigned int before;
+    unsigned int after;
+
+    do {
+        before = __atomic_load_n(&lock->sequence, __ATOMIC_ACQUIRE);
+
+        memcpy(destination, source, size);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&lock->sequence, __ATOMIC_RELAXED);
+    } while ((before & 1) || before != after);
+}
+
+#endif //PI_SEQLOCK_H
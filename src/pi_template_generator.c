@@ -28,374 +28,397 @@
 #include <ctype.h>
 #include "pi_template_generator.h"
 #include "pi_utils.h"
-#include "pi_intmap.h"
-#define if_stack_depth 32
-
-typedef struct pi_template_generator_struct {
-
-    void *context_ptr;
-    function_string_ptr_t function_string_ptr;
-    function_boolean_ptr_t function_boolean_ptr;
-
-    pi_intmap_ptr symbol_map;
-
-    pi_string_ptr output_buffer;
-
-    int if_stack_top;
-    bool if_stack[if_stack_depth];
-} pi_template_generator_t;
 
+#define template_max_sources 16
 
 typedef enum {
     operator_type_invalid = 0,
-    operator_type_variable,
+    operator_type_literal,
+    operator_type_output,
     operator_type_If,
     operator_type_Else,
     operator_type_EndIf,
-    operator_type_output,
 } operator_type_t;
 
-#define OPERATOR_SYMBOL(name) operator_type_##name
-
-void pi_template_generator_create(pi_template_generator_t *ptg_context,
-                                  pi_string_ptr output_buffer,
-                                  void *context_ptr,
-                                  function_boolean_ptr_t function_boolean_ptr,
-                                  function_string_ptr_t function_string_ptr) {
+// One instruction.  Literals and symbol names are (offset, length) spans of the program text,
+// If and Else carry the index of the instruction to continue at when they branch.
+//
+typedef struct pi_template_op_struct {
+    operator_type_t type;
+    unsigned int offset;
+    unsigned int length;
+    unsigned int jump;
+    pi_template_symbol_t symbol;
+} pi_template_op_t;
+
+struct pi_template_program_struct {
+    // Copy of the literal text and the null terminated symbol names.
+    //
+    pi_string_ptr text;
 
-    memory_clear(ptg_context, sizeof(pi_template_generator_t));
+    pi_template_op_t *ops;
+    unsigned int op_count;
+    unsigned int op_size;
 
-    ptg_context->output_buffer = output_buffer;
+    const pi_template_provider_t *const *providers;
 
-    // These need to be in sync with operator_type enum
+    // Sources the bound symbols read from, each is snapshot once per render.
     //
-    ptg_context->symbol_map = pi_intmap_new(64);
-    pi_intmap_put(ptg_context->symbol_map, "If", OPERATOR_SYMBOL(If));
-    pi_intmap_put(ptg_context->symbol_map, "Else", OPERATOR_SYMBOL(Else));
-    pi_intmap_put(ptg_context->symbol_map, "EndIf", OPERATOR_SYMBOL(EndIf));
-    pi_intmap_put(ptg_context->symbol_map, "=", OPERATOR_SYMBOL(output));
-
-    ptg_context->context_ptr = context_ptr;
-    ptg_context->function_string_ptr = function_string_ptr;
-    ptg_context->function_boolean_ptr = function_boolean_ptr;
-}
-
-void pi_template_generator_destroy(pi_template_generator_t *ptg_context) {
+    const pi_template_source_t *sources[template_max_sources];
+    int source_count;
+};
 
-    pi_intmap_delete(ptg_context->symbol_map);
-}
+#define if_stack_initial_depth 32
 
-static const char *pi_template_skip_white(const char *pch, const char chDelim) {
-    while (isspace(*pch) || chDelim == *pch) {
+static const char *pi_template_skip_white(const char *pch, const char *end) {
+    while (pch < end && isspace(*pch)) {
         pch++;
     }
 
     return pch;
 }
 
-pi_string_ptr pi_template_get_symbol(const char *begin_tag, char **end_tag) {
-    ASSERT(NULL != end_tag);
-
-    if (NULL == end_tag) {
-        return NULL;
-    }
-
-    // Skip white space at start of the string.
-    //
-    begin_tag = pi_template_skip_white(begin_tag, ' ');
+// Returns the next symbol of a tag.  Anything that does not start with a letter or a digit is
+// a single character symbol ("="), otherwise it runs to the next space or '%'.
+//
+const char *pi_template_get_symbol(const char *begin, const char *end, size_t *length) {
+    begin = pi_template_skip_white(begin, end);
 
-    // OK now from here on out lets determine if we see a "symbol" +-% etc or are we
-    // looking an alpha numeric value?
-    //
-    *end_tag = (char *) begin_tag;
+    const char *ptr = begin;
 
-    // Check to see if we see symbol
-    //
-    if (!isalnum(**end_tag)){
-        // Huh, it must be something special, we only take symbols one at a time.
-        //
-        (*end_tag)++;
+    if (ptr < end && !isalnum(*ptr)) {
+        ptr++;
     }
     else {
-        // We are good to go either this is a number of a symbol.
-        while (!isspace(**end_tag) && '%' != **end_tag && **end_tag) {
-            (*end_tag)++;
+        while (ptr < end && !isspace(*ptr) && '%' != *ptr) {
+            ptr++;
         }
     }
 
-    pi_string_ptr symbol = pi_string_new(*end_tag - begin_tag);
-    pi_string_append_str_length(symbol, begin_tag, *end_tag - begin_tag);
+    *length = (size_t) (ptr - begin);
 
-    return symbol;
+    return begin;
 }
 
-bool pi_template_resolve_symbol(pi_template_generator_t *ptg_context,
-                                pi_string_ptr symbol_buffer,
-                                pi_string_ptr result_buffer) {
-
-    operator_type_t operator_type = (operator_type_t) pi_intmap_get_value(ptg_context->symbol_map,
-                                                                          pi_string_c_string(symbol_buffer));
+bool pi_template_symbol_equals(const char *symbol, size_t length, const char *name) {
+    return length == strlen(name) && 0 == strncmp(symbol, name, length);
+}
 
-    bool valid = false;
+unsigned int pi_template_add_op(pi_template_program_ptr program, operator_type_t type) {
+    if (program->op_count == program->op_size) {
+        program->op_size *= 2;
+        program->ops = memory_realloc(program->ops, program->op_size * sizeof(pi_template_op_t));
+    }
 
-    if ( operator_type == operator_type_invalid || operator_type == operator_type_variable) {
+    pi_template_op_t *op = &program->ops[program->op_count];
+    memory_clear(op, sizeof(pi_template_op_t));
+    op->type = type;
 
-        if (result_buffer) {
-            pi_string_reset(result_buffer);
-        }
+    return program->op_count++;
+}
 
-        valid = (*ptg_context->function_string_ptr)(ptg_context->context_ptr,
-                                                         pi_string_c_string(symbol_buffer),
-                                                         result_buffer);
+void pi_template_add_literal(pi_template_program_ptr program, const char *text, size_t length) {
+    if (0 == length) {
+        return;
+    }
 
-        if (valid && operator_type == operator_type_invalid) {
-            pi_intmap_put(ptg_context->symbol_map, pi_string_c_string(symbol_buffer), operator_type_variable);
+    // Text on both sides of a tag that compiled to nothing ends up in one span.
+    //
+    if (program->op_count > 0) {
+        pi_template_op_t *last = &program->ops[program->op_count - 1];
+        if (last->type == operator_type_literal
+            && last->offset + last->length == pi_string_c_string_length(program->text)) {
+            pi_string_append_str_length(program->text, text, length);
+            last->length += length;
+            return;
         }
-
     }
 
-    return valid;
+    unsigned int index = pi_template_add_op(program, operator_type_literal);
+    program->ops[index].offset = (unsigned int) pi_string_c_string_length(program->text);
+    program->ops[index].length = (unsigned int) length;
+
+    pi_string_append_str_length(program->text, text, length);
 }
 
-bool pi_template_test_symbol(pi_template_generator_t *ptg_context,
-                             pi_string_ptr symbol_buffer,
-                             bool *value) {
+// Finds the provider with the longest prefix matching symbol and lets it bind the rest.
+//
+bool pi_template_bind_symbol(pi_template_program_ptr program, const char *symbol, pi_template_symbol_t *handle) {
+    const pi_template_provider_t *best = NULL;
+    size_t best_length = 0;
+
+    for (const pi_template_provider_t *const *provider = program->providers; provider && *provider; provider++) {
+        size_t prefix_length = strlen((*provider)->prefix);
 
-    operator_type_t operator_type = (operator_type_t) pi_intmap_get_value(ptg_context->symbol_map,
-                                                                          pi_string_c_string(symbol_buffer));
+        if (prefix_length >= best_length && strncmp(symbol, (*provider)->prefix, prefix_length) == 0) {
+            best = *provider;
+            best_length = prefix_length;
+        }
+    }
 
-    bool valid = false;
+    if (NULL == best || !(*best->bind)(symbol + best_length, &handle->field)) {
+        return false;
+    }
 
-    if ( operator_type == operator_type_invalid || operator_type == operator_type_variable) {
+    handle->provider = best;
+    handle->source_index = -1;
 
-        if (value) {
-            *value = false;
+    if (best->source) {
+        int index = 0;
+        while (index < program->source_count && program->sources[index] != best->source) {
+            index++;
         }
 
-        valid = (*ptg_context->function_boolean_ptr)(ptg_context->context_ptr,
-                                                          pi_string_c_string(symbol_buffer),
-                                                          value);
+        if (index == template_max_sources) {
+            ERROR_LOG("Too many symbol sources in one template, ignoring %s", symbol);
+            handle->provider = NULL;
+            return false;
+        }
 
-        if (valid && operator_type == operator_type_invalid) {
-            pi_intmap_put(ptg_context->symbol_map, pi_string_c_string(symbol_buffer), operator_type_variable);
+        if (index == program->source_count) {
+            program->sources[program->source_count++] = best->source;
         }
 
+        handle->source_index = index;
     }
 
-    return valid;
+    return true;
 }
 
-operator_type_t pi_template_lookup_symbol(pi_template_generator_t *ptg_context,
-                                          const char *begin_tag,
-                                          pi_string_ptr result_buffer,
-                                          bool *response_result) {
-    ASSERT(result_buffer != NULL && response_result != NULL);
-    ASSERT(*begin_tag == '<' && *(begin_tag + 1) == '%');
+unsigned int pi_template_add_symbol_op(pi_template_program_ptr program,
+                                       operator_type_t type,
+                                       const char *symbol,
+                                       size_t length) {
+    unsigned int index = pi_template_add_op(program, type);
+    pi_template_op_t *op = &program->ops[index];
+    op->offset = (unsigned int) pi_string_c_string_length(program->text);
+    op->length = (unsigned int) length;
 
-    if (result_buffer) {
-        pi_string_reset(result_buffer);
+    pi_string_append_str_length(program->text, symbol, length);
+    pi_string_append_char(program->text, '\0');
+
+    const char *name = pi_string_c_string(program->text) + op->offset;
+
+    bool bound = pi_template_bind_symbol(program, name, &op->symbol);
+
+    if (bound && type == operator_type_output && NULL == op->symbol.provider->get_string) {
+        bound = false;
     }
 
-    if (response_result) {
-        *response_result = false;
+    if (bound && type == operator_type_If && NULL == op->symbol.provider->get_boolean) {
+        bound = false;
     }
 
-    operator_type_t operator_type = operator_type_invalid;
+    if (!bound) {
+        ERROR_LOG("Unknown symbol or operator: %s", name);
+        op->symbol.provider = NULL;
+    }
 
-    if (*begin_tag == '<' && *(begin_tag + 1) == '%') {
-        //  Move past the '<%' tag marker and any leading white spaces.
-        //
-        char *end_tag = NULL;
-        pi_string_ptr first_symbol = pi_template_get_symbol(begin_tag + 2, &end_tag);
+    return index;
+}
 
-        operator_type = (operator_type_t) pi_intmap_get_value(ptg_context->symbol_map,
-                                                              pi_string_c_string(first_symbol));
+pi_template_program_ptr pi_template_compile(const char *source,
+                                            size_t source_length,
+                                            const pi_template_provider_t *const *providers) {
+    if (NULL == source) {
+        return NULL;
+    }
 
-        pi_string_ptr second_symbol = NULL;
+    pi_template_program_ptr program = memory_alloc(sizeof(pi_template_program_t));
+    program->providers = providers;
+    program->text = pi_string_new(source_length + 1);
+    program->op_size = 64;
+    program->ops = memory_alloc(program->op_size * sizeof(pi_template_op_t));
 
-        switch (operator_type) {
-            case operator_type_If:
-                second_symbol = pi_template_get_symbol(end_tag, &end_tag);
-                if (!pi_template_test_symbol(ptg_context, second_symbol, response_result)) {
-                    operator_type = operator_type_invalid;
-                }
-                break;
+    // Open If and Else instructions waiting for their jump targets, grows with the nesting so
+    // every one of them gets patched.
+    //
+    unsigned int if_stack_size = if_stack_initial_depth;
+    unsigned int *if_stack = memory_alloc(if_stack_size * sizeof(unsigned int));
+    unsigned int if_stack_top = 0;
 
-            case operator_type_Else:
-            case operator_type_EndIf:
-                break;
+    const char *ptr_in = source;
+    const char *ptr_EOF = source + source_length;
 
-            case operator_type_output:
-                second_symbol = pi_template_get_symbol(end_tag, &end_tag);
-                if (!pi_template_resolve_symbol(ptg_context, second_symbol, result_buffer)) {
-                    operator_type = operator_type_invalid;
-                }
-                break;
+    while (ptr_in < ptr_EOF) {
+        //  Look for the next "<%", everything up to it is copied as is.
+        //
+        const char *ptr_tag = ptr_in;
+        while (ptr_tag + 1 < ptr_EOF && !(*ptr_tag == '<' && *(ptr_tag + 1) == '%')) {
+            ptr_tag++;
+        }
 
-            case operator_type_variable:
-                if (!pi_template_resolve_symbol(ptg_context, first_symbol, result_buffer)) {
-                    operator_type = operator_type_invalid;
-                }
-                break;
+        if (ptr_tag + 1 >= ptr_EOF) {
+            pi_template_add_literal(program, ptr_in, ptr_EOF - ptr_in);
+            break;
+        }
 
-            case operator_type_invalid:
-            default:
-                ERROR_LOG("Unknown symbol or operator: %s", pi_string_c_string(first_symbol));
-                break;
+        pi_template_add_literal(program, ptr_in, ptr_tag - ptr_in);
 
+        // Find the closing %>
+        //
+        const char *tag_begin = ptr_tag + 2;
+        const char *tag_end = tag_begin;
+        while (tag_end + 1 < ptr_EOF && !(*tag_end == '%' && *(tag_end + 1) == '>')) {
+            tag_end++;
         }
 
-        pi_string_delete(first_symbol, true);
-        pi_string_delete(second_symbol, true);
-    }
+        if (tag_end + 1 >= ptr_EOF) {
+            ERROR_LOG("Unterminated tag at offset %d.", ptr_tag - source);
+            tag_end = ptr_EOF;
+        }
 
-    return operator_type;
-}
+        size_t first_length = 0;
+        const char *first_symbol = pi_template_get_symbol(tag_begin, tag_end, &first_length);
 
-void pi_template_push_if(pi_template_generator_t *ptg_context, bool value) {
-    if (ptg_context->if_stack_top < if_stack_depth) {
-        ptg_context->if_stack[ptg_context->if_stack_top] = value;
-    }
-    ptg_context->if_stack_top++;
-}
+        size_t second_length = 0;
+        const char *second_symbol = pi_template_get_symbol(first_symbol + first_length, tag_end, &second_length);
+
+        if (pi_template_symbol_equals(first_symbol, first_length, "If")) {
+            unsigned int index = pi_template_add_symbol_op(program, operator_type_If, second_symbol, second_length);
+
+            if (if_stack_top == if_stack_size) {
+                if_stack_size *= 2;
+                if_stack = memory_realloc(if_stack, if_stack_size * sizeof(unsigned int));
+            }
+            if_stack[if_stack_top++] = index;
+        }
+        else if (pi_template_symbol_equals(first_symbol, first_length, "Else")) {
+            if (if_stack_top > 0) {
+                unsigned int index = pi_template_add_op(program, operator_type_Else);
+
+                // A false If continues after the Else, the Else itself jumps past the EndIf.
+                //
+                program->ops[if_stack[if_stack_top - 1]].jump = index + 1;
+                if_stack[if_stack_top - 1] = index;
+            }
+            else {
+                ERROR_LOG("Else without If at offset %d.", ptr_tag - source);
+            }
+        }
+        else if (pi_template_symbol_equals(first_symbol, first_length, "EndIf")) {
+            if (if_stack_top > 0) {
+                unsigned int index = pi_template_add_op(program, operator_type_EndIf);
+
+                program->ops[if_stack[if_stack_top - 1]].jump = index + 1;
+                if_stack_top--;
+            }
+            else {
+                ERROR_LOG("EndIf without If at offset %d.", ptr_tag - source);
+            }
+        }
+        else if (pi_template_symbol_equals(first_symbol, first_length, "=")) {
+            pi_template_add_symbol_op(program, operator_type_output, second_symbol, second_length);
+        }
+        else if (first_length > 0) {
+            pi_template_add_symbol_op(program, operator_type_output, first_symbol, first_length);
+        }
+        else {
+            ERROR_LOG("Empty tag at offset %d.", ptr_tag - source);
+        }
 
-void pi_template_push_else(pi_template_generator_t *ptg_context) {
-    if (ptg_context->if_stack_top > 0 && ptg_context->if_stack_top < if_stack_depth) {
-        ptg_context->if_stack[ptg_context->if_stack_top - 1] =
-                !ptg_context->if_stack[ptg_context->if_stack_top - 1];
+        ptr_in = tag_end + 2;
     }
-}
 
-void pi_template_pop_if(pi_template_generator_t *ptg_context) {
-    if (ptg_context->if_stack_top > 0) {
-        ptg_context->if_stack_top--;
+    // Anything still open runs to the end of the page.
+    //
+    while (if_stack_top > 0) {
+        program->ops[if_stack[if_stack_top - 1]].jump = program->op_count;
+        if_stack_top--;
     }
-}
 
-bool pi_template_if_set(pi_template_generator_t *ptg_context) {
-    for (int i = 0; i < ptg_context->if_stack_top; i++) {
-        if (!ptg_context->if_stack[i]) {
-            return false;
+    memory_free(if_stack);
+
+    // The text buffer has stopped moving, point the symbols at their names.
+    //
+    for (unsigned int i = 0; i < program->op_count; i++) {
+        pi_template_op_t *op = &program->ops[i];
+
+        if (op->symbol.provider) {
+            op->symbol.name = pi_string_c_string(program->text) + op->offset + strlen(op->symbol.provider->prefix);
         }
     }
-    return true;
+
+    return program;
 }
 
-void pi_template_output(pi_template_generator_t *ptg_context, const char *ptr_in) {
-    if (pi_template_if_set(ptg_context)) {
-        pi_string_append_str(ptg_context->output_buffer, ptr_in);
+void pi_template_program_delete(pi_template_program_ptr program) {
+    if (program) {
+        pi_string_delete(program->text, true);
+        memory_free(program->ops);
+        memory_free(program);
     }
 }
 
-void pi_template_output_length(pi_template_generator_t *ptg_context, const char *ptr_in, size_t length) {
-    if (pi_template_if_set(ptg_context)) {
-        pi_string_append_str_length(ptg_context->output_buffer, ptr_in, length);
-    }
+// Where the loop has to stand for its increment to land on the jump target.  Branches only ever
+// go forward, a target that does not ends the render instead of starting it over.
+//
+static inline unsigned int pi_template_jump(pi_template_program_ptr program, unsigned int pc,
+                                            const pi_template_op_t *op) {
+    return op->jump > pc && op->jump <= program->op_count ? op->jump - 1 : program->op_count;
 }
 
-pi_template_error_t pi_template_generate_output(pi_string_ptr input_buffer,
-                                                pi_string_ptr output_buffer,
-                                                void *context_ptr,
-                                                function_string_ptr_t function_string_ptr,
-                                                function_boolean_ptr_t function_boolean_ptr) {
-    if (NULL == function_string_ptr
-        || NULL == function_boolean_ptr
-        || NULL == output_buffer
-        || NULL == input_buffer) {
+pi_template_error_t pi_template_execute(pi_template_program_ptr program, pi_string_ptr output_buffer) {
+    if (NULL == program || NULL == output_buffer) {
         return pie_template_invalid_input;
     }
 
     pi_string_reset(output_buffer);
 
-    pi_template_generator_t ptg_context;
-
-    pi_template_generator_create(&ptg_context,
-                                 output_buffer,
-                                 context_ptr,
-                                 function_boolean_ptr,
-                                 function_string_ptr);
-
-    const char *ptr_in = pi_string_c_string(input_buffer);
-    const char *ptr_EOF = ptr_in + pi_string_c_string_length(input_buffer);
-
-    if (*ptr_in == '%') {
-        pi_string_append_char(output_buffer, *ptr_in);
-        ptr_in++;
+    void *snapshots[template_max_sources + 1];
+    for (int i = 0; i < program->source_count; i++) {
+        snapshots[i] = (*program->sources[i]->snapshot)();
     }
 
-    pi_string_ptr symbol_buffer = pi_string_new(64);
-
-    while (ptr_in < ptr_EOF) {
-        //  Look for '%' and then see if we have a "<%"
-        //  Initialization would have ensured that we wont crash...
-        //
-        const char *ptr_tag = strchr(ptr_in, '%');
-        if (!ptr_tag) {
-            //  No more tags, copy the rest of the data to the output
-            //  buffer and break the loop.
-            //
-            pi_template_output(&ptg_context, ptr_in);
-            break;
-        }
-
-        //  Set the ptr_tag to the beginning of the '<%' tag...
-        ptr_tag--;
+    // Symbols without a source index the NULL past the last snapshot.
+    //
+    snapshots[program->source_count] = NULL;
 
-        size_t length_to_append = ptr_tag - ptr_in + 2 * (*ptr_tag != '<');
+    const char *text = pi_string_c_string(program->text);
 
-        pi_template_output_length(&ptg_context, ptr_in, length_to_append);
+    for (unsigned int pc = 0; pc < program->op_count; pc++) {
+        pi_template_op_t *op = &program->ops[pc];
+        const pi_template_provider_t *provider = op->symbol.provider;
+        void *snapshot = snapshots[op->symbol.source_index < 0 ? program->source_count : op->symbol.source_index];
+        bool value = false;
 
-        ptr_in += length_to_append;
-        if (*ptr_tag != '<') {
-            continue;
-        }
-
-        bool bool_value = false;
-        operator_type_t operator_type = pi_template_lookup_symbol(&ptg_context,
-                                                                  ptr_in,
-                                                                  symbol_buffer,
-                                                                  &bool_value);
-        switch (operator_type) {
-            case operator_type_invalid:
-            default:
-                ERROR_LOG("Invalid Operator Type at offset %d.", ptr_EOF - ptr_in);
+        switch (op->type) {
+            case operator_type_literal:
+                pi_string_append_str_length(output_buffer, text + op->offset, op->length);
                 break;
-            case operator_type_variable:
+
             case operator_type_output:
-                pi_template_output(&ptg_context, pi_string_c_string(symbol_buffer));
+                if (provider) {
+                    (*provider->get_string)(&op->symbol, snapshot, output_buffer);
+                }
                 break;
 
             case operator_type_If:
-                pi_template_push_if(&ptg_context, bool_value);
+                if (NULL == provider || !(*provider->get_boolean)(&op->symbol, snapshot, &value)) {
+                    value = false;
+                }
+
+                if (!value) {
+                    pc = pi_template_jump(program, pc, op);
+                }
                 break;
 
             case operator_type_Else:
-                pi_template_push_else(&ptg_context);
+                pc = pi_template_jump(program, pc, op);
                 break;
 
             case operator_type_EndIf:
-                pi_template_pop_if(&ptg_context);
+            case operator_type_invalid:
+            default:
                 break;
         }
+    }
 
-        // Skip over opening <%
-        //
-        if (*ptr_in == '<' && *(ptr_in + 1) == '%') {
-            ptr_in += 2;
-        }
-
-        // Skip to closing %>
-        //
-        while ('%' != *ptr_in && *ptr_in) {
-            ptr_in++;
-        }
-
-        if (*ptr_in == '%' && *(ptr_in + 1) == '>') {
-            ptr_in += 2;
+    for (int i = 0; i < program->source_count; i++) {
+        if (snapshots[i]) {
+            (*program->sources[i]->release)(snapshots[i]);
         }
     }
-    pi_string_delete(symbol_buffer, true);
 
-    pi_template_generator_destroy(&ptg_context);
     return pie_template_no_error;
-}
\ No newline at end of file
+}
@@ -35,18 +35,65 @@ typedef enum {
 } pi_template_error_t;
 
 
-typedef bool ( *function_string_ptr_t )(void *context_ptr,
-                                        const char *symbol,
-                                        pi_string_ptr value);
-
-typedef bool ( *function_boolean_ptr_t )(void *context_ptr,
-                                         const char *symbol,
-                                         bool *value);
-
-pi_template_error_t pi_template_generate_output(pi_string_ptr input_buffer,
-                                                pi_string_ptr output_buffer,
-                                                void *context_ptr,
-                                                function_string_ptr_t function_string_ptr,
-                                                function_boolean_ptr_t function_boolean_ptr);
+typedef struct pi_template_symbol_struct pi_template_symbol_t;
+
+// Where a provider's values come from.  A render takes one snapshot of every source its
+// template uses before it outputs anything, so all tags of a page see the same values and
+// each source is read once per page instead of once per tag.  snapshot() may return NULL
+// when the source cannot be read.
+//
+typedef struct pi_template_source_struct {
+    void *(*snapshot)();
+
+    void (*release)(void *snapshot);
+} pi_template_source_t;
+
+// A family of symbols sharing a prefix, "meminfo." or "gpio.digital.".  bind() is called once
+// per tag when a template is compiled with the rest of the symbol name and picks the field the
+// getters are called with.  Either getter may be NULL when the symbol has no such form, source
+// may be NULL when the getters read their values directly; snapshot is NULL then.
+//
+typedef struct pi_template_provider_struct {
+    const char *prefix;
+    const pi_template_source_t *source;
+
+    bool (*bind)(const char *name, int *field);
+
+    bool (*get_string)(const pi_template_symbol_t *symbol, void *snapshot, pi_string_ptr value);
+
+    bool (*get_boolean)(const pi_template_symbol_t *symbol, void *snapshot, bool *value);
+} pi_template_provider_t;
+
+struct pi_template_symbol_struct {
+    const pi_template_provider_t *provider;
+    int field;
+
+    // Index of the provider's source in the program, -1 without one.
+    //
+    int source_index;
+
+    // Symbol name after the provider prefix.
+    //
+    const char *name;
+};
+
+typedef struct pi_template_program_struct pi_template_program_t;
+
+typedef pi_template_program_t *pi_template_program_ptr;
+
+// Parses a template once into a list of instructions: literal text, symbol output and
+// If/Else/EndIf jumps.  Symbols are bound to one of the NULL terminated providers here, unknown
+// ones are logged and render as nothing (or false).  The program does not reference source
+// after it returns.
+//
+pi_template_program_ptr pi_template_compile(const char *source,
+                                            size_t source_length,
+                                            const pi_template_provider_t *const *providers);
+
+void pi_template_program_delete(pi_template_program_ptr program);
+
+// Renders a compiled template into output_buffer.
+//
+pi_template_error_t pi_template_execute(pi_template_program_ptr program, pi_string_ptr output_buffer);
 
 #endif //PI_TEMPLATE_GENERATOR_H
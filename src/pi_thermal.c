@@ -0,0 +1,232 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "pi_thermal.h"
+#include "pi_chart_settings.h"
+#include "pi_proc_file.h"
+#include "pi_sampler.h"
+#include "pi_seqlock.h"
+#include "pi_utils.h"
+
+#ifndef __unused
+#define __unused
+#endif
+
+// Most samples a file that keeps failing (EIO, ENODATA from a sensor that is not answering)
+// is skipped for before it is tried again.
+//
+#define thermal_max_backoff 64
+
+typedef struct pi_thermal_file_struct {
+    pi_proc_file_ptr file;
+
+    // Failed reads in a row, each one doubles the samples skipped before the next try.
+    //
+    unsigned int failures;
+    unsigned int skip;
+} pi_thermal_file_t;
+
+// Every file is opened once at start up and reread with a pread per sample, the static parts,
+// zone types and the highest frequency of each core, are read once.
+//
+typedef struct pi_thermal_sampler_struct {
+    pi_thermal_file_t zone_files[thermal_max_zones];
+    pi_thermal_file_t cpu_files[thermal_max_cpus];
+    pi_sampler_ptr sampler;
+
+    // Sample with the static parts filled in, the sampler only updates the readings.
+    //
+    pi_thermal_t sample;
+
+    pi_seqlock_t published_lock;
+    pi_thermal_t published;
+} pi_thermal_sampler_t;
+
+pi_thermal_sampler_t g_thermal;
+
+// Opens path if it exists, sysfs leaves out zones and cores that are not there.
+//
+static pi_proc_file_ptr pi_thermal_open(const char *path) {
+    return 0 == access(path, R_OK) ? pi_proc_file_new(path) : NULL;
+}
+
+// Reads the first number in the file, sysfs temperatures can be negative.  A file that fails
+// is left alone for 1, 2, 4 ... thermal_max_backoff samples before it is read again.
+//
+static bool pi_thermal_read_value(pi_thermal_file_t *thermal_file, long long *value) {
+    pi_proc_file_ptr file = thermal_file->file;
+
+    if (NULL == file) {
+        return false;
+    }
+
+    if (thermal_file->skip > 0) {
+        thermal_file->skip--;
+        return false;
+    }
+
+    if (!pi_proc_file_read(file) || 0 == file->length) {
+        thermal_file->skip = min(1u << min(thermal_file->failures, 6u), (unsigned int) thermal_max_backoff);
+        thermal_file->failures++;
+        return false;
+    }
+
+    thermal_file->failures = 0;
+
+    const char *begin = file->buffer;
+    const char *end = file->buffer + file->length;
+    bool negative = *begin == '-';
+
+    unsigned long long magnitude;
+    pi_proc_parse_u64(negative ? begin + 1 : begin, end, &magnitude);
+
+    *value = negative ? -(long long) magnitude : (long long) magnitude;
+
+    return true;
+}
+
+// Reads a file that does not change once, without keeping it open.
+//
+static bool pi_thermal_read_once(const char *path, char *text, size_t size) {
+    pi_proc_file_ptr file = pi_thermal_open(path);
+    bool result = file && pi_proc_file_read(file);
+
+    if (result) {
+        size_t length = min(file->length, size - 1);
+        memcpy(text, file->buffer, length);
+        text[length] = '\0';
+        trim_whitespace(text);
+    }
+
+    pi_proc_file_delete(file);
+
+    return result;
+}
+
+void pi_thermal_open_zones() {
+    char path[PATH_MAX];
+
+    for (unsigned int i = 0; i < thermal_max_zones; i++) {
+        snprintf(path, sizeof(path), "%s/class/thermal/thermal_zone%u/temp", get_sysfs_root(), i);
+        g_thermal.zone_files[i].file = pi_thermal_open(path);
+
+        if (NULL == g_thermal.zone_files[i].file) {
+            break;
+        }
+
+        pi_thermal_zone_t *zone = &g_thermal.sample.zones[i];
+
+        snprintf(path, sizeof(path), "%s/class/thermal/thermal_zone%u/type", get_sysfs_root(), i);
+        pi_thermal_read_once(path, zone->type, sizeof(zone->type));
+
+        g_thermal.sample.zone_count = i + 1;
+    }
+}
+
+void pi_thermal_open_cpus() {
+    char path[PATH_MAX];
+
+    for (unsigned int i = 0; i < thermal_max_cpus; i++) {
+        snprintf(path, sizeof(path), "%s/devices/system/cpu/cpu%u", get_sysfs_root(), i);
+
+        if (0 != access(path, F_OK)) {
+            break;
+        }
+
+        g_thermal.sample.cpu_count = i + 1;
+
+        snprintf(path, sizeof(path), "%s/devices/system/cpu/cpu%u/cpufreq/scaling_cur_freq", get_sysfs_root(), i);
+        g_thermal.cpu_files[i].file = pi_thermal_open(path);
+
+        char text[32];
+        snprintf(path, sizeof(path), "%s/devices/system/cpu/cpu%u/cpufreq/cpuinfo_max_freq", get_sysfs_root(), i);
+
+        if (pi_thermal_read_once(path, text, sizeof(text))) {
+            unsigned long long khz;
+            pi_proc_parse_u64(text, text + strlen(text), &khz);
+            g_thermal.sample.cpus[i].max_mhz = (double) khz / 1000.0;
+        }
+    }
+}
+
+void pi_thermal_sample(void __unused *context) {
+    pi_thermal_t *sample = &g_thermal.sample;
+    long long value;
+
+    // Millidegrees Celsius.
+    //
+    for (unsigned int i = 0; i < sample->zone_count; i++) {
+        sample->zones[i].present = pi_thermal_read_value(&g_thermal.zone_files[i], &value);
+        sample->zones[i].celsius = sample->zones[i].present ? (double) value / 1000.0 : 0;
+    }
+
+    // kHz.
+    //
+    for (unsigned int i = 0; i < sample->cpu_count; i++) {
+        sample->cpus[i].present = pi_thermal_read_value(&g_thermal.cpu_files[i], &value);
+        sample->cpus[i].mhz = sample->cpus[i].present ? (double) value / 1000.0 : 0;
+    }
+
+    pi_seqlock_write(&g_thermal.published_lock, &g_thermal.published, sample, sizeof(pi_thermal_t));
+}
+
+bool pi_thermal_start() {
+    pi_thermal_open_zones();
+    pi_thermal_open_cpus();
+
+    INFO_LOG("Sampling %u thermal zones and %u cores below %s",
+             g_thermal.sample.zone_count, g_thermal.sample.cpu_count, get_sysfs_root());
+
+    g_thermal.sampler = pi_sampler_start("thermal", pi_thermal_sample, NULL);
+
+    return NULL != g_thermal.sampler;
+}
+
+void pi_thermal_stop() {
+    pi_sampler_stop(g_thermal.sampler);
+    g_thermal.sampler = NULL;
+
+    for (unsigned int i = 0; i < thermal_max_zones; i++) {
+        pi_proc_file_delete(g_thermal.zone_files[i].file);
+    }
+
+    for (unsigned int i = 0; i < thermal_max_cpus; i++) {
+        pi_proc_file_delete(g_thermal.cpu_files[i].file);
+    }
+
+    memory_clear(g_thermal.zone_files, sizeof(g_thermal.zone_files));
+    memory_clear(g_thermal.cpu_files, sizeof(g_thermal.cpu_files));
+
+    memory_clear(&g_thermal.sample, sizeof(pi_thermal_t));
+}
+
+void pi_thermal_get(pi_thermal_ptr thermal) {
+    pi_seqlock_read(&g_thermal.published_lock, thermal, &g_thermal.published, sizeof(pi_thermal_t));
+}
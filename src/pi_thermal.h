@@ -0,0 +1,76 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#ifndef PI_THERMAL_H
+#define PI_THERMAL_H
+
+#include <stdbool.h>
+
+// Most thermal zones and cores that are sampled.
+//
+#define thermal_max_zones 16
+#define thermal_max_cpus 64
+
+#define thermal_type_length 24
+
+typedef struct pi_thermal_zone_struct {
+    // From the zone's type file, e.g. "cpu-thermal".
+    //
+    char type[thermal_type_length];
+    bool present;
+    double celsius;
+} pi_thermal_zone_t;
+
+typedef struct pi_cpu_freq_struct {
+    // False for a core without cpufreq, e.g. one that is offline.
+    //
+    bool present;
+    double mhz;
+    double max_mhz;
+} pi_cpu_freq_t;
+
+typedef struct pi_thermal_struct {
+    unsigned int zone_count;
+    pi_thermal_zone_t zones[thermal_max_zones];
+
+    unsigned int cpu_count;
+    pi_cpu_freq_t cpus[thermal_max_cpus];
+} pi_thermal_t;
+
+typedef pi_thermal_t *pi_thermal_ptr;
+
+// Opens thermal_zone*/temp and cpu*/cpufreq/scaling_cur_freq below get_sysfs_root() and
+// rereads them every get_sample_interval() milliseconds.
+//
+bool pi_thermal_start();
+
+void pi_thermal_stop();
+
+// Copies the latest sample, never touches the file system and never waits for the sampler.
+//
+void pi_thermal_get(pi_thermal_ptr thermal);
+
+#endif //PI_THERMAL_H
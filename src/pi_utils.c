@@ -252,5 +252,14 @@ long long timer_diff_minutes(struct timespec start_time) {
     return (nanoseconds / kNsPerSec) / 60;
 }
 
+long long timer_diff_milliseconds(struct timespec start_time) {
+    struct timespec end_time;
+    current_utc_time(&end_time);
+
+    long long nanoseconds = timespec_to_ns(&end_time) - timespec_to_ns(&start_time);
+
+    return nanoseconds / 1000000;
+}
+
 
 #pragma clang diagnostic pop
\ No newline at end of file
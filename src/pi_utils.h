@@ -49,6 +49,8 @@ struct timespec timer_start();
 
 long long timer_diff_minutes(struct timespec start_time);
 
+long long timer_diff_milliseconds(struct timespec start_time);
+
 #if !defined(NDEBUG)
 #define ASSERT(x)  {if (!(x)){log_message(LOG_ALERT, __FUNCTION__, __FILE__, __LINE__, "Assert Fired" );}}
 #else
@@ -73,6 +75,13 @@ void close_logs();
             _a > _b ? _a : _b; \
         })
 
+#define min(a, b) \
+       ({ \
+            __typeof__ (a) _a = (a); \
+            __typeof__ (b) _b = (b); \
+            _a < _b ? _a : _b; \
+        })
+
 #endif //PI_UTILS_H
 
 #pragma clang diagnostic pop
\ No newline at end of file
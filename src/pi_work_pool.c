@@ -0,0 +1,248 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#include <pthread.h>
+#include "pi_work_pool.h"
+#include "pi_utils.h"
+
+#define work_deque_initial_size 64
+
+// A double ended queue of work items.  The owning worker takes from the front so requests are
+// served in the order they arrived, thieves take from the back.
+//
+typedef struct pi_work_deque_struct {
+    pthread_mutex_t lock;
+    void **items;
+    size_t size;
+    size_t head;
+    size_t count;
+} pi_work_deque_t;
+
+typedef struct pi_work_worker_struct {
+    pi_work_pool_t *pool;
+    unsigned int index;
+    pthread_t thread_id;
+    pi_work_deque_t deque;
+} pi_work_worker_t;
+
+struct pi_work_pool_struct {
+    pi_work_function_t work_function;
+
+    unsigned int worker_count;
+    pi_work_worker_t *workers;
+
+    unsigned int next_worker;
+    unsigned int pending;
+    bool running;
+
+    // Idle workers sleep here until new work shows up.
+    //
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_condition;
+};
+
+void pi_work_deque_create(pi_work_deque_t *deque) {
+    memory_clear(deque, sizeof(pi_work_deque_t));
+    pthread_mutex_init(&deque->lock, NULL);
+    deque->size = work_deque_initial_size;
+    deque->items = memory_alloc(deque->size * sizeof(void *));
+}
+
+void pi_work_deque_destroy(pi_work_deque_t *deque) {
+    pthread_mutex_destroy(&deque->lock);
+    memory_free(deque->items);
+}
+
+void pi_work_deque_push_back(pi_work_deque_t *deque, void *work) {
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->count == deque->size) {
+        // Grow and unwrap the ring so head starts at zero again.
+        //
+        void **items = memory_alloc(deque->size * 2 * sizeof(void *));
+        for (size_t i = 0; i < deque->count; i++) {
+            items[i] = deque->items[(deque->head + i) % deque->size];
+        }
+        memory_free(deque->items);
+
+        deque->items = items;
+        deque->head = 0;
+        deque->size *= 2;
+    }
+
+    deque->items[(deque->head + deque->count) % deque->size] = work;
+    deque->count++;
+
+    pthread_mutex_unlock(&deque->lock);
+}
+
+void *pi_work_deque_pop_front(pi_work_deque_t *deque) {
+    void *work = NULL;
+
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->count) {
+        work = deque->items[deque->head];
+        deque->head = (deque->head + 1) % deque->size;
+        deque->count--;
+    }
+
+    pthread_mutex_unlock(&deque->lock);
+
+    return work;
+}
+
+void *pi_work_deque_steal_back(pi_work_deque_t *deque) {
+    void *work = NULL;
+
+    // Never wait on a busy victim, just move on to the next one.
+    //
+    if (0 == pthread_mutex_trylock(&deque->lock)) {
+        if (deque->count) {
+            deque->count--;
+            work = deque->items[(deque->head + deque->count) % deque->size];
+        }
+
+        pthread_mutex_unlock(&deque->lock);
+    }
+
+    return work;
+}
+
+void *pi_work_pool_take(pi_work_worker_t *worker) {
+    pi_work_pool_t *pool = worker->pool;
+
+    void *work = pi_work_deque_pop_front(&worker->deque);
+
+    for (unsigned int i = 1; NULL == work && i < pool->worker_count; i++) {
+        work = pi_work_deque_steal_back(&pool->workers[(worker->index + i) % pool->worker_count].deque);
+    }
+
+    if (work) {
+        __atomic_sub_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL);
+    }
+
+    return work;
+}
+
+void *pi_work_pool_thread(void *arg) {
+    pi_work_worker_t *worker = arg;
+    pi_work_pool_t *pool = worker->pool;
+
+    while (__atomic_load_n(&pool->running, __ATOMIC_ACQUIRE)) {
+        void *work = pi_work_pool_take(worker);
+
+        if (work) {
+            pool->work_function(work);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->idle_lock);
+        while (0 == __atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE)
+               && __atomic_load_n(&pool->running, __ATOMIC_ACQUIRE)) {
+            pthread_cond_wait(&pool->idle_condition, &pool->idle_lock);
+        }
+        pthread_mutex_unlock(&pool->idle_lock);
+    }
+
+    return NULL;
+}
+
+pi_work_pool_ptr pi_work_pool_new(unsigned int worker_count, pi_work_function_t work_function) {
+    if (0 == worker_count || NULL == work_function) {
+        return NULL;
+    }
+
+    pi_work_pool_ptr pool = memory_alloc(sizeof(pi_work_pool_t));
+
+    pool->work_function = work_function;
+    pool->worker_count = worker_count;
+    pool->running = true;
+    pthread_mutex_init(&pool->idle_lock, NULL);
+    pthread_cond_init(&pool->idle_condition, NULL);
+
+    pool->workers = memory_alloc(worker_count * sizeof(pi_work_worker_t));
+
+    for (unsigned int i = 0; i < worker_count; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        pi_work_deque_create(&pool->workers[i].deque);
+    }
+
+    // Only start the threads once every deque exists, they steal from each other right away.
+    //
+    for (unsigned int i = 0; i < worker_count; i++) {
+        pthread_create(&pool->workers[i].thread_id, NULL, &pi_work_pool_thread, &pool->workers[i]);
+    }
+
+    INFO_LOG("Started %u worker threads", worker_count);
+
+    return pool;
+}
+
+void pi_work_pool_delete(pi_work_pool_ptr pool) {
+    if (NULL == pool) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->idle_lock);
+    __atomic_store_n(&pool->running, false, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&pool->idle_condition);
+    pthread_mutex_unlock(&pool->idle_lock);
+
+    for (unsigned int i = 0; i < pool->worker_count; i++) {
+        pthread_join(pool->workers[i].thread_id, NULL);
+    }
+
+    for (unsigned int i = 0; i < pool->worker_count; i++) {
+        pi_work_deque_destroy(&pool->workers[i].deque);
+    }
+
+    pthread_cond_destroy(&pool->idle_condition);
+    pthread_mutex_destroy(&pool->idle_lock);
+
+    memory_free(pool->workers);
+    memory_free(pool);
+}
+
+bool pi_work_pool_submit(pi_work_pool_ptr pool, void *work) {
+    if (NULL == pool || !__atomic_load_n(&pool->running, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+
+    unsigned int index = __atomic_fetch_add(&pool->next_worker, 1, __ATOMIC_RELAXED) % pool->worker_count;
+
+    // Count the item before it can be stolen, a worker taking it first would wrap pending.
+    //
+    __atomic_add_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL);
+    pi_work_deque_push_back(&pool->workers[index].deque, work);
+
+    pthread_mutex_lock(&pool->idle_lock);
+    pthread_cond_signal(&pool->idle_condition);
+    pthread_mutex_unlock(&pool->idle_lock);
+
+    return true;
+}
@@ -0,0 +1,54 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+#ifndef PI_WORK_POOL_H
+#define PI_WORK_POOL_H
+
+#include <stdbool.h>
+
+// Called on a worker thread for every item handed to pi_work_pool_submit.
+//
+typedef void (*pi_work_function_t)(void *work);
+
+typedef struct pi_work_pool_struct pi_work_pool_t;
+
+typedef pi_work_pool_t *pi_work_pool_ptr;
+
+// Creates a pool of worker_count threads.  Every worker owns a deque, new work is spread
+// over the deques round robin and idle workers steal from the back of their neighbours.
+//
+pi_work_pool_ptr pi_work_pool_new(unsigned int worker_count, pi_work_function_t work_function);
+
+// Stops the workers, waits for them to finish the item they are working on and releases the pool.
+// Work still sitting in the deques is dropped.
+//
+void pi_work_pool_delete(pi_work_pool_ptr pool);
+
+// Queues work for the pool, returns false if the pool is shutting down.
+//
+bool pi_work_pool_submit(pi_work_pool_ptr pool, void *work);
+
+#endif //PI_WORK_POOL_H
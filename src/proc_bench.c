@@ -0,0 +1,173 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+// Times how long parsing a /proc file takes with pi_proc_scan() and with the scalar loop it
+// falls back to, and checks that both find the same bytes.
+//
+//      proc_bench [iterations] [proc directory]
+//
+// Returns non zero if the two scanners ever disagree.
+//
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pi_proc_file.h"
+
+typedef const char *(*pi_proc_scanner_t)(const char *begin, const char *end, char a, char b);
+
+// Splits the buffer into lines the way pi_proc_file_next_line() does and adds up every number
+// on them, so the result shows whether two scanners saw the same fields.
+//
+static unsigned long long proc_bench_parse(const char *buffer, size_t length, pi_proc_scanner_t scan) {
+    const char *end = buffer + length;
+    const char *cursor = buffer;
+    unsigned long long sum = 0;
+
+    while (cursor < end) {
+        const char *line_end = scan(cursor, end, ':', '\n');
+        const char *ptr = line_end;
+
+        if (line_end < end && *line_end == ':') {
+            ptr = line_end + 1;
+            line_end = scan(ptr, end, '\n', '\n');
+        }
+        else {
+            ptr = scan(cursor, line_end, ' ', ' ');
+        }
+
+        while (ptr < line_end) {
+            unsigned long long value = 0;
+            const char *next = pi_proc_parse_u64(ptr, line_end, &value);
+
+            if (next == ptr) {
+                next = scan(ptr, line_end, ' ', ' ');
+                next = next < line_end ? next + 1 : line_end;
+            }
+
+            sum += value;
+            ptr = next;
+        }
+
+        cursor = line_end < end ? line_end + 1 : end;
+    }
+
+    return sum;
+}
+
+static double proc_bench_time(const char *buffer, size_t length, pi_proc_scanner_t scan, long iterations,
+                              unsigned long long *sum) {
+    struct timespec start;
+    struct timespec stop;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (long i = 0; i < iterations; i++) {
+        *sum = proc_bench_parse(buffer, length, scan);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    double nanoseconds = (stop.tv_sec - start.tv_sec) * 1e9 + (stop.tv_nsec - start.tv_nsec);
+
+    return nanoseconds / iterations;
+}
+
+// Puts a single match at every position of every length up to 99 and compares the scanners.
+//
+static bool proc_bench_check_scanners() {
+    char buffer[100];
+
+    for (size_t length = 0; length < sizeof(buffer); length++) {
+        for (size_t match = 0; match <= length; match++) {
+            memset(buffer, 'x', sizeof(buffer));
+            if (match < length) {
+                buffer[match] = (char) (match & 1 ? '\n' : ':');
+            }
+
+            const char *simd = pi_proc_scan(buffer, buffer + length, ':', '\n');
+            const char *scalar = pi_proc_scan_scalar(buffer, buffer + length, ':', '\n');
+
+            if (simd != scalar || scalar != buffer + match) {
+                fprintf(stderr, "Scanners disagree on length %zu match %zu\n", length, match);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static bool proc_bench_file(const char *directory, const char *name, long iterations) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+
+    pi_proc_file_ptr file = pi_proc_file_new(path);
+
+    if (NULL == file || !pi_proc_file_read(file)) {
+        fprintf(stderr, "Unable to read %s\n", path);
+        pi_proc_file_delete(file);
+        return false;
+    }
+
+    unsigned long long simd_sum = 0;
+    unsigned long long scalar_sum = 0;
+
+    double simd_ns = proc_bench_time(file->buffer, file->length, pi_proc_scan, iterations, &simd_sum);
+    double scalar_ns = proc_bench_time(file->buffer, file->length, pi_proc_scan_scalar, iterations, &scalar_sum);
+
+    fprintf(stdout, "%-10s %6zu bytes  pi_proc_scan %8.1f ns/parse  scalar %8.1f ns/parse  %.2fx\n",
+            name, file->length, simd_ns, scalar_ns, simd_ns > 0 ? scalar_ns / simd_ns : 0.0);
+
+    pi_proc_file_delete(file);
+
+    if (simd_sum != scalar_sum) {
+        fprintf(stderr, "%s parsed differently: %llu != %llu\n", name, simd_sum, scalar_sum);
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 100000;
+    const char *directory = argc > 2 ? argv[2] : "proc";
+
+    if (iterations <= 0) {
+        fprintf(stderr, "usage: proc_bench [iterations] [proc directory]\n");
+        return EXIT_FAILURE;
+    }
+
+    bool passed = proc_bench_check_scanners();
+
+    passed = proc_bench_file(directory, "meminfo", iterations) && passed;
+    passed = proc_bench_file(directory, "stat", iterations) && passed;
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
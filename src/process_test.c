@@ -0,0 +1,171 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+// Checks that the process table follows local children: it forks children that rename
+// themselves, one that execs, and expects pi_process_find() and pi_process_list() to show them
+// within a bounded wait and to drop them again once they have been reaped.
+//
+//      process_test [scan]
+//
+// Uses the netlink process connector unless scan is given (or it is not available), in which
+// case the table is kept by rescanning /proc.
+//
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include "pi_process.h"
+#include "pi_chart_settings.h"
+#include "pi_utils.h"
+
+#define process_test_children 8
+
+// Long enough for a scan with the default one second sample interval.
+//
+#define process_test_wait_ms 5000
+
+typedef struct process_test_child_struct {
+    pid_t pid;
+    char name[process_name_length];
+} process_test_child_t;
+
+static bool process_test_listed(pid_t pid) {
+    unsigned int size = 4096;
+    pid_t *pids = memory_alloc(size * sizeof(pid_t));
+    unsigned int count = pi_process_list(pids, size);
+
+    while (count > size) {
+        size = count * 2;
+        pids = memory_realloc(pids, size * sizeof(pid_t));
+        count = pi_process_list(pids, size);
+    }
+
+    bool listed = false;
+    for (unsigned int i = 0; i < count && !listed; i++) {
+        listed = pids[i] == pid;
+    }
+
+    memory_free(pids);
+
+    return listed;
+}
+
+// True once every child is (or is no longer) in the table.
+//
+static bool process_test_tracked(process_test_child_t *children, int count, bool present) {
+    for (int i = 0; i < count; i++) {
+        bool listed = process_test_listed(children[i].pid);
+        bool named = children[i].name[0] && pi_process_find(children[i].name) == children[i].pid;
+
+        // A renamed child counts once it is found by both, and as gone once by neither.
+        //
+        bool found = children[i].name[0] ? (present ? listed && named : listed || named) : listed;
+
+        if (found != present) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool process_test_wait(process_test_child_t *children, int count, bool present, const char *what) {
+    struct timespec start = timer_start();
+
+    while (!process_test_tracked(children, count, present)) {
+        if (timer_diff_milliseconds(start) > process_test_wait_ms) {
+            fprintf(stderr, "Children not %s after %d ms\n", what, process_test_wait_ms);
+            return false;
+        }
+
+        usleep(10000);
+    }
+
+    fprintf(stdout, "Children %s after %lld ms\n", what, timer_diff_milliseconds(start));
+
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    process_test_child_t children[process_test_children + 1];
+
+    set_process_events(argc < 2 || 0 != strcmp(argv[1], "scan"));
+
+    if (!pi_process_start()) {
+        fprintf(stderr, "Unable to start the process table\n");
+        return EXIT_FAILURE;
+    }
+
+    memory_clear(children, sizeof(children));
+
+    for (int i = 0; i <= process_test_children; i++) {
+        if (i < process_test_children) {
+            snprintf(children[i].name, sizeof(children[i].name), "pi_test_%d_%d", (int) getpid() % 1000, i);
+        }
+
+        pid_t pid = fork();
+
+        if (pid < 0) {
+            fprintf(stderr, "Unable to fork\n");
+            return EXIT_FAILURE;
+        }
+
+        if (0 == pid) {
+            prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+            if (children[i].name[0]) {
+                prctl(PR_SET_NAME, children[i].name);
+                pause();
+            }
+            else {
+                execl("/bin/sleep", "sleep", "60", (char *) NULL);
+            }
+            _exit(EXIT_FAILURE);
+        }
+
+        children[i].pid = pid;
+    }
+
+    bool passed = process_test_wait(children, process_test_children + 1, true, "found");
+
+    for (int i = 0; i <= process_test_children; i++) {
+        kill(children[i].pid, SIGKILL);
+        waitpid(children[i].pid, NULL, 0);
+    }
+
+    passed = process_test_wait(children, process_test_children + 1, false, "gone") && passed;
+
+    pi_process_stop();
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,129 @@
+/**********************************************************************
+//    Copyright (c) 2016 Henry Seurer & Samuel Kelly
+//
+//    Permission is hereby granted, free of charge, to any person
+//    obtaining a copy of this software and associated documentation
+//    files (the "Software"), to deal in the Software without
+//    restriction, including without limitation the rights to use,
+//    copy, modify, merge, publish, distribute, sublicense, and/or sell
+//    copies of the Software, and to permit persons to whom the
+//    Software is furnished to do so, subject to the following
+//    conditions:
+//
+//    The above copyright notice and this permission notice shall be
+//    included in all copies or substantial portions of the Software.
+//
+//    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+//    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+//    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+//    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+//    OTHER DEALINGS IN THE SOFTWARE.
+//
+**********************************************************************/
+
+// Times how many renders per second a page gets: the page is loaded and compiled through the
+// file cache like the server does, the samplers the server runs are started so the symbols have
+// real values, and the compiled program is executed the given number of times.
+//
+//      render_bench [iterations] [www directory] [page]
+//
+// Defaults to 1000 renders of /index.html from www.
+//
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "pi_chart_settings.h"
+#include "pi_chart_gpio.h"
+#include "pi_cpu_stat.h"
+#include "pi_disk_stats.h"
+#include "pi_file_cache.h"
+#include "pi_gpio_edges.h"
+#include "pi_mem_info.h"
+#include "pi_net_dev.h"
+#include "pi_process.h"
+#include "pi_process_stats.h"
+#include "pi_process_top.h"
+#include "pi_string.h"
+#include "pi_template_generator.h"
+#include "pi_thermal.h"
+#include "pi_utils.h"
+
+#define render_bench_warm_up 10
+
+int main(int argc, char *argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : 1000;
+    const char *page = argc > 3 ? argv[3] : "/index.html";
+
+    if (iterations <= 0) {
+        fprintf(stderr, "usage: render_bench [iterations] [www directory] [page]\n");
+        return EXIT_FAILURE;
+    }
+
+    set_file_directory(argc > 2 ? argv[2] : "www");
+
+    setup_wiring_pi();
+    set_service_running(true);
+
+    pi_mem_info_start();
+    pi_cpu_stat_start();
+    pi_thermal_start();
+    pi_net_dev_start();
+    pi_disk_stats_start();
+    pi_process_start();
+    pi_process_stats_start();
+    pi_process_top_start();
+    pi_gpio_edges_start();
+
+    if (!pi_file_cache_start()) {
+        fprintf(stderr, "Unable to load %s\n", get_file_directory());
+        return EXIT_FAILURE;
+    }
+
+    pi_file_entry_ptr entry = pi_file_cache_acquire(page);
+
+    if (NULL == entry || NULL == entry->program) {
+        fprintf(stderr, "%s is not a template under %s\n", page, get_file_directory());
+        pi_file_cache_release(entry);
+        return EXIT_FAILURE;
+    }
+
+    // Let every sampler publish a second sample so rates have values, as they would in the server.
+    //
+    usleep((get_sample_interval() + 100) * 1000);
+
+    pi_string_ptr output = pi_string_new(entry->size * 2);
+
+    for (int i = 0; i < render_bench_warm_up; i++) {
+        pi_template_execute(entry->program, output);
+    }
+
+    struct timespec start;
+    struct timespec stop;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (long i = 0; i < iterations; i++) {
+        pi_template_execute(entry->program, output);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    double seconds = (double) (stop.tv_sec - start.tv_sec) + (double) (stop.tv_nsec - start.tv_nsec) / 1e9;
+
+    fprintf(stdout, "%s %zu bytes -> %zu bytes  %ld renders  %.1f us/render  %.0f renders/sec\n",
+            page, entry->size, pi_string_c_string_length(output), iterations,
+            seconds * 1e6 / (double) iterations, seconds > 0 ? (double) iterations / seconds : 0.0);
+
+    pi_string_delete(output, true);
+    pi_file_cache_release(entry);
+
+    return EXIT_SUCCESS;
+}